@@ -0,0 +1,91 @@
+#pragma once
+
+// Shared pieces of voyis_bench: result collection, JSON output, baseline
+// comparison and the suite entry points.
+
+#include <algorithm>
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+#include <opencv2/core.hpp>
+
+#include "common/cli_utils.hpp"
+
+namespace bench {
+
+// Which way a metric has to move to count as a regression.
+enum class Better { Higher, Lower, Neither };
+
+struct Metric {
+    std::string name;
+    double value{};
+    std::string unit;
+    Better better = Better::Higher;
+};
+
+struct Result {
+    std::string suite;
+    std::string name;
+    std::vector<Metric> metrics;
+};
+
+class Report {
+public:
+    void add(Result result);
+
+    const std::vector<Result>& results() const { return results_; }
+
+    // One line per result, as the suites finish.
+    static void print(std::ostream& out, const Result& result);
+
+    // {"schema": 1, "host": ..., "config": {...}, "results": [...]}
+    nlohmann::json to_json(const nlohmann::json& config) const;
+
+private:
+    std::vector<Result> results_;
+};
+
+// Compares `report` with a previous to_json() output and prints every metric
+// that moved the wrong way by more than `tolerance` (0.1 = 10%). Returns the
+// number of regressions.
+int compare(const nlohmann::json& baseline, const Report& report, double tolerance,
+            std::ostream& out);
+
+struct Context {
+    const cli_utils::Args& args;
+    // Images of the corpus folder, decoded to 8-bit BGR; may be empty.
+    std::vector<cv::Mat> corpus;
+    int iterations = 5;
+};
+
+// Runs `fn` once to warm up, then `iterations` times, and returns the
+// median wall time in seconds. The median keeps one noisy run from moving
+// the result.
+template <typename Fn>
+double median_seconds(int iterations, Fn&& fn) {
+    using Clock = std::chrono::steady_clock;
+    fn();
+    std::vector<double> times;
+    times.reserve(static_cast<std::size_t>(iterations));
+    for (int i = 0; i < iterations; ++i) {
+        auto start = Clock::now();
+        fn();
+        times.push_back(std::chrono::duration<double>(Clock::now() - start).count());
+    }
+    std::nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+    return times[times.size() / 2];
+}
+
+std::vector<std::string> split_list(const std::string& list);
+
+void run_codec(const Context& ctx, Report& report);
+void run_sift(const Context& ctx, Report& report);
+void run_detector(const Context& ctx, Report& report);
+void run_metadata(const Context& ctx, Report& report);
+void run_zmq(const Context& ctx, Report& report);
+void run_sqlite(const Context& ctx, Report& report);
+
+}  // namespace bench
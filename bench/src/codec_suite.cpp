@@ -0,0 +1,68 @@
+// codec suite: encodes and decodes the corpus with each wire codec and
+// reports throughput (MB/s of raw BGR pixels) and compression ratio.
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "bench.hpp"
+#include "common/codec.hpp"
+
+namespace bench {
+namespace {
+constexpr char kDefaultCodecs[] = "raw_bgr8,raw_gray8,qoi,png:0,png:1,png:3,png:6,png:9,jpeg:75,jpeg:95";
+}  // namespace
+
+void run_codec(const Context& ctx, Report& report) {
+    if (ctx.corpus.empty()) {
+        std::cerr << "[WARN] codec suite skipped: no corpus images\n";
+        return;
+    }
+    const auto& images = ctx.corpus;
+    std::size_t raw_bytes = 0;
+    for (const auto& img : images) {
+        raw_bytes += img.total() * img.elemSize();
+    }
+
+    for (const auto& spec : split_list(ctx.args.get("codecs", kDefaultCodecs))) {
+        auto options = codec::parse(spec);
+        if (!options) {
+            std::cerr << "Skipping unknown codec " << spec << "\n";
+            continue;
+        }
+        const std::string encoding(codec::encoding_name(options->kind));
+        std::vector<std::vector<unsigned char>> encoded(images.size());
+
+        bool ok = true;
+        const double encode_s = median_seconds(ctx.iterations, [&] {
+            for (std::size_t i = 0; i < images.size(); ++i) {
+                ok = ok && codec::encode(images[i], *options, encoded[i]);
+            }
+        });
+        const double decode_s = median_seconds(ctx.iterations, [&] {
+            for (std::size_t i = 0; i < images.size(); ++i) {
+                // clone() so raw codecs pay for materialising the pixels too.
+                cv::Mat img = codec::decode(encoding, encoded[i], images[i].rows, images[i].cols).clone();
+                ok = ok && !img.empty();
+            }
+        });
+        if (!ok) {
+            std::cerr << "Codec " << spec << " failed on the corpus\n";
+            continue;
+        }
+
+        std::size_t encoded_bytes = 0;
+        for (const auto& e : encoded) {
+            encoded_bytes += e.size();
+        }
+        const double mb = static_cast<double>(raw_bytes) / 1e6;
+        report.add({"codec", codec::describe(*options), {
+            {"encode", mb / encode_s, "MB/s"},
+            {"decode", mb / decode_s, "MB/s"},
+            {"ratio", static_cast<double>(raw_bytes) / static_cast<double>(encoded_bytes), "x",
+             Better::Neither}
+        }});
+    }
+}
+
+}  // namespace bench
@@ -0,0 +1,135 @@
+// detector suite: every detection tier (detector::Config) on the first
+// corpus image at one resolution, to pick a speed/keypoint trade-off per
+// deployment. Runs detector::Detector exactly as the extractor does.
+// Tiled tiers also report how many of the whole-frame keypoints they find.
+// The tracking cases run tracker::Tracker over a panning sequence cut from
+// the same image and report the average cost per frame.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <opencv2/imgproc.hpp>
+
+#include "bench.hpp"
+#include "common/detector.hpp"
+#include "common/tracker.hpp"
+
+namespace bench {
+namespace {
+constexpr char kDefaultTiers[] =
+    "sift,sift#512,sift@0.5,sift:2000,orb:2000,akaze,akaze@0.5,fast-brief:2000";
+constexpr char kDefaultSize[] = "1920x1080";
+constexpr char kDefaultTracks[] = "10,30";
+// Pan of the synthetic sequence, in pixels per frame.
+constexpr int kPanStep = 2;
+
+// Share of `reference` keypoints with one in `found` within half a pixel,
+// at the same octave and of about the same size.
+double match_ratio(const std::vector<cv::KeyPoint>& reference, std::vector<cv::KeyPoint> found) {
+    if (reference.empty()) {
+        return 1.0;
+    }
+    auto by_x = [](const cv::KeyPoint& a, const cv::KeyPoint& b) { return a.pt.x < b.pt.x; };
+    std::sort(found.begin(), found.end(), by_x);
+    std::size_t matched = 0;
+    for (const auto& kp : reference) {
+        auto it = std::lower_bound(found.begin(), found.end(), cv::KeyPoint(kp.pt.x - 0.5f, 0.0f, 0.0f), by_x);
+        for (; it != found.end() && it->pt.x <= kp.pt.x + 0.5f; ++it) {
+            if (std::abs(it->pt.y - kp.pt.y) <= 0.5f && (it->octave & 0xff) == (kp.octave & 0xff) &&
+                std::abs(it->size - kp.size) <= 0.05f * kp.size) {
+                ++matched;
+                break;
+            }
+        }
+    }
+    return static_cast<double>(matched) / static_cast<double>(reference.size());
+}
+}  // namespace
+
+void run_detector(const Context& ctx, Report& report) {
+    if (ctx.corpus.empty()) {
+        std::cerr << "[WARN] detector suite skipped: no corpus images\n";
+        return;
+    }
+    const std::string size = ctx.args.get("detector-size", kDefaultSize);
+    int cols = 0;
+    int rows = 0;
+    if (std::sscanf(size.c_str(), "%dx%d", &cols, &rows) != 2 || cols <= 0 || rows <= 0) {
+        std::cerr << "[WARN] detector suite skipped: bad --detector-size " << size << "\n";
+        return;
+    }
+    cv::Mat img;
+    cv::resize(ctx.corpus.front(), img, cv::Size(cols, rows), 0, 0, cv::INTER_AREA);
+
+    // One core per call, as in a multi-worker extractor, except for tiled
+    // tiers, which exist to spread one frame over all cores.
+    const int previous_threads = cv::getNumThreads();
+    for (const auto& spec : split_list(ctx.args.get("detectors", kDefaultTiers))) {
+        auto config = detector::parse(spec);
+        if (!config) {
+            std::cerr << "Skipping bad detector " << spec << "\n";
+            continue;
+        }
+        cv::setNumThreads(config->tile > 0 ? previous_threads : 1);
+        detector::Detector detector(*config);
+        detector::Features features;
+        const double s = median_seconds(ctx.iterations, [&] { detector.detect(img, features); });
+        Result result{"detector", detector::describe(*config) + "/" + size, {
+            {"time", s * 1e3, "ms", Better::Lower},
+            {"rate", static_cast<double>(cols) * rows / s / 1e6, "MP/s"},
+            {"keypoints", static_cast<double>(features.keypoints.size()), "", Better::Neither},
+            {"descriptor_bytes", static_cast<double>(features.descriptors.cols * features.descriptors.elemSize()),
+             "B", Better::Neither}
+        }};
+        if (config->tile > 0) {
+            auto whole = *config;
+            whole.tile = 0;
+            detector::Features reference;
+            detector::Detector(whole).detect(img, reference);
+            result.metrics.push_back(
+                {"whole_frame_match", match_ratio(reference.keypoints, features.keypoints) * 100.0, "%"});
+        }
+        report.add(std::move(result));
+    }
+
+    // Tracking: the first tier on a sequence panning across the image, two
+    // keyframe intervals long.
+    cv::setNumThreads(1);
+    const auto tiers = split_list(ctx.args.get("detectors", kDefaultTiers));
+    const auto first = tiers.empty() ? std::nullopt : detector::parse(tiers.front());
+    for (const auto& spec : split_list(ctx.args.get("tracks", kDefaultTracks))) {
+        auto config = tracker::parse(spec);
+        if (!config || !first) {
+            std::cerr << "Skipping bad track " << spec << "\n";
+            continue;
+        }
+        const int frames = 2 * config->keyframe_interval;
+        cv::Mat wide;
+        cv::resize(ctx.corpus.front(), wide, cv::Size(cols + frames * kPanStep, rows), 0, 0, cv::INTER_AREA);
+        std::vector<cv::Mat> sequence;
+        for (int i = 0; i < frames; ++i) {
+            sequence.push_back(wide(cv::Rect(i * kPanStep, 0, cols, rows)));
+        }
+        detector::Features features;
+        int tracked = 0;
+        const double s = median_seconds(ctx.iterations, [&] {
+            tracker::Tracker tracker(*first, *config);
+            tracked = 0;
+            for (const auto& frame : sequence) {
+                tracked += tracker.process(frame, features) == tracker::Kind::Tracked;
+            }
+        });
+        report.add({"detector", detector::describe(*first) + "+track:" + tracker::describe(*config) + "/" + size, {
+            {"time_per_frame", s * 1e3 / frames, "ms", Better::Lower},
+            {"tracked_share", 100.0 * tracked / frames, "%", Better::Neither},
+            {"keypoints", static_cast<double>(features.keypoints.size()), "", Better::Neither}
+        }});
+    }
+    cv::setNumThreads(previous_threads);
+}
+
+}  // namespace bench
@@ -0,0 +1,125 @@
+// voyis_bench: repeatable micro- and macro-benchmarks of the pipeline hot
+// paths. Each suite prints one line per case; --json writes every result in
+// a machine-readable form and --baseline compares the run with an earlier
+// JSON file, exiting non-zero on regressions.
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+#include "bench.hpp"
+#include "common/cli_utils.hpp"
+
+namespace fs = std::filesystem;
+
+namespace {
+constexpr char kDefaultCorpus[] = "images";
+constexpr char kAllSuites[] = "codec,sift,detector,metadata,zmq,sqlite";
+constexpr long long kDefaultIterations = 5;
+constexpr double kDefaultTolerance = 0.10;
+
+std::vector<cv::Mat> load_corpus(const fs::path& folder) {
+    std::vector<cv::Mat> images;
+    std::error_code ec;
+    std::vector<fs::path> files;
+    for (const auto& entry : fs::directory_iterator(folder, ec)) {
+        if (entry.is_regular_file()) {
+            files.push_back(entry.path());
+        }
+    }
+    // Directory order is not stable; sorting keeps runs comparable.
+    std::sort(files.begin(), files.end());
+    for (const auto& path : files) {
+        cv::Mat img = cv::imread(path.string(), cv::IMREAD_COLOR);
+        if (!img.empty()) {
+            images.push_back(img);
+        }
+    }
+    return images;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+    cli_utils::Args args(argc, argv);
+    if (args.has("help")) {
+        std::cerr << "Usage: " << argv[0] << " [image_folder=" << kDefaultCorpus << "]"
+                  << " [--suites=" << kAllSuites << "]"
+                  << " [--iterations=" << kDefaultIterations << "]"
+                  << " [--json=FILE] [--baseline=FILE] [--tolerance=" << kDefaultTolerance << "]\n"
+                  << "  codec:    [--codecs=raw_bgr8,qoi,png:1,...]\n"
+                  << "  sift:     [--sift-sizes=320x240,640x480,...]\n"
+                  << "  detector: [--detectors=sift,sift@0.5,orb:2000,...] [--detector-size=1920x1080]\n"
+                  << "  metadata: [--keypoints=2000]\n"
+                  << "  zmq:      [--zmq-sizes=1K,16K,256K,1M,4M,16M]\n"
+                  << "  sqlite:   [--sqlite-batches=1,64] [--sqlite-frames=500]"
+                  << " [--sqlite-payload-kb=256] [--sqlite-db=FILE]\n";
+        return 1;
+    }
+    const std::string corpus_dir = args.positional().empty() ? kDefaultCorpus
+                                                             : args.positional().front();
+    bench::Context ctx{args, load_corpus(corpus_dir),
+                       static_cast<int>(std::max(1LL, args.get_int("iterations", kDefaultIterations)))};
+    const std::vector<std::string> suites = bench::split_list(args.get("suites", kAllSuites));
+    std::cout << "Corpus: " << ctx.corpus.size() << " image(s) from " << corpus_dir
+              << ", " << ctx.iterations << " timed iteration(s) per case\n\n";
+
+    bench::Report report;
+    for (const auto& suite : suites) {
+        if (suite == "codec") {
+            bench::run_codec(ctx, report);
+        } else if (suite == "sift") {
+            bench::run_sift(ctx, report);
+        } else if (suite == "detector") {
+            bench::run_detector(ctx, report);
+        } else if (suite == "metadata") {
+            bench::run_metadata(ctx, report);
+        } else if (suite == "zmq") {
+            bench::run_zmq(ctx, report);
+        } else if (suite == "sqlite") {
+            bench::run_sqlite(ctx, report);
+        } else {
+            std::cerr << "Skipping unknown suite " << suite << "\n";
+        }
+    }
+
+    nlohmann::json config = {
+        {"corpus", corpus_dir},
+        {"corpus_images", ctx.corpus.size()},
+        {"iterations", ctx.iterations},
+        {"suites", suites},
+        {"opencv", CV_VERSION}
+    };
+    if (auto path = args.value("json")) {
+        std::ofstream out(*path);
+        out << report.to_json(config).dump(2) << "\n";
+        if (!out) {
+            std::cerr << "[ERROR] Failed to write " << *path << "\n";
+            return 1;
+        }
+        std::cout << "\nWrote " << report.results().size() << " result(s) to " << *path << "\n";
+    }
+
+    if (auto path = args.value("baseline")) {
+        std::ifstream in(*path);
+        nlohmann::json baseline = nlohmann::json::parse(in, nullptr, false);
+        if (baseline.is_discarded()) {
+            std::cerr << "[ERROR] Failed to read baseline " << *path << "\n";
+            return 1;
+        }
+        const double tolerance = args.get_double("tolerance", kDefaultTolerance);
+        int regressions = bench::compare(baseline, report, tolerance, std::cout);
+        std::cout << regressions << " regression(s) beyond " << tolerance * 100.0
+                  << "% against " << *path << "\n";
+        if (regressions > 0) {
+            return 2;
+        }
+    }
+    return 0;
+}
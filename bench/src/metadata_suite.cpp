@@ -0,0 +1,179 @@
+// metadata suite: FrameMetadata JSON and binary header round trips, and keypoint serialization
+// (the legacy JSON array against the binary keypoint block) for a synthetic
+// frame with --keypoints keypoints and 128-d SIFT-like descriptors.
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench.hpp"
+#include "common/frame.hpp"
+#include "common/frame_header.hpp"
+#include "common/keypoint_block.hpp"
+
+namespace bench {
+namespace {
+constexpr long long kDefaultKeypoints = 2000;
+constexpr int kDescriptorLength = 128;
+// Small operations are repeated so one timed run is well above clock noise.
+constexpr int kMetadataOpsPerRun = 10000;
+
+FrameMetadata sample_metadata() {
+    FrameMetadata meta;
+    meta.seq_number = 123456;
+    meta.image_name = "2292.jpg";
+    meta.rows = 1080;
+    meta.cols = 1920;
+    meta.encoding = "png";
+    meta.data_bytes = 3 << 20;
+    meta.keypoint_count = 2000;
+    meta.stream_id = 0x0123456789abcdefull;
+    meta.extractor_id = "host-12345";
+    meta.keypoint_format = std::string(keypoint_block::kFormatName);
+    meta.t.gen_read = 1000000000ull;
+    meta.t.gen_encode = 1000100000ull;
+    meta.t.gen_send = 1000200000ull;
+    meta.t.ext_recv = 1000300000ull;
+    return meta;
+}
+
+nlohmann::json keypoints_to_json(const std::vector<cv::KeyPoint>& keypoints) {
+    nlohmann::json kp_array = nlohmann::json::array();
+    for (const auto& kp : keypoints) {
+        kp_array.push_back({
+            {"x", kp.pt.x},
+            {"y", kp.pt.y},
+            {"size", kp.size},
+            {"angle", kp.angle},
+            {"response", kp.response},
+            {"octave", kp.octave}
+        });
+    }
+    return kp_array;
+}
+
+}  // namespace
+
+void run_metadata(const Context& ctx, Report& report) {
+    const FrameMetadata meta = sample_metadata();
+    std::string text = meta.to_json().dump();
+
+    double s = median_seconds(ctx.iterations, [&] {
+        for (int i = 0; i < kMetadataOpsPerRun; ++i) {
+            text = meta.to_json().dump();
+        }
+    });
+    report.add({"metadata", "to_json", {
+        {"time", s / kMetadataOpsPerRun * 1e9, "ns/op", Better::Lower},
+        {"bytes", static_cast<double>(text.size()), "B", Better::Neither}
+    }});
+
+    bool ok = true;
+    s = median_seconds(ctx.iterations, [&] {
+        for (int i = 0; i < kMetadataOpsPerRun; ++i) {
+            ok = ok && FrameMetadata::from_json(text).has_value();
+        }
+    });
+    report.add({"metadata", "from_json", {
+        {"time", s / kMetadataOpsPerRun * 1e9, "ns/op", Better::Lower}
+    }});
+
+    std::vector<unsigned char> header;
+    s = median_seconds(ctx.iterations, [&] {
+        for (int i = 0; i < kMetadataOpsPerRun; ++i) {
+            frame_header::encode(meta, header);
+        }
+    });
+    report.add({"metadata", "header_encode", {
+        {"time", s / kMetadataOpsPerRun * 1e9, "ns/op", Better::Lower},
+        {"bytes", static_cast<double>(header.size()), "B", Better::Neither}
+    }});
+
+    // What a hop does with a received header: read a few fields in place.
+    std::int64_t checksum = 0;
+    s = median_seconds(ctx.iterations, [&] {
+        for (int i = 0; i < kMetadataOpsPerRun; ++i) {
+            if (auto view = frame_header::View::parse(header)) {
+                checksum += view->seq_number() + view->rows() +
+                            static_cast<std::int64_t>(view->image_name().size());
+            }
+        }
+    });
+    ok = ok && checksum != 0;
+    report.add({"metadata", "header_view", {
+        {"time", s / kMetadataOpsPerRun * 1e9, "ns/op", Better::Lower}
+    }});
+
+    s = median_seconds(ctx.iterations, [&] {
+        for (int i = 0; i < kMetadataOpsPerRun; ++i) {
+            ok = ok && frame_header::decode(header).has_value();
+        }
+    });
+    report.add({"metadata", "header_decode", {
+        {"time", s / kMetadataOpsPerRun * 1e9, "ns/op", Better::Lower}
+    }});
+
+    // Deterministic keypoints and descriptors, so runs are comparable.
+    const auto count = static_cast<int>(std::max(1LL, ctx.args.get_int("keypoints", kDefaultKeypoints)));
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> coord(0.0f, 1920.0f);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::uniform_int_distribution<int> value(0, 255);
+    std::vector<cv::KeyPoint> keypoints;
+    keypoints.reserve(static_cast<std::size_t>(count));
+    for (int i = 0; i < count; ++i) {
+        keypoints.emplace_back(coord(rng), coord(rng), 2.0f + 30.0f * unit(rng),
+                               360.0f * unit(rng), unit(rng) / 10.0f, i % 8);
+    }
+    cv::Mat desc(count, kDescriptorLength, CV_32F);
+    for (int r = 0; r < count; ++r) {
+        float* row = desc.ptr<float>(r);
+        for (int c = 0; c < kDescriptorLength; ++c) {
+            row[c] = static_cast<float>(value(rng));
+        }
+    }
+    const std::string name_suffix = "_" + std::to_string(count) + "kp";
+
+    s = median_seconds(ctx.iterations, [&] {
+        text = keypoints_to_json(keypoints).dump();
+    });
+    report.add({"metadata", "keypoints_json_encode" + name_suffix, {
+        {"time", s * 1e6, "us", Better::Lower},
+        {"bytes", static_cast<double>(text.size()), "B", Better::Neither}
+    }});
+    s = median_seconds(ctx.iterations, [&] {
+        ok = ok && nlohmann::json::parse(text).size() == keypoints.size();
+    });
+    report.add({"metadata", "keypoints_json_decode" + name_suffix, {
+        {"time", s * 1e6, "us", Better::Lower}
+    }});
+
+    using keypoint_block::DescriptorFormat;
+    std::vector<unsigned char> block;
+    for (DescriptorFormat format : {DescriptorFormat::None, DescriptorFormat::Float32,
+                                    DescriptorFormat::Uint8}) {
+        const std::string suffix =
+            std::string(keypoint_block::descriptor_format_name(format)) + name_suffix;
+        s = median_seconds(ctx.iterations, [&] {
+            ok = ok && keypoint_block::encode(keypoints, desc, format, block);
+        });
+        report.add({"metadata", "keypoints_block_encode_" + suffix, {
+            {"time", s * 1e6, "us", Better::Lower},
+            {"bytes", static_cast<double>(block.size()), "B", Better::Neither}
+        }});
+        s = median_seconds(ctx.iterations, [&] {
+            ok = ok && keypoint_block::decode(block).has_value();
+        });
+        report.add({"metadata", "keypoints_block_decode_" + suffix, {
+            {"time", s * 1e6, "us", Better::Lower}
+        }});
+    }
+    if (!ok) {
+        std::cerr << "[ERROR] metadata suite: a round trip failed\n";
+    }
+}
+
+}  // namespace bench
@@ -0,0 +1,127 @@
+#include "bench.hpp"
+
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <unistd.h>
+
+namespace bench {
+namespace {
+
+const char* better_name(Better better) {
+    switch (better) {
+        case Better::Higher: return "higher";
+        case Better::Lower:  return "lower";
+        case Better::Neither: break;
+    }
+    return "neither";
+}
+
+std::string hostname() {
+    char host[256] = {};
+    if (gethostname(host, sizeof(host) - 1) != 0) {
+        return "unknown";
+    }
+    return host;
+}
+
+}  // namespace
+
+std::vector<std::string> split_list(const std::string& list) {
+    std::vector<std::string> out;
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) {
+            out.push_back(item);
+        }
+    }
+    return out;
+}
+
+void Report::add(Result result) {
+    print(std::cout, result);
+    results_.push_back(std::move(result));
+}
+
+void Report::print(std::ostream& out, const Result& result) {
+    out << std::left << std::setw(10) << result.suite << std::setw(28) << result.name
+        << std::right;
+    for (const auto& metric : result.metrics) {
+        out << "  " << metric.name << "=" << std::fixed << std::setprecision(2)
+            << metric.value << std::defaultfloat;
+        if (!metric.unit.empty()) {
+            out << " " << metric.unit;
+        }
+    }
+    out << "\n";
+}
+
+nlohmann::json Report::to_json(const nlohmann::json& config) const {
+    nlohmann::json results = nlohmann::json::array();
+    for (const auto& result : results_) {
+        nlohmann::json metrics = nlohmann::json::object();
+        for (const auto& metric : result.metrics) {
+            metrics[metric.name] = {
+                {"value", metric.value},
+                {"unit", metric.unit},
+                {"better", better_name(metric.better)}
+            };
+        }
+        results.push_back({
+            {"suite", result.suite},
+            {"name", result.name},
+            {"metrics", std::move(metrics)}
+        });
+    }
+    return {
+        {"schema", 1},
+        {"host", hostname()},
+        {"config", config},
+        {"results", std::move(results)}
+    };
+}
+
+int compare(const nlohmann::json& baseline, const Report& report, double tolerance,
+            std::ostream& out) {
+    const nlohmann::json results = baseline.value("results", nlohmann::json::array());
+    std::map<std::string, const nlohmann::json*> previous;
+    for (const auto& result : results) {
+        previous[result.value("suite", "") + "/" + result.value("name", "")] = &result;
+    }
+
+    int regressions = 0;
+    for (const auto& result : report.results()) {
+        auto it = previous.find(result.suite + "/" + result.name);
+        if (it == previous.end()) {
+            continue;
+        }
+        const auto& old_metrics = it->second->value("metrics", nlohmann::json::object());
+        for (const auto& metric : result.metrics) {
+            auto old = old_metrics.find(metric.name);
+            if (metric.better == Better::Neither || old == old_metrics.end()) {
+                continue;
+            }
+            const double before = old->value("value", 0.0);
+            if (before == 0.0) {
+                continue;
+            }
+            const double change = (metric.value - before) / std::abs(before);
+            const bool worse = metric.better == Better::Higher ? change < -tolerance
+                                                               : change > tolerance;
+            if (worse) {
+                ++regressions;
+                out << "[REGRESSION] " << result.suite << "/" << result.name << " "
+                    << metric.name << ": " << std::fixed << std::setprecision(2) << before
+                    << " -> " << metric.value << " " << metric.unit << " (" << std::showpos
+                    << std::setprecision(1) << change * 100.0 << "%" << std::noshowpos
+                    << std::defaultfloat << ")\n";
+            }
+        }
+    }
+    return regressions;
+}
+
+}  // namespace bench
@@ -0,0 +1,54 @@
+// sift suite: cv::SIFT::detectAndCompute on the first corpus image scaled to
+// several resolutions, as the extractor runs it (8-bit BGR input, one thread).
+
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <opencv2/features2d.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "bench.hpp"
+
+namespace bench {
+namespace {
+constexpr char kDefaultSizes[] = "320x240,640x480,1280x720,1920x1080";
+}  // namespace
+
+void run_sift(const Context& ctx, Report& report) {
+    if (ctx.corpus.empty()) {
+        std::cerr << "[WARN] sift suite skipped: no corpus images\n";
+        return;
+    }
+    // Matches a multi-worker extractor, where each SIFT call gets one core.
+    const int previous_threads = cv::getNumThreads();
+    cv::setNumThreads(1);
+    auto sift = cv::SIFT::create();
+
+    for (const auto& size : split_list(ctx.args.get("sift-sizes", kDefaultSizes))) {
+        int cols = 0;
+        int rows = 0;
+        if (std::sscanf(size.c_str(), "%dx%d", &cols, &rows) != 2 || cols <= 0 || rows <= 0) {
+            std::cerr << "Skipping bad size " << size << "\n";
+            continue;
+        }
+        cv::Mat img;
+        cv::resize(ctx.corpus.front(), img, cv::Size(cols, rows), 0, 0, cv::INTER_AREA);
+
+        std::vector<cv::KeyPoint> keypoints;
+        cv::Mat desc;
+        const double s = median_seconds(ctx.iterations, [&] {
+            keypoints.clear();
+            sift->detectAndCompute(img, cv::noArray(), keypoints, desc);
+        });
+        report.add({"sift", size, {
+            {"time", s * 1e3, "ms", Better::Lower},
+            {"rate", static_cast<double>(cols) * rows / s / 1e6, "MP/s"},
+            {"keypoints", static_cast<double>(keypoints.size()), "", Better::Neither}
+        }});
+    }
+    cv::setNumThreads(previous_threads);
+}
+
+}  // namespace bench
@@ -0,0 +1,121 @@
+// sqlite suite: insert rate into the real frames schema (frame_schema) with
+// the logger's pragmas, for several batch sizes. "inline" rows carry the
+// payload blob; "ref" rows carry only the 16-byte image hash, as in the
+// default deduplicating image store.
+
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "bench.hpp"
+#include "common/frame_schema.hpp"
+#include "common/sqlite_utils.hpp"
+
+namespace bench {
+namespace {
+constexpr char kDefaultBatches[] = "1,64";
+constexpr long long kDefaultFrames = 500;
+constexpr long long kDefaultPayloadKb = 256;
+
+bool insert_frames(sqlite3* db, sqlite3_stmt* insert, int frames, int batch,
+                   const std::vector<unsigned char>& payload, bool inline_payload,
+                   const std::string& meta_json) {
+    const unsigned char hash[16] = {};
+    for (int i = 0; i < frames; ++i) {
+        if (i % batch == 0 && !sqlite_utils::exec(db, "BEGIN;", "begin batch")) {
+            return false;
+        }
+        sqlite_utils::reset(insert);
+        sqlite3_bind_int(insert, 1, i);
+        sqlite3_bind_text(insert, 2, "bench.png", -1, SQLITE_STATIC);
+        sqlite3_bind_int(insert, 3, 1080);
+        sqlite3_bind_int(insert, 4, 1920);
+        sqlite3_bind_int(insert, 5, 2000);
+        sqlite3_bind_text(insert, 6, meta_json.c_str(), static_cast<int>(meta_json.size()),
+                          SQLITE_STATIC);
+        if (inline_payload) {
+            sqlite3_bind_blob(insert, 7, payload.data(), static_cast<int>(payload.size()),
+                              SQLITE_STATIC);
+            sqlite3_bind_null(insert, 10);
+        } else {
+            sqlite3_bind_null(insert, 7);
+            sqlite3_bind_blob(insert, 10, hash, sizeof(hash), SQLITE_STATIC);
+        }
+        sqlite3_bind_text(insert, 8, "png", -1, SQLITE_STATIC);
+        if (!sqlite_utils::step(insert, "sqlite3_step(bench insert)")) {
+            return false;
+        }
+        if ((i + 1) % batch == 0 || i + 1 == frames) {
+            if (!sqlite_utils::exec(db, "COMMIT;", "commit batch")) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+void run_sqlite(const Context& ctx, Report& report) {
+    const std::string path = ctx.args.get(
+        "sqlite-db", "/tmp/voyis-bench-" + std::to_string(getpid()) + ".db");
+    const int frames = static_cast<int>(std::max(1LL, ctx.args.get_int("sqlite-frames", kDefaultFrames)));
+    const auto payload_kb = std::max(0LL, ctx.args.get_int("sqlite-payload-kb", kDefaultPayloadKb));
+    const std::vector<unsigned char> payload(static_cast<std::size_t>(payload_kb) << 10, 0xa5);
+    const std::string meta_json(400, 'm');
+
+    {
+        auto db_opt = sqlite_utils::open(path);
+        if (!db_opt) {
+            return;
+        }
+        sqlite3* db = db_opt->get();
+        if (!sqlite_utils::exec(db, "PRAGMA journal_mode=WAL;", "enable WAL") ||
+            !sqlite_utils::exec(db, "PRAGMA synchronous=NORMAL;", "set synchronous") ||
+            !frame_schema::create(db)) {
+            return;
+        }
+        auto insert = sqlite_utils::prepare(db, frame_schema::kInsertFrame, "prepare insert");
+        if (!insert) {
+            return;
+        }
+
+        for (const auto& batch_text : split_list(ctx.args.get("sqlite-batches", kDefaultBatches))) {
+            const int batch = std::max(1, std::atoi(batch_text.c_str()));
+            for (bool inline_payload : {true, false}) {
+                bool ok = true;
+                const double s = median_seconds(ctx.iterations, [&] {
+                    ok = ok && insert_frames(db, insert->get(), frames, batch, payload,
+                                             inline_payload, meta_json);
+                });
+                if (!ok) {
+                    std::cerr << "[ERROR] sqlite suite: insert failed\n";
+                    return;
+                }
+                const double bytes = inline_payload
+                    ? static_cast<double>(payload.size() + meta_json.size())
+                    : static_cast<double>(meta_json.size() + 16);
+                report.add({"sqlite",
+                            std::string(inline_payload ? "inline" : "ref") + "_batch" +
+                                std::to_string(batch),
+                            {
+                                {"rate", frames / s, "frames/s"},
+                                {"throughput", bytes * frames / s / 1e6, "MB/s"}
+                            }});
+            }
+        }
+    }
+    if (!ctx.args.has("sqlite-db")) {
+        for (const char* suffix : {"", "-wal", "-shm"}) {
+            std::error_code ec;
+            std::filesystem::remove(path + suffix, ec);
+        }
+    }
+}
+
+}  // namespace bench
@@ -0,0 +1,138 @@
+// zmq suite: IPC throughput (PUSH -> PULL, as between the pipeline stages)
+// and round-trip latency (PAIR ping-pong) for a range of message sizes.
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+#include <zmq.h>
+
+#include "bench.hpp"
+#include "common/latency.hpp"
+#include "common/zmq_utils.hpp"
+
+namespace bench {
+namespace {
+constexpr char kDefaultSizes[] = "1K,16K,256K,1M,4M,16M";
+// Bytes moved per timed throughput run and per latency run; the message
+// counts are derived from these and clamped.
+constexpr std::size_t kThroughputBytes = std::size_t{256} << 20;
+constexpr std::size_t kLatencyBytes = std::size_t{64} << 20;
+
+// "64K" -> 65536. Returns 0 for a malformed size.
+std::size_t parse_size(const std::string& text) {
+    std::size_t pos = 0;
+    unsigned long long value = 0;
+    try {
+        value = std::stoull(text, &pos);
+    } catch (const std::exception&) {
+        return 0;
+    }
+    const std::string suffix = text.substr(pos);
+    if (suffix == "K" || suffix == "k") {
+        value <<= 10;
+    } else if (suffix == "M" || suffix == "m") {
+        value <<= 20;
+    } else if (!suffix.empty()) {
+        return 0;
+    }
+    return static_cast<std::size_t>(value);
+}
+
+std::string endpoint(const char* name) {
+    return "ipc:///tmp/voyis-bench-" + std::to_string(getpid()) + "-" + name + ".ipc";
+}
+
+// Receives and drops `count` messages.
+void drain(void* socket, std::size_t count) {
+    for (std::size_t i = 0; i < count; ++i) {
+        if (!zmq_utils::recv_message(socket, 0, "zmq_msg_recv(bench)")) {
+            return;
+        }
+    }
+}
+
+// Sends every received message straight back.
+void echo(void* socket, std::size_t count) {
+    for (std::size_t i = 0; i < count; ++i) {
+        auto msg = zmq_utils::recv_message(socket, 0, "zmq_msg_recv(echo)");
+        if (!msg || zmq_utils::send_message(socket, *msg, 0, "zmq_msg_send(echo)") !=
+                        zmq_utils::SendResult::Ok) {
+            return;
+        }
+    }
+}
+
+}  // namespace
+
+void run_zmq(const Context& ctx, Report& report) {
+    void* context = zmq_ctx_new();
+    const std::string push_endpoint = endpoint("push");
+    const std::string pair_endpoint = endpoint("pair");
+    void* push = zmq_socket(context, ZMQ_PUSH);
+    void* pull = zmq_socket(context, ZMQ_PULL);
+    void* ping = zmq_socket(context, ZMQ_PAIR);
+    void* pong = zmq_socket(context, ZMQ_PAIR);
+    if (zmq_utils::bind_endpoint(pull, push_endpoint) != 0 ||
+        zmq_connect(push, push_endpoint.c_str()) != 0 ||
+        zmq_utils::bind_endpoint(pong, pair_endpoint) != 0 ||
+        zmq_connect(ping, pair_endpoint.c_str()) != 0) {
+        std::cerr << "[ERROR] zmq suite: socket setup failed: " << zmq_strerror(errno) << "\n";
+    } else {
+        for (const auto& size_text : split_list(ctx.args.get("zmq-sizes", kDefaultSizes))) {
+            const std::size_t size = parse_size(size_text);
+            if (size == 0) {
+                std::cerr << "Skipping bad size " << size_text << "\n";
+                continue;
+            }
+            const std::vector<unsigned char> payload(size, 0x5a);
+
+            const std::size_t count = std::clamp<std::size_t>(kThroughputBytes / size, 20, 200000);
+            const double s = median_seconds(ctx.iterations, [&] {
+                std::thread receiver(drain, pull, count);
+                for (std::size_t i = 0; i < count; ++i) {
+                    zmq_utils::send_bytes(push, payload, 0, "zmq_send(bench)");
+                }
+                receiver.join();
+            });
+            const double mb = static_cast<double>(size) * static_cast<double>(count) / 1e6;
+
+            const std::size_t round_trips = std::clamp<std::size_t>(kLatencyBytes / size, 10, 20000);
+            latency::Histogram rtt;
+            std::thread echoer(echo, pong, round_trips);
+            for (std::size_t i = 0; i < round_trips; ++i) {
+                const std::uint64_t start = latency::now_ns();
+                if (zmq_utils::send_bytes(ping, payload, 0, "zmq_send(ping)") !=
+                        zmq_utils::SendResult::Ok ||
+                    !zmq_utils::recv_message(ping, 0, "zmq_msg_recv(ping)")) {
+                    break;
+                }
+                rtt.record(latency::now_ns() - start);
+            }
+            echoer.join();
+
+            report.add({"zmq", "ipc_" + size_text, {
+                {"throughput", mb / s, "MB/s"},
+                {"messages", static_cast<double>(count) / s, "msg/s"},
+                {"rtt_p50", static_cast<double>(rtt.percentile(0.50)) / 1e3, "us", Better::Lower},
+                {"rtt_p99", static_cast<double>(rtt.percentile(0.99)) / 1e3, "us", Better::Lower}
+            }});
+        }
+    }
+    for (void* socket : {push, pull, ping, pong}) {
+        int linger = 0;
+        zmq_setsockopt(socket, ZMQ_LINGER, &linger, sizeof(linger));
+        zmq_close(socket);
+    }
+    zmq_ctx_term(context);
+    for (const auto& path : {push_endpoint, pair_endpoint}) {
+        unlink(path.substr(std::string("ipc://").size()).c_str());
+    }
+}
+
+}  // namespace bench
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+// Counts heap allocations of the whole process, to check that a steady-state
+// frame loop stays off the allocator. Counting needs a build with
+// -DVOYIS_COUNT_ALLOCATIONS=ON, which interposes malloc and its siblings
+// (glibc only) so allocations made inside OpenCV, ZeroMQ and SQLite are
+// seen too; otherwise enabled() is false and the counters stay at zero.
+namespace alloc_counter {
+
+bool enabled();
+
+// malloc, calloc, realloc and aligned allocations so far, from all threads.
+// operator new lands in malloc and is included.
+std::uint64_t allocations();
+
+// Allocations per frame over an interval, printed as
+//   Allocations <name>: frames=... per_frame=... total=...
+// frame() may be called from any thread; maybe_report() from one only.
+// Prints nothing when counting is not compiled in.
+class Reporter {
+public:
+    Reporter(const char* name, std::chrono::seconds interval);
+
+    void frame() { frames_.fetch_add(1, std::memory_order_relaxed); }
+
+    void maybe_report(std::ostream& out);
+
+private:
+    const char* name_;
+    const std::chrono::steady_clock::duration interval_;
+    std::chrono::steady_clock::time_point next_report_;
+    std::atomic<std::uint64_t> frames_{0};
+    std::uint64_t last_frames_ = 0;
+    std::uint64_t last_allocations_ = 0;
+};
+
+}  // namespace alloc_counter
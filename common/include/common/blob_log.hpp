@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <unordered_map>
+
+namespace blob_log {
+
+// Location of one payload inside a segmented blob log. This tuple is all
+// SQLite stores for an image when the log is enabled.
+struct BlobRef {
+    std::uint32_t segment_id{};
+    std::uint64_t offset{};
+    std::uint32_t length{};
+    // Low 32 bits of hash_utils::hash128() of the payload.
+    std::uint32_t checksum{};
+};
+
+std::uint32_t checksum(std::span<const unsigned char> data);
+
+std::filesystem::path segment_path(const std::filesystem::path& dir, std::uint32_t segment_id);
+
+// Appends payloads to rotating segment files "segment-XXXXXXXX.blob" in one
+// directory. A new run always starts a fresh segment after the highest
+// existing one, so bytes that a crash left unreferenced are never reused.
+class Writer {
+public:
+    // Returns std::nullopt when the directory or first segment cannot be
+    // created. `max_segment_bytes` is a soft cap: a segment is rotated
+    // before an append that would overflow it, and a payload larger than
+    // the cap gets a segment of its own.
+    static std::optional<Writer> open(
+        const std::filesystem::path& dir,
+        std::uint64_t max_segment_bytes
+    );
+
+    ~Writer();
+    Writer(Writer&& other) noexcept;
+    Writer& operator=(Writer&& other) noexcept;
+    Writer(const Writer&) = delete;
+    Writer& operator=(const Writer&) = delete;
+
+    std::optional<BlobRef> append(std::span<const unsigned char> data, std::uint32_t checksum);
+
+    // Flushes appended payloads to stable storage. Call before committing
+    // the SQLite rows that reference them.
+    bool sync();
+
+private:
+    Writer(std::filesystem::path dir, std::uint64_t max_segment_bytes, std::uint32_t next_id);
+
+    bool roll();
+
+    std::filesystem::path dir_;
+    std::uint64_t max_segment_bytes_ = 0;
+    std::uint32_t segment_id_ = 0;
+    std::uint64_t segment_size_ = 0;
+    int fd_ = -1;
+    bool dirty_ = false;
+};
+
+// Maps segments read-only on first use and hands out views straight into
+// the mapping. Views stay valid for the lifetime of the Reader. Safe to use
+// from several threads.
+class Reader {
+public:
+    explicit Reader(std::filesystem::path dir);
+    ~Reader();
+    Reader(const Reader&) = delete;
+    Reader& operator=(const Reader&) = delete;
+
+    // Returns std::nullopt when the segment is missing, the range is out of
+    // bounds, or (with `verify`) the checksum does not match.
+    std::optional<std::span<const unsigned char>> read(const BlobRef& ref, bool verify = true);
+
+private:
+    struct Mapping;
+
+    const Mapping* map_segment(std::uint32_t segment_id, std::uint64_t min_size);
+
+    std::filesystem::path dir_;
+    std::mutex mutex_;
+    // Superseded mappings of a growing segment are kept so that views handed
+    // out earlier stay valid.
+    std::unordered_multimap<std::uint32_t, std::unique_ptr<Mapping>> mappings_;
+};
+
+}  // namespace blob_log
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <utility>
+#include <vector>
+
+// Recycles the byte buffers frames travel in (payloads, keypoint blocks,
+// re-encoded images), so a steady stream stops going to the allocator once
+// the pool has warmed up. Buffers keep their capacity across uses; a fresh
+// buffer is reserved to the largest size seen so far, so the pool settles
+// at the frame size after the first few frames. Thread-safe.
+class BufferPool : public std::enable_shared_from_this<BufferPool> {
+public:
+    class Buffer;
+
+    // Keeps at most `max_idle` buffers between uses.
+    static std::shared_ptr<BufferPool> create(std::size_t max_idle = 64) {
+        return std::shared_ptr<BufferPool>(new BufferPool(max_idle));
+    }
+
+    // An empty buffer, from the idle list when there is one.
+    Buffer acquire();
+
+    // Buffers handed out fresh vs. reused.
+    std::uint64_t misses() const { return misses_.load(std::memory_order_relaxed); }
+    std::uint64_t hits() const { return hits_.load(std::memory_order_relaxed); }
+
+private:
+    explicit BufferPool(std::size_t max_idle) : max_idle_(max_idle) {}
+
+    void release(std::vector<unsigned char>&& bytes);
+
+    const std::size_t max_idle_;
+    std::mutex mutex_;
+    std::vector<std::vector<unsigned char>> idle_;
+    std::atomic<std::size_t> high_water_{0};
+    std::atomic<std::uint64_t> misses_{0};
+    std::atomic<std::uint64_t> hits_{0};
+};
+
+// A byte vector that goes back to its pool when destroyed. A default-
+// constructed Buffer has no pool and behaves like a plain vector. Copies
+// take a buffer from the same pool.
+class BufferPool::Buffer {
+public:
+    Buffer() = default;
+    ~Buffer() { reset(); }
+
+    Buffer(Buffer&& other) noexcept
+        : pool_(std::move(other.pool_)), bytes_(std::move(other.bytes_)) {}
+    Buffer& operator=(Buffer&& other) noexcept {
+        if (this != &other) {
+            reset();
+            pool_ = std::move(other.pool_);
+            bytes_ = std::move(other.bytes_);
+        }
+        return *this;
+    }
+    Buffer(const Buffer& other) : Buffer(other.pool_ ? other.pool_->acquire() : Buffer()) {
+        bytes_.assign(other.bytes_.begin(), other.bytes_.end());
+    }
+    Buffer& operator=(const Buffer& other) {
+        if (this != &other) {
+            if (!pool_ && other.pool_) {
+                *this = other.pool_->acquire();
+            }
+            bytes_.assign(other.bytes_.begin(), other.bytes_.end());
+        }
+        return *this;
+    }
+
+    std::vector<unsigned char>& vec() { return bytes_; }
+    const std::vector<unsigned char>& vec() const { return bytes_; }
+    std::span<const unsigned char> bytes() const { return bytes_; }
+    std::size_t size() const { return bytes_.size(); }
+    bool empty() const { return bytes_.empty(); }
+    void clear() { bytes_.clear(); }
+
+    // Hands the bytes back to the pool now; the Buffer is left empty.
+    void reset() {
+        if (pool_) {
+            pool_->release(std::move(bytes_));
+            pool_.reset();
+        }
+        bytes_ = {};
+    }
+
+private:
+    friend class BufferPool;
+    Buffer(std::shared_ptr<BufferPool> pool, std::vector<unsigned char> bytes)
+        : pool_(std::move(pool)), bytes_(std::move(bytes)) {}
+
+    std::shared_ptr<BufferPool> pool_;
+    std::vector<unsigned char> bytes_;
+};
+
+inline BufferPool::Buffer BufferPool::acquire() {
+    std::vector<unsigned char> bytes;
+    {
+        std::lock_guard lock(mutex_);
+        if (!idle_.empty()) {
+            bytes = std::move(idle_.back());
+            idle_.pop_back();
+        }
+    }
+    if (bytes.capacity() == 0) {
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        bytes.reserve(high_water_.load(std::memory_order_relaxed));
+    } else {
+        hits_.fetch_add(1, std::memory_order_relaxed);
+    }
+    // The pool outlives its buffers: each one holds a reference.
+    return Buffer(shared_from_this(), std::move(bytes));
+}
+
+inline void BufferPool::release(std::vector<unsigned char>&& bytes) {
+    if (bytes.capacity() == 0) {
+        return;
+    }
+    std::size_t seen = high_water_.load(std::memory_order_relaxed);
+    while (bytes.size() > seen &&
+           !high_water_.compare_exchange_weak(seen, bytes.size(), std::memory_order_relaxed)) {
+    }
+    bytes.clear();
+    std::lock_guard lock(mutex_);
+    if (idle_.size() < max_idle_) {
+        idle_.push_back(std::move(bytes));
+    }
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace cli_utils {
+
+// Minimal command line parser shared by the apps. Accepts positional
+// arguments plus "--name=value" options and bare "--name" flags.
+class Args {
+public:
+    Args(int argc, char** argv);
+
+    const std::string& program() const { return program_; }
+    const std::vector<std::string>& positional() const { return positional_; }
+
+    bool has(std::string_view name) const;
+    std::optional<std::string> value(std::string_view name) const;
+
+    std::string get(std::string_view name, std::string_view fallback) const;
+    long long get_int(std::string_view name, long long fallback) const;
+    double get_double(std::string_view name, double fallback) const;
+
+private:
+    std::string program_;
+    std::vector<std::string> positional_;
+    std::unordered_map<std::string, std::string> options_;
+};
+
+}  // namespace cli_utils
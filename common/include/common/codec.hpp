@@ -0,0 +1,71 @@
+#pragma once
+
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+namespace codec {
+
+// Wire codecs for frame payloads. The active codec of a frame is named by
+// FrameMetadata::encoding, using the strings returned by encoding_name().
+enum class Kind {
+    RawBgr8,   // "raw_bgr8": packed 8-bit BGR pixels, no compression
+    RawGray8,  // "raw_gray8": packed 8-bit grayscale pixels
+    Png,       // "png"
+    Jpeg,      // "jpeg"
+    Qoi        // "qoi": fast lossless (Quite OK Image format)
+};
+
+struct Options {
+    Kind kind = Kind::Png;
+    // PNG compression level (0-9) or JPEG quality (0-100); -1 keeps the
+    // OpenCV default. Ignored by the other codecs.
+    int level = -1;
+};
+
+// Parses a codec spec such as "png", "png:1", "jpeg:85", "raw_bgr8" or "qoi".
+std::optional<Options> parse(std::string_view spec);
+
+// Inverse of parse(), e.g. "png:1".
+std::string describe(const Options& options);
+
+std::string_view encoding_name(Kind kind);
+
+std::optional<Kind> kind_from_encoding(std::string_view encoding);
+
+// Identifies an encoded file from its leading bytes. Returns "jpeg", "png",
+// "bmp", "qoi" or an empty view when the format is unknown.
+std::string_view sniff(std::span<const unsigned char> data);
+
+// Encodes an 8-bit BGR or grayscale image. Color conversion happens when
+// the codec needs a different channel count than `img` has.
+bool encode(const cv::Mat& img, const Options& options, std::vector<unsigned char>& out);
+
+// Decodes a payload to an 8-bit BGR or grayscale image; returns an empty
+// Mat on failure. Raw payloads need the frame dimensions and are returned
+// as a view over `data` (clone it if it must outlive the buffer). Encodings
+// without a dedicated codec, such as passthrough "bmp", go to cv::imdecode.
+cv::Mat decode(
+    std::string_view encoding,
+    std::span<const unsigned char> data,
+    int rows,
+    int cols
+);
+
+// Same, decoding into `out` so a caller that keeps one Mat per worker
+// reuses its pixel buffer from frame to frame (same-sized frames decode
+// without allocating). Raw payloads still leave a view in `out`. Returns
+// false, with `out` empty, on failure.
+bool decode(
+    std::string_view encoding,
+    std::span<const unsigned char> data,
+    int rows,
+    int cols,
+    cv::Mat& out
+);
+
+}  // namespace codec
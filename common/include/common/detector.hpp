@@ -0,0 +1,108 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <opencv2/features2d.hpp>
+
+// The feature_extractor's detection stage, shared by the extractor process
+// and the in-process voyis_pipeline.
+namespace detector {
+
+enum class Backend {
+    Sift,       // float descriptors, the most robust and the slowest
+    Orb,        // oriented FAST + rotated BRIEF, binary descriptors
+    Akaze,      // nonlinear scale space, binary descriptors
+    FastBrief   // FAST corners + BRIEF descriptors, the cheapest
+};
+
+// A detection tier: backend, keypoint cap and working resolution.
+struct Config {
+    Backend backend = Backend::Sift;
+    // Keep at most this many of the strongest keypoints; 0 keeps all.
+    int max_features = 0;
+    // Detect on the image resized by this factor (0 < scale <= 1).
+    // Keypoints are mapped back to full-resolution coordinates.
+    double scale = 1.0;
+    // Split the (scaled) frame into tiles of about this edge length, in
+    // pixels, and detect on them in parallel; 0 detects on the whole frame.
+    int tile = 0;
+    // Context read around each tile. SIFT needs it for its scale space and
+    // descriptor window; 128 px keeps keypoints up to size ~24 identical to
+    // a whole-frame run.
+    int tile_margin = 128;
+};
+
+// Parses "<backend>[:<max features>][@<scale>][#<tile>]", where backend is
+// sift, orb, akaze or fast-brief, e.g. "sift", "orb:2000", "sift@0.5",
+// "sift#1024".
+std::optional<Config> parse(std::string_view spec);
+
+// Inverse of parse(); recorded in FrameMetadata::detector.
+std::string describe(const Config& config);
+
+struct Features {
+    std::vector<cv::KeyPoint> keypoints;
+    cv::Mat descriptors;
+};
+
+// Runs keypoint detection and description on decoded frames. The OpenCV
+// detectors keep per-call scratch state, so every worker thread owns one.
+// Input is converted to grayscale once up front (the detectors would do it
+// internally anyway) into a buffer reused across frames.
+//
+// With Config::tile set, one frame is split into tiles that are detected
+// on OpenCV's thread pool (cv::parallel_for_), each with its own detector
+// instance. A tile reads Config::tile_margin pixels of context past its
+// edges but keeps only the keypoints centred inside it; keypoints found
+// twice just either side of a seam are deduplicated, and the keypoint cap
+// is applied to the merged set.
+class Detector {
+public:
+    explicit Detector(const Config& config = {});
+
+    // Replaces the contents of `out`, reusing its buffers.
+    void detect(const cv::Mat& image, Features& out);
+
+    const Config& config() const { return config_; }
+
+private:
+    struct Engine {
+        // Detects and describes; for FastBrief it only describes.
+        cv::Ptr<cv::Feature2D> impl;
+        // FastBrief's detector.
+        cv::Ptr<cv::Feature2D> fast;
+        // AKAZE's output before the keypoint cap, and the ranking scratch.
+        Features uncapped;
+        std::vector<int> order;
+    };
+
+    struct Tile {
+        // Keypoints centred in `core` belong to this tile.
+        cv::Rect core;
+        // `core` plus the margin, clipped to the frame.
+        cv::Rect window;
+        Engine engine;
+        Features features;
+    };
+
+    Engine make_engine() const;
+    // Detects on `input` with `engine`, keeping the strongest
+    // Config::max_features keypoints.
+    void run(Engine& engine, const cv::Mat& input, Features& out) const;
+    void layout_tiles(cv::Size size);
+    void detect_tiled(const cv::Mat& input, Features& out);
+
+    Config config_;
+    Engine engine_;
+    cv::Mat gray_;
+    cv::Mat scaled_;
+    // Tiles of the last frame size; their engines are kept across frames.
+    std::vector<Tile> tiles_;
+    cv::Size tiled_size_;
+};
+
+}  // namespace detector
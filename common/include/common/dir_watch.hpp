@@ -0,0 +1,68 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <unordered_set>
+
+// Streaming view of an image folder (Linux, inotify). Files already in the
+// folder are listed lazily, one directory entry per call, so a folder of
+// millions of files starts at once; files that land later are picked up
+// when they are closed after writing or moved in. The watch is set up
+// before the listing starts, so a file arriving mid-scan is not missed.
+// The listing skips files written since the watch started, which may be
+// half-written, and leaves them to their close event; a file is returned
+// once, whether the listing or an event finds it first.
+namespace dir_watch {
+
+class Feed {
+public:
+    // Prints an error and returns std::nullopt when `folder` is not a
+    // directory or cannot be watched.
+    static std::optional<Feed> open(const std::filesystem::path& folder);
+
+    ~Feed();
+    Feed(Feed&& other) noexcept;
+    Feed& operator=(Feed&& other) noexcept;
+    Feed(const Feed&) = delete;
+    Feed& operator=(const Feed&) = delete;
+
+    // The next image file (.png/.jpg/.jpeg/.bmp), or std::nullopt when none
+    // turned up within `timeout`. New arrivals go ahead of the rest of the
+    // initial listing. Single-threaded.
+    std::optional<std::filesystem::path> next(std::chrono::milliseconds timeout);
+
+    bool scanning() const { return scan_.has_value(); }
+    // Files returned from the initial listing and from inotify events.
+    std::uint64_t listed() const { return listed_; }
+    std::uint64_t landed() const { return landed_; }
+    // Times the kernel event queue overflowed; files in the gap are lost.
+    std::uint64_t overflows() const { return overflows_; }
+
+private:
+    Feed(std::filesystem::path folder, int fd);
+
+    // Moves pending inotify events into arrivals_, waiting up to `timeout`
+    // for the first one.
+    void read_events(std::chrono::milliseconds timeout);
+    void end_scan();
+    void close();
+
+    std::filesystem::path folder_;
+    int fd_ = -1;
+    std::optional<std::filesystem::directory_iterator> scan_;
+    std::filesystem::file_time_type watch_start_;
+    // Names that arrived during the listing, which it then skips.
+    std::unordered_set<std::string> landed_during_scan_;
+    // Names the listing returned, whose close events are then skipped.
+    std::unordered_set<std::string> listed_by_scan_;
+    std::deque<std::filesystem::path> arrivals_;
+    std::uint64_t listed_ = 0;
+    std::uint64_t landed_ = 0;
+    std::uint64_t overflows_ = 0;
+};
+
+}  // namespace dir_watch
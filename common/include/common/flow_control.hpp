@@ -0,0 +1,281 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <zmq.h>
+
+#include "common/zmq_utils.hpp"
+
+// Flow control between pipeline stages.
+//
+// With --flow=credit every receiving stage grants its upstream one credit
+// per frame it can take (an initial window, then one per frame it is done
+// with), over a separate PUSH/PULL "credit link". A sender only puts a frame
+// on the data link when it holds a credit, so frames wait or are shed at the
+// sender, by policy, instead of being lost to a full ZeroMQ queue. With
+// --flow=none (the default) ZeroMQ's high-water marks are the only limit
+// and the same policies apply when a send would block.
+//
+// Credits are pooled per sender: with several downstream peers behind one
+// PUSH socket the sender's budget is the sum of their windows.
+namespace flow_control {
+
+enum class Mode {
+    None,   // ZeroMQ high-water marks only
+    Credit  // downstream grants credits over a credit link
+};
+
+// Parses "none" or "credit".
+std::optional<Mode> parse_mode(std::string_view spec);
+
+enum class Policy {
+    Block,       // wait for a credit (or for room in the ZeroMQ queue)
+    DropNewest,  // drop the frame that has no credit
+    DropOldest   // queue up to a limit at the sender and drop the oldest
+};
+
+// Parses "block", "drop-newest" or "drop-oldest".
+std::optional<Policy> parse_policy(std::string_view spec);
+std::string_view policy_name(Policy policy);
+
+// Per-link counters, printed by report().
+struct LinkCounters {
+    std::atomic<std::uint64_t> sent{0};
+    std::atomic<std::uint64_t> dropped_newest{0};
+    // Of dropped_newest, the frames ZeroMQ refused (SendResult::WouldBlock)
+    // rather than ones that found no credit.
+    std::atomic<std::uint64_t> dropped_would_block{0};
+    std::atomic<std::uint64_t> dropped_oldest{0};
+    std::atomic<std::uint64_t> send_errors{0};
+    // Sends that found the ZeroMQ queue full despite holding a credit.
+    std::atomic<std::uint64_t> would_block{0};
+    std::atomic<std::uint64_t> blocked_us{0};
+    std::atomic<std::uint64_t> credits{0};
+    std::atomic<std::uint64_t> probes{0};
+
+    // "Link <name>: sent=... dropped_newest=... ..." (cumulative).
+    void report(std::ostream& out, std::string_view name) const;
+};
+
+// Owns the counters of every link a stage sends on and prints them
+// periodically, like latency::Recorder.
+class Reporter {
+public:
+    explicit Reporter(std::chrono::seconds interval);
+
+    // Counters live as long as the Reporter; register them at startup.
+    LinkCounters& add(std::string name);
+
+    // Prints the cumulative counters once the interval has passed. Call it
+    // from one thread only.
+    void maybe_report(std::ostream& out);
+    void report(std::ostream& out) const;
+
+private:
+    struct Entry {
+        std::string name;
+        std::unique_ptr<LinkCounters> counters;
+    };
+
+    std::chrono::steady_clock::duration interval_;
+    std::chrono::steady_clock::time_point next_report_;
+    std::vector<Entry> entries_;
+};
+
+// Sender side of a credit link: a PULL socket that collects grants.
+class CreditGate {
+public:
+    // `bind` chooses whether this end binds or connects `endpoint`.
+    static std::optional<CreditGate> open(
+        void* context,
+        const std::string& endpoint,
+        bool bind,
+        LinkCounters& counters
+    );
+
+    ~CreditGate();
+    CreditGate(CreditGate&& other) noexcept;
+    CreditGate& operator=(CreditGate&& other) noexcept;
+    CreditGate(const CreditGate&) = delete;
+    CreditGate& operator=(const CreditGate&) = delete;
+
+    // Takes a credit if one is available. After `probe_interval` without any
+    // credit a single frame may go out anyway: a restarted downstream stage
+    // answers it with a fresh window, so lost grants cannot stall the link.
+    bool try_acquire();
+
+    // Waits up to `timeout` for a credit (-1 ms waits forever).
+    bool acquire(std::chrono::milliseconds timeout);
+
+    // Gives back a credit taken for a send that did not happen.
+    void refund() { ++available_; }
+
+    std::uint64_t available() const { return available_; }
+
+private:
+    CreditGate(void* socket, LinkCounters& counters);
+
+    // Drains pending grants; waits up to `timeout_ms` for the first one.
+    void collect(long timeout_ms);
+
+    void* socket_ = nullptr;
+    LinkCounters* counters_;
+    std::uint64_t available_ = 0;
+    std::chrono::steady_clock::time_point last_credit_;
+    std::chrono::milliseconds probe_interval_{1000};
+};
+
+// Receiver side of a credit link: a PUSH socket that sends grants. Counting
+// is thread-safe; flush() must be called from a single thread.
+class CreditGrant {
+public:
+    static std::optional<CreditGrant> open(
+        void* context,
+        const std::string& endpoint,
+        bool bind,
+        std::uint32_t window
+    );
+
+    ~CreditGrant();
+    CreditGrant(CreditGrant&& other) noexcept;
+    CreditGrant& operator=(CreditGrant&& other) noexcept;
+    CreditGrant(const CreditGrant&) = delete;
+    CreditGrant& operator=(const CreditGrant&) = delete;
+
+    // A frame arrived on the data link.
+    void on_received() { received_.fetch_add(1, std::memory_order_relaxed); }
+    // A frame left this stage (forwarded, stored or dropped).
+    void on_consumed() { consumed_.fetch_add(1, std::memory_order_relaxed); }
+
+    // Sends the credits owed upstream. Grants are batched to a quarter of the
+    // window; a frame that arrived without a credit (a probe, or an upstream
+    // that restarted) re-grants the whole window.
+    void flush();
+
+private:
+    CreditGrant(void* socket, std::uint32_t window);
+
+    void* socket_ = nullptr;
+    std::uint32_t window_;
+    std::atomic<std::uint64_t> received_{0};
+    std::atomic<std::uint64_t> consumed_{0};
+    std::uint64_t granted_ = 0;
+    std::uint64_t consumed_granted_ = 0;
+    // Credits decided on but not yet accepted by ZeroMQ (no peer yet).
+    std::uint64_t pending_ = 0;
+};
+
+// Puts frames of one link on the wire according to a Policy, using credits
+// when a gate is given. `send` transmits one frame with the given ZeroMQ
+// flags (0 or ZMQ_DONTWAIT) and must leave the frame intact on WouldBlock.
+template <typename Frame>
+class Sender {
+public:
+    using SendFn = std::function<zmq_utils::SendResult(Frame&, int flags)>;
+
+    Sender(Policy policy, std::size_t queue_limit, CreditGate* gate, LinkCounters& counters,
+           SendFn send)
+        : policy_(policy),
+          queue_limit_(std::max<std::size_t>(1, queue_limit)),
+          gate_(gate),
+          counters_(counters),
+          send_(std::move(send)) {}
+
+    // Sends, queues or drops `frame`.
+    void offer(Frame frame) {
+        switch (policy_) {
+            case Policy::Block:
+                send_blocking(frame);
+                return;
+            case Policy::DropNewest: {
+                const Attempt attempt = try_send(frame);
+                if (attempt != Attempt::Sent) {
+                    counters_.dropped_newest.fetch_add(1, std::memory_order_relaxed);
+                }
+                if (attempt == Attempt::WouldBlock) {
+                    counters_.dropped_would_block.fetch_add(1, std::memory_order_relaxed);
+                }
+                return;
+            }
+            case Policy::DropOldest:
+                queue_.push_back(std::move(frame));
+                if (queue_.size() > queue_limit_) {
+                    queue_.pop_front();
+                    counters_.dropped_oldest.fetch_add(1, std::memory_order_relaxed);
+                }
+                pump();
+                return;
+        }
+    }
+
+    // Sends queued frames while credits and queue room last. Call it between
+    // offers so a drop-oldest queue drains when credits come back.
+    void pump() {
+        while (!queue_.empty() && try_send(queue_.front()) == Attempt::Sent) {
+            queue_.pop_front();
+        }
+    }
+
+    std::size_t queued() const { return queue_.size(); }
+
+private:
+    enum class Attempt { Sent, NoCredit, WouldBlock };
+
+    // Anything but Sent leaves the frame with us.
+    Attempt try_send(Frame& frame) {
+        if (gate_ && !gate_->try_acquire()) {
+            return Attempt::NoCredit;
+        }
+        auto rc = send_(frame, ZMQ_DONTWAIT);
+        if (rc == zmq_utils::SendResult::WouldBlock) {
+            counters_.would_block.fetch_add(1, std::memory_order_relaxed);
+            if (gate_) {
+                gate_->refund();
+            }
+            return Attempt::WouldBlock;
+        }
+        count(rc);
+        return Attempt::Sent;
+    }
+
+    void send_blocking(Frame& frame) {
+        auto start = std::chrono::steady_clock::now();
+        if (gate_) {
+            gate_->acquire(std::chrono::milliseconds(-1));
+        }
+        count(send_(frame, 0));
+        counters_.blocked_us.fetch_add(
+            static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start).count()),
+            std::memory_order_relaxed);
+    }
+
+    void count(zmq_utils::SendResult rc) {
+        if (rc == zmq_utils::SendResult::Ok) {
+            counters_.sent.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            counters_.send_errors.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    const Policy policy_;
+    const std::size_t queue_limit_;
+    CreditGate* gate_;
+    LinkCounters& counters_;
+    SendFn send_;
+    std::deque<Frame> queue_;
+};
+
+}  // namespace flow_control
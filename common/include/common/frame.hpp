@@ -1,8 +1,40 @@
 #pragma once
+#include <cstdint>
 #include <string>
 #include <optional>
+#include <string_view>
 #include <nlohmann/json.hpp>
 
+// Stage boundary timestamps in latency::now_ns() nanoseconds, each taken
+// when the step finished; 0 when a stage did not record it. Carried in the
+// metadata as the "t" object so every hop sees the upstream stamps.
+struct StageTimestamps {
+    std::uint64_t gen_read{};
+    std::uint64_t gen_encode{};
+    std::uint64_t gen_send{};
+    std::uint64_t ext_recv{};
+    std::uint64_t ext_decode{};
+    std::uint64_t ext_sift{};
+    std::uint64_t ext_send{};
+    std::uint64_t log_recv{};
+    std::uint64_t log_commit{};
+};
+
+// FrameMetadata::flags bits.
+// The image part is a shm_ring::Descriptor; the payload is in shared memory.
+inline constexpr std::uint32_t kFlagShmPayload = 1u << 0;
+// The extractor shed the frame to keep up (feature_extractor --max-age-ms,
+// --max-backlog): the record carries metadata only, with an empty image part
+// and no keypoints. One bit per reason.
+inline constexpr std::uint32_t kFlagShedAge = 1u << 1;
+inline constexpr std::uint32_t kFlagShedBacklog = 1u << 2;
+inline constexpr std::uint32_t kFlagShed = kFlagShedAge | kFlagShedBacklog;
+// The keypoints come from the extractor's cheaper --degrade-detector tier.
+inline constexpr std::uint32_t kFlagDegraded = 1u << 3;
+// The keypoints were moved by optical flow from the last keyframe instead
+// of detected (feature_extractor --track).
+inline constexpr std::uint32_t kFlagTracked = 1u << 4;
+
 struct FrameMetadata {
     int         seq_number{};
     std::string image_name;
@@ -11,7 +43,19 @@ struct FrameMetadata {
     std::string encoding;  
     std::size_t data_bytes{};
     int         keypoint_count{}; 
+    // Random id picked by each image_generator run; (stream_id, seq_number)
+    // identifies a frame even across generator restarts.
+    std::uint64_t stream_id{};
+    std::string extractor_id;
+    // Format of the binary keypoint block sent as an extra message part
+    // after the image (keypoint_block::kFormatName). Empty when the
+    // keypoints are only listed in the JSON metadata.
+    std::string keypoint_format;
+    // Detection tier that produced the keypoints, detector::describe().
+    std::string detector;
+    std::uint32_t flags{};
+    StageTimestamps t;
 
     nlohmann::json to_json() const;
-    static std::optional<FrameMetadata> from_json(const std::string& s);
+    static std::optional<FrameMetadata> from_json(std::string_view s);
 };
\ No newline at end of file
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "common/frame.hpp"
+
+// Binary wire form of FrameMetadata, sent as the first message part in
+// place of the JSON metadata. All integers are little-endian:
+//
+//   0   char[4]  magic "VFHD"
+//   4   u16      version (1)
+//   6   u16      fixed_bytes: size of the fixed part, preamble included
+//   8   i64      seq_number
+//   16  u64      stream_id
+//   24  u64      data_bytes
+//   32  i32      rows, cols, keypoint_count
+//   44  u32      flags (kFlagShmPayload, ...)
+//   48  u64[9]   stage timestamps, in StageTimestamps order
+//   120 u16      string count, then per string a u16 length and the bytes:
+//                image_name, encoding, extractor_id, keypoint_format, detector
+//
+// New fields are appended to the fixed part (growing fixed_bytes) or to the
+// string list. Readers skip what they do not know and read fields a shorter
+// header lacks as 0 or empty, so the version only changes for layouts that
+// older readers cannot handle.
+namespace frame_header {
+
+inline constexpr std::uint16_t kVersion = 1;
+// Size of a version 1 header's fixed part.
+inline constexpr std::size_t kFixedBytes = 120;
+
+enum class Format {
+    Binary,  // this header
+    Json     // FrameMetadata::to_json(), for debugging and older peers
+};
+
+// Parses "binary" or "json".
+std::optional<Format> parse_format(std::string_view spec);
+
+// True when `data` starts with the header magic. The first part of a frame
+// is JSON metadata otherwise.
+bool is_header(std::span<const unsigned char> data);
+
+// Serializes `meta` into `out`, reusing its capacity.
+void encode(const FrameMetadata& meta, std::vector<unsigned char>& out);
+
+// Reads a header in place: accessors decode the fixed-offset fields on
+// demand and strings are views into `data`, which must outlive the View.
+class View {
+public:
+    static std::optional<View> parse(std::span<const unsigned char> data);
+
+    std::int64_t seq_number() const { return i64(8); }
+    std::uint64_t stream_id() const { return u64(16); }
+    std::uint64_t data_bytes() const { return u64(24); }
+    std::int32_t rows() const { return i32(32); }
+    std::int32_t cols() const { return i32(36); }
+    std::int32_t keypoint_count() const { return i32(40); }
+    std::uint32_t flags() const { return static_cast<std::uint32_t>(i32(44)); }
+    StageTimestamps stamps() const;
+
+    std::string_view image_name() const { return strings_[0]; }
+    std::string_view encoding() const { return strings_[1]; }
+    std::string_view extractor_id() const { return strings_[2]; }
+    std::string_view keypoint_format() const { return strings_[3]; }
+    std::string_view detector() const { return strings_[4]; }
+
+    // The raw header bytes, e.g. to store them as received.
+    std::span<const unsigned char> bytes() const { return data_; }
+
+    FrameMetadata to_metadata() const;
+
+private:
+    explicit View(std::span<const unsigned char> data) : data_(data) {}
+
+    std::uint64_t u64(std::size_t offset) const;
+    std::int64_t i64(std::size_t offset) const { return static_cast<std::int64_t>(u64(offset)); }
+    std::int32_t i32(std::size_t offset) const;
+
+    std::span<const unsigned char> data_;
+    std::size_t fixed_bytes_ = 0;
+    std::array<std::string_view, 5> strings_{};
+};
+
+// Decodes the first part of a frame in either format.
+std::optional<FrameMetadata> decode(std::span<const unsigned char> data);
+
+}  // namespace frame_header
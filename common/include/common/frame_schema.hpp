@@ -0,0 +1,34 @@
+#pragma once
+
+#include <sqlite3.h>
+
+// SQLite layout of the frame archive written by data_logger. Shared so that
+// tools and benchmarks run against the real schema.
+namespace frame_schema {
+
+// Creates the frames, images and batches tables and adds columns that
+// databases from older builds are missing.
+bool create(sqlite3* db);
+
+// Parameters, in order: seq_number, image_name, rows, cols, keypoint_count,
+// meta_json, image_bytes, encoding, extractor_id, image_hash, segment_id,
+// blob_offset, blob_length, blob_checksum, keypoint_format, keypoint_block,
+// t_gen_read, t_gen_encode, t_gen_send, t_ext_recv, t_ext_decode,
+// t_ext_sift, t_ext_send, t_log_recv, batch_id, meta_header, detector,
+// flags. Unbound parameters are NULL.
+extern const char* const kInsertFrame;
+
+// (hash)
+extern const char* const kFindImage;
+
+// (hash, encoding, byte_size, image_bytes, segment_id, blob_offset,
+// blob_length, blob_checksum)
+extern const char* const kInsertImage;
+
+// (id, committed_ns, frame_count)
+extern const char* const kInsertBatch;
+
+// Highest batch id used by frames or batches; 0 for an empty archive.
+extern const char* const kMaxBatchId;
+
+}  // namespace frame_schema
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "common/synthetic.hpp"
+
+// The image_generator's source stage, shared by the generator process and
+// the in-process voyis_pipeline.
+namespace frame_source {
+
+// One input frame: an image file, or a synthetic frame.
+struct Entry {
+    std::filesystem::path path;
+    // Set for frames rendered by synthetic::render(); `path` is then only a name.
+    std::optional<std::uint64_t> synthetic_index;
+};
+
+// Whether `path` has one of the extensions the generator reads
+// (.png/.jpg/.jpeg/.bmp, any case).
+bool is_image(const std::filesystem::path& path);
+
+// The .png/.jpg/.jpeg/.bmp files directly in `folder`, in directory order.
+// Prints an error and returns std::nullopt when `folder` is not a directory.
+std::optional<std::vector<std::filesystem::path>> list_images(const std::filesystem::path& folder);
+
+// Entries for synthetic frames 0..count-1.
+std::vector<Entry> synthetic_entries(const synthetic::Spec& spec, std::uint64_t count);
+
+// Reads or renders `entry` as an 8-bit BGR image; empty on failure.
+cv::Mat load(const Entry& entry, const synthetic::Spec& spec);
+
+}  // namespace frame_source
@@ -0,0 +1,221 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <sqlite3.h>
+
+#include "common/blob_log.hpp"
+#include "common/bounded_queue.hpp"
+#include "common/buffer_pool.hpp"
+#include "common/frame.hpp"
+#include "common/hash_utils.hpp"
+#include "common/latency.hpp"
+#include "common/log.hpp"
+#include "common/lru_cache.hpp"
+#include "common/metrics.hpp"
+#include "common/shm_ring.hpp"
+#include "common/sqlite_utils.hpp"
+#include "common/zmq_utils.hpp"
+
+// The data_logger's storage stage: batched inserts into voyis_frames.db,
+// shared by the data_logger process and the in-process voyis_pipeline.
+namespace frame_writer {
+
+// A frame on its way to the writer. Received frames keep their zmq messages
+// as received, and SQLite reads the values from there; frames built in
+// process (voyis_pipeline) carry their bytes in the local_* fields. Those
+// and `transcoded` come from RecordPools and go back when the record is
+// destroyed after the write.
+struct Record {
+    FrameMetadata meta;
+    zmq_utils::Message meta_msg;
+    zmq_utils::Message image;
+    // Slot holding the payload when `image` is a shm_ring descriptor. The
+    // slot is freed once the record has been written and destroyed.
+    std::optional<shm_ring::Lease> lease;
+    // Set when the payload was encoded at this stage (--store-codec, or the
+    // in-process pipeline); replaces `image`.
+    BufferPool::Buffer transcoded;
+    // Content hash of the stored payload; only computed for deduplication
+    // and the blob log.
+    hash_utils::Hash128 image_hash;
+    // Binary keypoint block (third message part), stored as received.
+    std::optional<zmq_utils::Message> keypoints;
+    // In-process replacements for `meta_msg` and `keypoints`.
+    BufferPool::Buffer local_meta;
+    BufferPool::Buffer local_keypoints;
+
+    std::span<const unsigned char> payload() const {
+        if (!transcoded.empty()) {
+            return transcoded.bytes();
+        }
+        return lease ? lease->bytes() : image.bytes();
+    }
+
+    // The metadata as stored: a frame_header or JSON text.
+    std::span<const unsigned char> meta_bytes() const {
+        return local_meta.empty() ? meta_msg.bytes() : local_meta.bytes();
+    }
+
+    // Empty when the frame has no keypoint block.
+    std::span<const unsigned char> keypoint_bytes() const {
+        if (!local_keypoints.empty()) {
+            return local_keypoints.bytes();
+        }
+        return keypoints ? keypoints->bytes() : std::span<const unsigned char>{};
+    }
+};
+
+// One pool per kind of Record buffer, so each settles at its own size.
+// `max_idle` should cover the records in flight (queue depth plus one per
+// producing thread).
+struct RecordPools {
+    std::shared_ptr<BufferPool> payloads;
+    std::shared_ptr<BufferPool> headers;
+    std::shared_ptr<BufferPool> keypoints;
+
+    static RecordPools create(std::size_t max_idle) {
+        return {BufferPool::create(max_idle), BufferPool::create(max_idle), BufferPool::create(max_idle)};
+    }
+};
+
+struct Options {
+    std::size_t batch_frames = 64;
+    std::chrono::milliseconds batch_time{50};
+    std::chrono::seconds stats_interval{10};
+    // Store each distinct payload once in `images` and reference it by hash
+    // from `frames`, instead of writing the blob into every frame row.
+    bool dedup_images = true;
+    std::size_t dedup_cache_entries = 1 << 16;
+    std::chrono::seconds latency_interval{10};
+    // First id handed to a batch; frames.batch_id references batches.id.
+    std::int64_t first_batch_id = 1;
+    // Where the writer registers its live metrics (frames_out, bytes_out,
+    // drops.rolled_back, drops.insert_failed and the sqlite_commit timer);
+    // none when null. Must outlive the Writer.
+    metrics::Registry* metrics = nullptr;
+};
+
+// Prepared statements owned by the writer thread.
+struct Statements {
+    sqlite_utils::StatementPtr insert_frame;
+    sqlite_utils::StatementPtr find_image;
+    sqlite_utils::StatementPtr insert_image;
+    sqlite_utils::StatementPtr insert_batch;
+};
+
+struct Database {
+    sqlite_utils::DbPtr db;
+    Statements statements;
+};
+
+// Opens `path` in WAL mode, creates the schema and prepares the writer's
+// statements. Sets options.first_batch_id past the last stored batch.
+std::optional<Database> open_database(const std::string& path, Options& options);
+
+// Owns the SQLite connection on a dedicated thread and groups inserts into
+// transactions: a batch commits after `batch_frames` frames or `batch_time`
+// since its first frame, whichever comes first. In WAL mode with
+// synchronous=NORMAL a commit is an append to the log instead of an fsync
+// per frame.
+//
+// With a blob log the payload bytes go to its segment files and the rows only
+// carry (segment_id, blob_offset, blob_length, blob_checksum). The log is
+// synced before each COMMIT, so a committed row never points at bytes that
+// are not on disk.
+class Writer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    Writer(sqlite3* db, Statements statements, Options options,
+           std::optional<blob_log::Writer> blobs);
+
+    // Writes records from `queue` until it is closed and drained.
+    void run(BoundedQueue<Record>& queue);
+
+    // The steps of run(), for callers that drain their own queue: add()
+    // every record, wait at most until next_deadline() for the next one,
+    // then tick(). finish() commits what is left.
+    void add(const Record& record);
+    Clock::time_point next_deadline() const;
+    void tick();
+    void finish();
+
+private:
+    bool begin();
+    std::size_t write_batches();
+    std::optional<blob_log::BlobRef> append_blob(const Record& record, bool& ok);
+    bool store_image(const Record& record, const unsigned char hash[16]);
+    bool insert(const Record& record);
+    bool insert_row(const Record& record);
+    void commit();
+    void record_commit(std::uint64_t commit_ns);
+    void report_stats();
+
+    // A committed batch whose `batches` row is not written yet.
+    struct PendingBatch {
+        std::int64_t id;
+        std::uint64_t committed_ns;
+        std::uint64_t frames;
+    };
+
+    struct Metrics {
+        metrics::Counter& frames_out;
+        metrics::Counter& bytes_out;
+        metrics::Counter& rolled_back;
+        metrics::Counter& insert_failed;
+        metrics::Timer& commit;
+    };
+
+    // Counters since the last report.
+    struct Stats {
+        std::uint64_t batches = 0;
+        std::uint64_t frames = 0;
+        std::uint64_t max_batch = 0;
+        // Rolled back, or dropped because the batch could not begin.
+        std::uint64_t failed_frames = 0;
+        double commit_ms_total = 0.0;
+        double commit_ms_max = 0.0;
+        std::uint64_t images_written = 0;
+        std::uint64_t image_bytes_written = 0;
+        std::uint64_t image_cache_hits = 0;
+        std::uint64_t image_db_hits = 0;
+        std::uint64_t blob_bytes_written = 0;
+    };
+
+    sqlite3* db_;
+    Statements statements_;
+    sqlite3_stmt* insert_stmt_;
+    Options options_;
+    LruCache<hash_utils::Hash128, bool, hash_utils::Hash128Hasher> known_images_;
+    std::optional<blob_log::Writer> blobs_;
+    std::int64_t next_batch_id_;
+    std::vector<PendingBatch> pending_batches_;
+    // Of pending_batches_, the rows inserted in the open transaction.
+    std::size_t batches_written_ = 0;
+    // Stamps of the frames in the open batch, for the commit histograms.
+    std::vector<StageTimestamps> batch_stamps_;
+    latency::Recorder latencies_;
+    latency::Histogram& wire_in_latency_;
+    latency::Histogram& commit_latency_;
+    latency::Histogram& frame_age_latency_;
+    bool batch_open_ = false;
+    std::uint64_t batch_frames_ = 0;
+    std::uint64_t batch_bytes_ = 0;
+    Clock::time_point batch_started_;
+    Clock::time_point next_report_;
+    Stats stats_;
+    std::map<std::string, std::uint64_t> frames_per_extractor_;
+    std::uint64_t stored_frames_ = 0;
+    logging::InfoStream report_out_;
+    std::optional<Metrics> metrics_;
+};
+
+}  // namespace frame_writer
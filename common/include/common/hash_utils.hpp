@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+
+namespace hash_utils {
+
+// 128-bit content hash used to address image payloads.
+struct Hash128 {
+    std::uint64_t lo{};
+    std::uint64_t hi{};
+
+    bool operator==(const Hash128&) const = default;
+
+    // 16 bytes, little-endian lo then hi; the form stored in SQLite.
+    void to_bytes(unsigned char out[16]) const;
+    std::string hex() const;
+};
+
+struct Hash128Hasher {
+    std::size_t operator()(const Hash128& h) const noexcept {
+        return static_cast<std::size_t>(h.lo ^ (h.hi * 0x9E3779B97F4A7C15ull));
+    }
+};
+
+// MurmurHash3 x64/128. Not cryptographic, but fast (several GB/s) and
+// well distributed, which is what payload deduplication needs.
+Hash128 hash128(std::span<const unsigned char> data, std::uint64_t seed = 0);
+
+}  // namespace hash_utils
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+namespace keypoint_block {
+
+// Packed binary form of a frame's keypoints and, optionally, descriptors.
+// It travels as its own message part after the image and is stored as-is
+// by the logger. Layout, all fields little-endian:
+//
+//   header (16 bytes)
+//     char[4]  magic "VKPB"
+//     uint8    version (kVersion)
+//     uint8    descriptor format (DescriptorFormat)
+//     uint16   reserved, 0
+//     uint32   keypoint count N
+//     uint32   descriptor length D (0 without descriptors)
+//   N keypoint records (24 bytes each)
+//     float32  x, y, size, angle, response
+//     int32    octave
+//   descriptors, row-major N x D, 4 bytes (Float32) or 1 byte (Uint8) each
+constexpr std::uint8_t kVersion = 1;
+
+// Value of FrameMetadata::keypoint_format for frames carrying a block.
+constexpr std::string_view kFormatName = "vkpb1";
+
+enum class DescriptorFormat : std::uint8_t {
+    None = 0,
+    Float32 = 1,
+    // SIFT descriptor values already lie in [0, 255]; rounding them to bytes
+    // costs little matching accuracy and a quarter of the space.
+    Uint8 = 2
+};
+
+// Parses "none", "f32" or "u8".
+std::optional<DescriptorFormat> parse_descriptor_format(std::string_view spec);
+
+std::string_view descriptor_format_name(DescriptorFormat format);
+
+// Appends the block to `out` (which is cleared first). `descriptors` must
+// have one row per keypoint and be CV_32F or CV_8U; it is ignored with
+// DescriptorFormat::None. Returns false on a shape mismatch.
+bool encode(
+    const std::vector<cv::KeyPoint>& keypoints,
+    const cv::Mat& descriptors,
+    DescriptorFormat format,
+    std::vector<unsigned char>& out
+);
+
+struct Decoded {
+    std::vector<cv::KeyPoint> keypoints;
+    // CV_32F for Float32, CV_8U for Uint8, empty without descriptors.
+    cv::Mat descriptors;
+    DescriptorFormat format = DescriptorFormat::None;
+};
+
+// Returns std::nullopt for a truncated block, bad magic or an unknown
+// version.
+std::optional<Decoded> decode(std::span<const unsigned char> data);
+
+}  // namespace keypoint_block
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace latency {
+
+// CLOCK_MONOTONIC in nanoseconds. Stamps taken by different processes are
+// comparable only when they run on the same host.
+std::uint64_t now_ns();
+
+// Log-linear histogram of durations in nanoseconds: 16 sub-buckets per
+// power of two, so a reported percentile is within ~6% of the true value.
+// record() is lock-free and may be called from any thread.
+class Histogram {
+public:
+    void record(std::uint64_t ns);
+
+    // Records `to - from` when both stamps are set and ordered; stamps from
+    // another host or a skipped stage are ignored.
+    void record_between(std::uint64_t from, std::uint64_t to);
+
+    std::uint64_t count() const;
+    std::uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+    // Upper bound of the bucket holding quantile `q` (0..1); 0 when empty.
+    std::uint64_t percentile(double q) const;
+
+    void reset();
+
+private:
+    static constexpr std::size_t kSubBuckets = 16;
+    static constexpr std::size_t kBuckets = 64 * kSubBuckets;
+
+    std::array<std::atomic<std::uint64_t>, kBuckets> buckets_{};
+    std::atomic<std::uint64_t> max_{0};
+};
+
+// Named histograms of one process, printed and reset every `interval` as
+//   Latency <name>: n=... p50=...ms p99=...ms p999=...ms max=...ms
+class Recorder {
+public:
+    explicit Recorder(std::chrono::seconds interval);
+
+    // Histograms live as long as the Recorder; register them at startup.
+    Histogram& add(std::string name);
+
+    // Prints and resets the histograms once the interval has passed. Call it
+    // from one thread only.
+    void maybe_report(std::ostream& out);
+    void report(std::ostream& out);
+
+private:
+    struct Entry {
+        std::string name;
+        std::unique_ptr<Histogram> histogram;
+    };
+
+    std::chrono::steady_clock::duration interval_;
+    std::chrono::steady_clock::time_point next_report_;
+    std::vector<Entry> entries_;
+};
+
+}  // namespace latency
@@ -0,0 +1,231 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <concepts>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#include "common/cli_utils.hpp"
+
+// Process-wide logging for the apps' hot loops. A call formats its line
+// into a fixed-size buffer and pushes it onto a lock-free ring; a
+// background thread writes the lines out (debug and info to stdout, warn
+// and error to stderr with a "[WARN] "/"[ERROR] " prefix). Nothing blocks:
+// a line that finds the ring full is dropped and counted.
+//
+//   logging::info("Received seq=", meta.seq_number, " bytes=", size);
+//   logging::debug("Meta: ", [&] { return meta.to_json().dump(); });
+//
+// The level check comes first, so a disabled line costs one atomic load
+// plus evaluating its arguments; pass anything expensive as a lambda, which
+// is only called once the line is going out. Each call site (its leading
+// string literal) may emit `rate` lines per second; the rest are counted
+// and the next line that goes out reports how many were suppressed.
+//
+// Before start() and after stop() lines are written synchronously, so the
+// library and the tools can log without a background thread.
+namespace logging {
+
+enum class Level : int { Debug, Info, Warn, Error, Off };
+
+std::optional<Level> parse_level(std::string_view name);
+std::string_view level_name(Level level);
+
+struct Options {
+    Level level = Level::Info;
+    // Lines per call site per second; 0 disables rate limiting.
+    std::uint32_t rate = 20;
+};
+
+// Reads --log-level=debug|info|warn|error|off and --log-rate=<lines per
+// second per call site>. Prints the problem and returns nullopt on a bad
+// value.
+std::optional<Options> options_from_args(const cli_utils::Args& args);
+
+// Starts the writer thread. Call once, early in main(); stop() then runs
+// at exit.
+void start(const Options& options);
+
+// Writes out everything queued and stops the writer thread.
+void stop();
+
+namespace detail {
+inline std::atomic<int> g_level{static_cast<int>(Level::Info)};
+
+// Longest line kept; longer ones are cut and end in "...".
+constexpr std::size_t kMaxLine = 480;
+
+struct Line {
+    Level level = Level::Info;
+    std::uint16_t size = 0;
+    bool truncated = false;
+    std::array<char, kMaxLine> text;
+
+    void append(const char* data, std::size_t n) {
+        const std::size_t room = kMaxLine - size;
+        if (n > room) {
+            n = room;
+            truncated = true;
+        }
+        std::memcpy(text.data() + size, data, n);
+        size = static_cast<std::uint16_t>(size + n);
+    }
+};
+
+// Admits a line from `site` under the rate limit. `suppressed` receives the
+// lines from the site dropped since the last one admitted.
+bool admit(const void* site, std::uint32_t& suppressed);
+
+void submit(const Line& line);
+
+// Fallback for types only printable with operator<<: streams straight into
+// the line, without a temporary string.
+class LineBuf : public std::streambuf {
+public:
+    explicit LineBuf(Line& line) : line_(line) {}
+
+protected:
+    int_type overflow(int_type ch) override {
+        if (ch != traits_type::eof()) {
+            const char c = traits_type::to_char_type(ch);
+            line_.append(&c, 1);
+        }
+        return ch;
+    }
+    std::streamsize xsputn(const char* s, std::streamsize n) override {
+        line_.append(s, static_cast<std::size_t>(n));
+        return n;
+    }
+
+private:
+    Line& line_;
+};
+
+template <typename T>
+void append(Line& line, const T& value) {
+    using V = std::decay_t<T>;
+    if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+        const std::string_view text(value);
+        line.append(text.data(), text.size());
+    } else if constexpr (std::is_same_v<V, char>) {
+        line.append(&value, 1);
+    } else if constexpr (std::is_same_v<V, bool>) {
+        line.append(value ? "1" : "0", 1);
+    } else if constexpr (std::is_arithmetic_v<V>) {
+        char buf[32];
+        std::to_chars_result r;
+        if constexpr (std::is_floating_point_v<V>) {
+            // Six significant digits, as std::ostream prints by default.
+            r = std::to_chars(buf, buf + sizeof(buf), value, std::chars_format::general, 6);
+        } else {
+            r = std::to_chars(buf, buf + sizeof(buf), value);
+        }
+        line.append(buf, static_cast<std::size_t>(r.ptr - buf));
+    } else if constexpr (std::is_enum_v<V>) {
+        append(line, static_cast<std::underlying_type_t<V>>(value));
+    } else if constexpr (std::invocable<const T&>) {
+        append(line, value());
+    } else {
+        LineBuf buf(line);
+        std::ostream out(&buf);
+        out << value;
+    }
+}
+}  // namespace detail
+
+inline bool enabled(Level level) {
+    return static_cast<int>(level) >= detail::g_level.load(std::memory_order_relaxed);
+}
+
+// The leading literal of a log line. Its address identifies the call site
+// for rate limiting.
+struct Site {
+    Site(const char* text) : text(text) {}  // NOLINT: implicit on purpose
+    const char* text;
+};
+
+template <typename... Args>
+void write(Level level, Site site, const Args&... args) {
+    if (!enabled(level)) {
+        return;
+    }
+    std::uint32_t suppressed = 0;
+    if (!detail::admit(site.text, suppressed)) {
+        return;
+    }
+    detail::Line line;
+    line.level = level;
+    detail::append(line, site.text);
+    (detail::append(line, args), ...);
+    if (suppressed != 0) {
+        detail::append(line, " (");
+        detail::append(line, suppressed);
+        detail::append(line, " similar suppressed)");
+    }
+    detail::submit(line);
+}
+
+template <typename... Args>
+void debug(Site site, const Args&... args) { write(Level::Debug, site, args...); }
+template <typename... Args>
+void info(Site site, const Args&... args) { write(Level::Info, site, args...); }
+template <typename... Args>
+void warn(Site site, const Args&... args) { write(Level::Warn, site, args...); }
+template <typename... Args>
+void error(Site site, const Args&... args) { write(Level::Error, site, args...); }
+
+namespace detail {
+// Cuts what is streamed into it into lines and submits each at Info.
+class InfoBuf : public std::streambuf {
+protected:
+    int_type overflow(int_type ch) override {
+        if (ch != traits_type::eof()) {
+            put(traits_type::to_char_type(ch));
+        }
+        return ch;
+    }
+    std::streamsize xsputn(const char* s, std::streamsize n) override {
+        for (std::streamsize i = 0; i < n; ++i) {
+            put(s[i]);
+        }
+        return n;
+    }
+
+private:
+    void put(char c) {
+        if (c != '\n') {
+            line_.append(&c, 1);
+            return;
+        }
+        if (line_.size != 0 && enabled(Level::Info)) {
+            submit(line_);
+        }
+        line_.size = 0;
+        line_.truncated = false;
+    }
+
+    Line line_;
+};
+}  // namespace detail
+
+// The periodic reports (latency, flow control, allocations, ...) are built
+// with operator<<; streamed here instead of to std::cout, each of their
+// lines goes out as one info line through the writer thread, so it never
+// interleaves with other lines. Not rate limited: reports come once per
+// interval. Not thread-safe; each reporting thread keeps its own, and it
+// allocates nothing per line.
+class InfoStream : private detail::InfoBuf, public std::ostream {
+public:
+    InfoStream() : std::ostream(static_cast<detail::InfoBuf*>(this)) {}
+};
+
+}  // namespace logging
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+// Least-recently-used map with a budget expressed in caller-defined cost
+// units (entries, bytes, ...). Inserting past the budget evicts the least
+// recently used entries. Not thread-safe.
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class LruCache {
+public:
+    explicit LruCache(std::size_t budget) : budget_(budget) {}
+
+    // Returns the cached value and marks it most recently used, or nullptr.
+    Value* get(const Key& key) {
+        auto it = index_.find(key);
+        if (it == index_.end()) {
+            return nullptr;
+        }
+        entries_.splice(entries_.begin(), entries_, it->second);
+        return &it->second->value;
+    }
+
+    // Inserts or replaces `key`. Entries costing more than the whole budget
+    // are not cached.
+    void put(const Key& key, Value value, std::size_t cost = 1) {
+        erase(key);
+        if (cost > budget_) {
+            return;
+        }
+        entries_.push_front(Entry{key, std::move(value), cost});
+        index_.emplace(key, entries_.begin());
+        used_ += cost;
+        while (used_ > budget_) {
+            evict_last();
+        }
+    }
+
+    bool erase(const Key& key) {
+        auto it = index_.find(key);
+        if (it == index_.end()) {
+            return false;
+        }
+        used_ -= it->second->cost;
+        entries_.erase(it->second);
+        index_.erase(it);
+        return true;
+    }
+
+    void clear() {
+        entries_.clear();
+        index_.clear();
+        used_ = 0;
+    }
+
+    std::size_t size() const { return index_.size(); }
+    std::size_t used() const { return used_; }
+    std::size_t budget() const { return budget_; }
+    std::size_t evictions() const { return evictions_; }
+
+private:
+    struct Entry {
+        Key key;
+        Value value;
+        std::size_t cost;
+    };
+
+    void evict_last() {
+        const Entry& last = entries_.back();
+        used_ -= last.cost;
+        index_.erase(last.key);
+        entries_.pop_back();
+        ++evictions_;
+    }
+
+    const std::size_t budget_;
+    std::size_t used_ = 0;
+    std::size_t evictions_ = 0;
+    std::list<Entry> entries_;
+    std::unordered_map<Key, typename std::list<Entry>::iterator, Hash> index_;
+};
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "common/cli_utils.hpp"
+#include "common/flow_control.hpp"
+
+// Live counters of one process, for watching a running system from the
+// outside with voyis_top instead of reading console text. Counters, gauges
+// and timers are atomics that any thread updates without a lock; a
+// Publisher thread takes a snapshot of all of them every interval and
+// publishes it as one JSON object:
+//   - on a ZeroMQ PUB socket connected to --metrics-endpoint, which
+//     voyis_top binds (with nobody listening the snapshot is dropped), and
+//   - in a snapshot file <--metrics-dir>/<stage>-<pid>.json, replaced
+//     atomically so a reader never sees half a file, and removed when the
+//     Publisher is destroyed.
+//
+// Counters are cumulative since start; readers turn them into rates. The
+// names voyis_top knows are frames_in, frames_out, bytes_in, bytes_out,
+// decode_failures, drops.<reason> (summed into one drop rate) and the
+// queue.in.<name> / queue.out.<name> gauges, a depth out of a capacity: a
+// stage whose input queue fills up is slower than the stage feeding it.
+namespace metrics {
+
+inline constexpr char kDefaultEndpoint[] = "ipc:///tmp/voyis-metrics.ipc";
+inline constexpr char kDefaultDir[] = "/tmp/voyis-metrics";
+
+struct Options {
+    bool enabled = true;
+    std::chrono::seconds interval{1};
+    // Empty disables the socket or the snapshot file.
+    std::string endpoint = kDefaultEndpoint;
+    std::string dir = kDefaultDir;
+};
+
+// Reads --metrics=on|off, --metrics-interval=<seconds>,
+// --metrics-endpoint=<zmq endpoint> and --metrics-dir=<dir>. Prints the
+// problem and returns nullopt on a bad value.
+std::optional<Options> options_from_args(const cli_utils::Args& args);
+
+class Counter {
+public:
+    void add(std::uint64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+    std::uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<std::uint64_t> value_{0};
+};
+
+class Gauge {
+public:
+    void set(std::int64_t value) { value_.store(value, std::memory_order_relaxed); }
+    void add(std::int64_t delta) { value_.fetch_add(delta, std::memory_order_relaxed); }
+    std::int64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<std::int64_t> value_{0};
+};
+
+// Durations in nanoseconds: count and total since start, maximum since the
+// last snapshot.
+class Timer {
+public:
+    void record(std::uint64_t ns);
+
+    // Records `to - from` when both stamps are set and ordered, like
+    // latency::Histogram::record_between.
+    void record_between(std::uint64_t from, std::uint64_t to) {
+        if (from != 0 && to >= from) {
+            record(to - from);
+        }
+    }
+
+    std::uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+    std::uint64_t total_ns() const { return total_ns_.load(std::memory_order_relaxed); }
+    // Returns the maximum and starts a new one; for the snapshot only.
+    std::uint64_t take_max_ns() { return max_ns_.exchange(0, std::memory_order_relaxed); }
+
+private:
+    std::atomic<std::uint64_t> count_{0};
+    std::atomic<std::uint64_t> total_ns_{0};
+    std::atomic<std::uint64_t> max_ns_{0};
+};
+
+// The metrics of one process. Registering takes a lock and may happen at
+// any time; the returned objects live as long as the Registry, and asking
+// for a name again returns the same object.
+class Registry {
+public:
+    // `instance` tells apart processes of the same stage, such as a pool of
+    // extractors; it defaults to the pid.
+    explicit Registry(std::string stage, std::string instance = {});
+
+    Counter& counter(const std::string& name);
+    // `capacity` is what a queue gauge is measured against; 0 for none.
+    Gauge& gauge(const std::string& name, std::int64_t capacity = 0);
+    Timer& timer(const std::string& name);
+
+    // Values kept elsewhere, read at each snapshot on the publisher thread;
+    // `read` must be safe to call from there.
+    void counter(const std::string& name, std::function<std::uint64_t()> read);
+    void gauge(const std::string& name, std::function<std::int64_t()> read, std::int64_t capacity = 0);
+
+    // A link's flow_control counters: drops.<link>.no_credit,
+    // drops.<link>.would_block, drops.<link>.oldest and
+    // drops.<link>.send_error, plus link.<link>.sent and link.<link>.blocked_ms.
+    void link(const std::string& name, const flow_control::LinkCounters& counters);
+
+    const std::string& stage() const { return stage_; }
+    const std::string& instance() const { return instance_; }
+
+    // {"stage", "instance", "pid", "time_ms", "mono_ns", "counters",
+    //  "gauges": {name: {"value", "capacity"}},
+    //  "timers": {name: {"count", "total_ms", "max_ms"}}}
+    nlohmann::json snapshot();
+
+private:
+    template <typename T>
+    struct Entry {
+        std::string name;
+        std::unique_ptr<T> value;
+        std::int64_t capacity = 0;
+    };
+    struct Sampled {
+        std::string name;
+        std::function<std::int64_t()> read;
+        std::int64_t capacity = 0;
+        bool gauge = false;
+    };
+
+    const std::string stage_;
+    const std::string instance_;
+    std::mutex mutex_;
+    std::vector<Entry<Counter>> counters_;
+    std::vector<Entry<Gauge>> gauges_;
+    std::vector<Entry<Timer>> timers_;
+    std::vector<Sampled> sampled_;
+};
+
+// Publishes snapshots of a Registry every interval on its own thread, and
+// a last one when destroyed. Does nothing when metrics are off. The
+// Registry must outlive the Publisher.
+class Publisher {
+public:
+    Publisher(Registry& registry, Options options);
+    ~Publisher();
+
+    Publisher(const Publisher&) = delete;
+    Publisher& operator=(const Publisher&) = delete;
+
+private:
+    void run();
+    void publish();
+
+    Registry& registry_;
+    const Options options_;
+    void* context_ = nullptr;
+    void* socket_ = nullptr;
+    std::string file_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    bool stop_ = false;
+    std::thread thread_;
+};
+
+}  // namespace metrics
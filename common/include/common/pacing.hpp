@@ -0,0 +1,57 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace pacing {
+
+// Decides when a source emits its next frame. Deadlines are kept on an
+// absolute schedule, so time spent producing a frame does not add up to
+// drift. A source that falls more than one interval behind restarts the
+// schedule instead of bursting to catch up, and counts the frame as late.
+class Pacer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Parses a pacing spec:
+    //   "fps:<rate>"               evenly spaced frames, e.g. "fps:29.97"
+    //   "max"                      no pacing at all
+    //   "burst:<frames>:<ms>"      <frames> back to back, one burst every <ms>
+    //   "trace:<file>"             replays the gaps between the timestamps
+    //                              (seconds, one per line) in <file>, looping
+    static std::optional<Pacer> parse(std::string_view spec);
+
+    // Blocks until the next frame is due.
+    void wait();
+
+    // Inverse of parse(), e.g. "fps:30".
+    std::string describe() const { return spec_; }
+
+    std::uint64_t late() const { return late_; }
+
+private:
+    enum class Mode { Fixed, Max, Burst, Trace };
+
+    Pacer(Mode mode, std::string spec) : mode_(mode), spec_(std::move(spec)) {}
+
+    // Time from the previous deadline to the next one.
+    Clock::duration next_gap();
+
+    Mode mode_;
+    std::string spec_;
+    Clock::duration interval_{};  // Fixed: frame interval; Burst: burst period
+    std::uint32_t burst_frames_ = 1;
+    std::uint32_t in_burst_ = 0;
+    std::vector<Clock::duration> trace_gaps_;
+    std::size_t trace_pos_ = 0;
+    bool started_ = false;
+    Clock::time_point due_;
+    std::uint64_t late_ = 0;
+};
+
+}  // namespace pacing
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+// Same-host payload transport. The producer owns a POSIX shared-memory
+// ring of fixed-size slots; a frame's payload is written into a slot once
+// and only a small Descriptor travels over ZeroMQ in place of the image
+// part (FrameMetadata::flags has kFlagShmPayload). Whoever holds the slot
+// last (the logger, or an extractor that re-encodes) frees it.
+//
+// Every slot carries a generation that changes each time it is reused, so
+// a descriptor for a slot the producer has since reclaimed is detected and
+// the frame dropped instead of read torn.
+namespace shm_ring {
+
+// Identifies one published payload.
+struct Descriptor {
+    std::string name;           // shm_open() name of the ring
+    std::uint64_t ring_id{};    // distinguishes rings reusing a name
+    std::uint32_t slot{};
+    std::uint64_t generation{};
+    std::uint64_t length{};
+};
+
+// Wire form: "VSHD", u16 version, u16 name length, u32 slot, u64 ring_id,
+// u64 generation, u64 length (little-endian), then the name.
+void encode(const Descriptor& desc, std::vector<unsigned char>& out);
+std::optional<Descriptor> decode(std::span<const unsigned char> data);
+
+class Mapping;
+
+// Writes payloads into the ring. Single-threaded.
+class Producer {
+public:
+    // Creates (replacing any stale ring of the same name) and maps a ring of
+    // `slots` slots of `slot_bytes` each. The memory is reserved up front,
+    // so a too-small /dev/shm fails here rather than with SIGBUS later.
+    // Slots held longer than `reclaim_after` (a consumer died) are reused.
+    static std::optional<Producer> create(
+        const std::string& name,
+        std::uint32_t slots,
+        std::uint64_t slot_bytes,
+        std::chrono::milliseconds reclaim_after
+    );
+
+    ~Producer();
+    Producer(Producer&&) noexcept;
+    Producer& operator=(Producer&&) noexcept;
+    Producer(const Producer&) = delete;
+    Producer& operator=(const Producer&) = delete;
+
+    // Copies `payload` into a free slot. Returns std::nullopt when it is
+    // larger than a slot or every slot is held; send it inline then.
+    std::optional<Descriptor> publish(std::span<const unsigned char> payload);
+
+    // Frees a slot whose descriptor was never sent.
+    void cancel(const Descriptor& desc);
+
+    std::uint64_t slot_bytes() const;
+    // Publishes that found no free slot, and slots taken back from consumers.
+    std::uint64_t full() const { return full_; }
+    std::uint64_t reclaimed() const { return reclaimed_; }
+
+private:
+    Producer(std::shared_ptr<Mapping> mapping, std::chrono::milliseconds reclaim_after);
+
+    std::shared_ptr<Mapping> mapping_;
+    std::chrono::milliseconds reclaim_after_;
+    std::uint32_t cursor_ = 0;
+    std::uint64_t full_ = 0;
+    std::uint64_t reclaimed_ = 0;
+};
+
+// Ownership of one published slot. Frees it when destroyed unless it was
+// forwarded. May be moved to and destroyed on any thread.
+class Lease {
+public:
+    ~Lease();
+    Lease(Lease&& other) noexcept;
+    Lease& operator=(Lease&& other) noexcept;
+    Lease(const Lease&) = delete;
+    Lease& operator=(const Lease&) = delete;
+
+    std::span<const unsigned char> bytes() const { return bytes_; }
+
+    // False once the producer has reclaimed the slot; the bytes may then
+    // have been overwritten.
+    bool valid() const;
+
+    // The descriptor was sent on to the next stage, which now owns the slot.
+    void forward() { mapping_.reset(); }
+
+private:
+    friend class Consumer;
+    Lease(std::shared_ptr<Mapping> mapping, std::uint32_t slot, std::uint64_t generation,
+          std::span<const unsigned char> bytes);
+
+    void release();
+
+    std::shared_ptr<Mapping> mapping_;
+    std::uint32_t slot_ = 0;
+    std::uint64_t generation_ = 0;
+    std::span<const unsigned char> bytes_;
+};
+
+// Maps rings named by descriptors and takes their slots. Keeps the last
+// ring mapped and remaps when a restarted producer replaced it.
+class Consumer {
+public:
+    std::optional<Lease> open(const Descriptor& desc);
+
+private:
+    std::shared_ptr<Mapping> mapping_;
+};
+
+}  // namespace shm_ring
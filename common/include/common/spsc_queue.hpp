@@ -0,0 +1,147 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <optional>
+#include <thread>
+#include <vector>
+
+// Lock-free single-producer/single-consumer ring with a fixed capacity
+// (rounded up to a power of two). Items are moved in and out, so a frame's
+// cv::Mat and keypoint vectors change hands without a copy. Exactly one
+// thread may push and one other thread may pop.
+//
+// The blocking calls spin briefly, then yield, then sleep in short steps:
+// a busy stage sees the next item within nanoseconds, an idle one does not
+// burn a core.
+template <typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(std::size_t capacity) : slots_(round_up(capacity)), mask_(slots_.size() - 1) {}
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // Producer side. Moves from `item` only on success.
+    bool try_push(T& item) {
+        const std::size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_cache_ == slots_.size()) {
+            head_cache_ = head_.load(std::memory_order_acquire);
+            if (tail - head_cache_ == slots_.size()) {
+                return false;
+            }
+        }
+        slots_[tail & mask_].emplace(std::move(item));
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Blocks while the queue is full. Returns false (dropping `item`) once
+    // the queue has been closed.
+    bool push(T item) {
+        Backoff backoff;
+        while (!closed()) {
+            if (try_push(item)) {
+                return true;
+            }
+            backoff.pause();
+        }
+        return false;
+    }
+
+    // Consumer side.
+    std::optional<T> try_pop() {
+        const std::size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_cache_) {
+            tail_cache_ = tail_.load(std::memory_order_acquire);
+            if (head == tail_cache_) {
+                return std::nullopt;
+            }
+        }
+        std::optional<T>& slot = slots_[head & mask_];
+        std::optional<T> item = std::move(slot);
+        slot.reset();
+        head_.store(head + 1, std::memory_order_release);
+        return item;
+    }
+
+    // Returns std::nullopt once the queue is closed and drained.
+    std::optional<T> pop() {
+        return pop_until(std::chrono::steady_clock::time_point::max());
+    }
+
+    // Like pop(), but gives up at `deadline`. A std::nullopt result means
+    // either a timeout or a closed queue; check closed() to tell them apart.
+    template <typename Clock, typename Duration>
+    std::optional<T> pop_until(const std::chrono::time_point<Clock, Duration>& deadline) {
+        Backoff backoff;
+        while (true) {
+            // Read the flag first: items pushed before close() are still
+            // drained by the try_pop() that follows.
+            const bool was_closed = closed();
+            if (auto item = try_pop()) {
+                return item;
+            }
+            if (was_closed || Clock::now() >= deadline) {
+                return std::nullopt;
+            }
+            backoff.pause();
+        }
+    }
+
+    void close() { closed_.store(true, std::memory_order_release); }
+    bool closed() const { return closed_.load(std::memory_order_acquire); }
+
+    // Consumer side: closed and every item popped. Unlike a std::nullopt from
+    // pop_until(), this cannot be a timeout that raced with close().
+    bool drained() const { return closed() && size() == 0; }
+
+    // Exact only when called from the producer or the consumer thread.
+    std::size_t size() const {
+        return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+    }
+
+    std::size_t capacity() const { return slots_.size(); }
+
+private:
+    // Escalating wait for the blocking calls.
+    class Backoff {
+    public:
+        void pause() {
+            if (rounds_ < kSpinRounds) {
+                ++rounds_;
+            } else if (rounds_ < kSpinRounds + kYieldRounds) {
+                ++rounds_;
+                std::this_thread::yield();
+            } else {
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+        }
+
+    private:
+        static constexpr int kSpinRounds = 64;
+        static constexpr int kYieldRounds = 64;
+        int rounds_ = 0;
+    };
+
+    static std::size_t round_up(std::size_t capacity) {
+        std::size_t size = 1;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        return size;
+    }
+
+    static constexpr std::size_t kCacheLine = 64;
+
+    std::vector<std::optional<T>> slots_;
+    const std::size_t mask_;
+    // Consumer-owned line: its index and its last view of the producer's.
+    alignas(kCacheLine) std::atomic<std::size_t> head_{0};
+    std::size_t tail_cache_ = 0;
+    // Producer-owned line.
+    alignas(kCacheLine) std::atomic<std::size_t> tail_{0};
+    std::size_t head_cache_ = 0;
+    alignas(kCacheLine) std::atomic<bool> closed_{false};
+};
@@ -34,4 +34,28 @@ bool step(sqlite3_stmt* stmt, std::string_view what);
 
 void reset(sqlite3_stmt* stmt);
 
+// Calls reset() when it goes out of scope. Parameters bound with
+// SQLITE_STATIC point into the caller's buffers instead of being copied;
+// resetting before those buffers go away means the statement never holds a
+// dangling pointer.
+class ResetOnExit {
+public:
+    explicit ResetOnExit(sqlite3_stmt* stmt) : stmt_(stmt) {}
+    ~ResetOnExit() { reset(stmt_); }
+    ResetOnExit(const ResetOnExit&) = delete;
+    ResetOnExit& operator=(const ResetOnExit&) = delete;
+
+private:
+    sqlite3_stmt* stmt_;
+};
+
+// Adds `column` to `table` with the given declaration unless it already
+// exists, so databases created by older builds pick up new columns.
+bool ensure_column(
+    sqlite3* db,
+    std::string_view table,
+    std::string_view column,
+    std::string_view decl
+);
+
 }  // namespace sqlite_utils
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include <opencv2/core.hpp>
+
+namespace synthetic {
+
+// Deterministic test frames: the same spec and index always render the same
+// pixels, so load tests are repeatable without shipping an image corpus.
+struct Spec {
+    cv::Size size{640, 480};
+    // Shapes drawn per megapixel. SIFT finds keypoints on their corners and
+    // blobs, so the keypoint count grows roughly linearly with it.
+    double texture = 1000.0;
+    std::uint64_t seed = 1;
+};
+
+// Parses "<width>x<height>" or one of "vga", "720p", "1080p", "4k", "8k".
+std::optional<cv::Size> parse_resolution(std::string_view text);
+
+// Renders frame `index` as an 8-bit BGR image.
+cv::Mat render(const Spec& spec, std::uint64_t index);
+
+// "synthetic-000007-640x480", used as the frame's image_name.
+std::string frame_name(const Spec& spec, std::uint64_t index);
+
+}  // namespace synthetic
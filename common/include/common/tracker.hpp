@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "common/detector.hpp"
+
+// Keypoints for video-like streams without a detector run per frame.
+// Keyframes go through the detector; the frames in between move the
+// previous frame's keypoints with pyramidal Lucas-Kanade optical flow.
+namespace tracker {
+
+struct Config {
+    // Detect on at least every Nth frame.
+    int keyframe_interval = 10;
+    // Detect again once fewer than this share of the keyframe's keypoints
+    // is still tracked.
+    double min_tracked = 0.5;
+    // A point is dropped when tracking it back to the previous frame lands
+    // further than this many pixels from where it started.
+    float max_fb_error = 1.0f;
+    int window = 21;
+    int levels = 3;
+};
+
+// Parses "<interval>[:<min tracked fraction>]", e.g. "10" or "10:0.6".
+std::optional<Config> parse(std::string_view spec);
+
+// Inverse of parse().
+std::string describe(const Config& config);
+
+enum class Kind { Detected, Tracked };
+
+// Follows one stream of consecutive frames, so it needs them in order and
+// on one thread. Tracked keypoints keep the size, angle, response, octave
+// and descriptor they had on their keyframe.
+class Tracker {
+public:
+    Tracker(const detector::Config& detector, const Config& config);
+
+    // Fills `out` for the next frame of the stream. `restart` forces a
+    // keyframe, e.g. after a gap in the sequence.
+    Kind process(const cv::Mat& image, detector::Features& out, bool restart = false);
+
+    const Config& config() const { return config_; }
+
+private:
+    Kind detect(const cv::Mat& gray, detector::Features& out);
+
+    detector::Detector detector_;
+    Config config_;
+    // Grayscale conversion buffer, reused across frames.
+    cv::Mat gray_;
+    // Pyramids of the previous and the current frame; swapped every frame.
+    std::vector<cv::Mat> prev_pyramid_;
+    std::vector<cv::Mat> pyramid_;
+    // The previous frame's keypoints and descriptors.
+    detector::Features prev_;
+    std::size_t keyframe_points_ = 0;
+    int since_keyframe_ = 0;
+    // Scratch for the flow passes.
+    std::vector<cv::Point2f> from_;
+    std::vector<cv::Point2f> to_;
+    std::vector<cv::Point2f> back_;
+    std::vector<unsigned char> status_;
+    std::vector<unsigned char> back_status_;
+    std::vector<float> error_;
+};
+
+}  // namespace tracker
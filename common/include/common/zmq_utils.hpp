@@ -1,11 +1,15 @@
 #pragma once
 
+#include <cstddef>
+#include <memory>
 #include <optional>
 #include <span>
 #include <string>
 #include <string_view>
 #include <vector>
 
+#include <zmq.h>
+
 namespace zmq_utils {
 
 enum class SendResult {
@@ -14,6 +18,57 @@ enum class SendResult {
     Error
 };
 
+// zmq_bind() that first removes a stale socket file left behind by a
+// previous run when `endpoint` is an ipc:// path. Returns zmq_bind's rc.
+int bind_endpoint(void* socket, const std::string& endpoint);
+
+// Sets ZMQ_SNDHWM and ZMQ_RCVHWM (messages queued per peer before a send
+// would block). Must be called before bind/connect to take effect.
+bool set_hwm(void* socket, int sndhwm, int rcvhwm);
+
+// Sets ZMQ_RCVTIMEO; a blocking receive then gives up after `ms` (-1 waits
+// forever), which recv_message() reports as std::nullopt without an error.
+bool set_receive_timeout(void* socket, int ms);
+
+// Owns a single zmq_msg_t. The payload stays in the buffer ZeroMQ received
+// it into, so it can be read in place and forwarded without a copy. Spans
+// and views returned by a Message are invalidated when it is moved from.
+class Message {
+public:
+    Message();
+    ~Message();
+
+    Message(Message&& other) noexcept;
+    Message& operator=(Message&& other) noexcept;
+    Message(const Message&) = delete;
+    Message& operator=(const Message&) = delete;
+
+    std::span<const unsigned char> bytes() const;
+    std::string_view view() const;
+    std::size_t size() const;
+
+    // True when the sender flagged further parts after this one.
+    bool more() const { return more_; }
+
+    zmq_msg_t* raw() { return &msg_; }
+
+private:
+    friend std::optional<Message> recv_message(void*, int, std::string_view);
+
+    zmq_msg_t msg_;
+    bool more_ = false;
+};
+
+std::optional<Message> recv_message(
+    void* socket,
+    int flags = 0,
+    std::string_view what = "zmq_msg_recv"
+);
+
+// Receives and discards the remaining parts of a multipart message, so a
+// reader that bails out early stays aligned on message boundaries.
+void skip_remaining_parts(void* socket);
+
 std::optional<std::string> recv_string(
     void* socket,
     int flags = 0,
@@ -40,4 +95,35 @@ SendResult send_bytes(
     std::string_view what = "zmq_send"
 );
 
+// Sends `msg` without copying its payload. On success ownership moves to
+// ZeroMQ and `msg` is left empty; otherwise `msg` is untouched, so the
+// caller can retry or drop it.
+SendResult send_message(
+    void* socket,
+    Message& msg,
+    int flags,
+    std::string_view what = "zmq_msg_send"
+);
+
+// Sends caller-owned memory without copying it. ZeroMQ calls
+// `free_fn(data, hint)` once it no longer needs the buffer, possibly from
+// its I/O thread; this also happens when the send fails. Pass a null
+// `free_fn` for buffers that outlive the socket and are never modified.
+SendResult send_zero_copy(
+    void* socket,
+    std::span<const unsigned char> data,
+    zmq_free_fn* free_fn,
+    void* hint,
+    int flags,
+    std::string_view what = "zmq_msg_send"
+);
+
+// Zero-copy send that keeps `buffer` alive until ZeroMQ has released it.
+SendResult send_shared(
+    void* socket,
+    std::shared_ptr<const std::vector<unsigned char>> buffer,
+    int flags,
+    std::string_view what = "zmq_msg_send"
+);
+
 }  // namespace zmq_utils
@@ -0,0 +1,103 @@
+#include "common/alloc_counter.hpp"
+
+#include <cerrno>
+#include <cstddef>
+
+#if defined(VOYIS_COUNT_ALLOCATIONS) && defined(__GLIBC__)
+#define VOYIS_ALLOC_COUNTING 1
+#else
+#define VOYIS_ALLOC_COUNTING 0
+#endif
+
+namespace alloc_counter {
+namespace {
+std::atomic<std::uint64_t> g_allocations{0};
+
+inline void count() { g_allocations.fetch_add(1, std::memory_order_relaxed); }
+}  // namespace
+
+bool enabled() { return VOYIS_ALLOC_COUNTING != 0; }
+
+std::uint64_t allocations() { return g_allocations.load(std::memory_order_relaxed); }
+
+Reporter::Reporter(const char* name, std::chrono::seconds interval)
+    : name_(name), interval_(interval), next_report_(std::chrono::steady_clock::now() + interval),
+      last_allocations_(allocations()) {}
+
+void Reporter::maybe_report(std::ostream& out) {
+    if (!enabled()) {
+        return;
+    }
+    const auto now = std::chrono::steady_clock::now();
+    if (now < next_report_) {
+        return;
+    }
+    next_report_ = now + interval_;
+    // Taken before printing, which allocates itself.
+    const std::uint64_t total = allocations();
+    const std::uint64_t frames = frames_.load(std::memory_order_relaxed);
+    const std::uint64_t interval_frames = frames - last_frames_;
+    const std::uint64_t interval_allocations = total - last_allocations_;
+    out << "Allocations " << name_ << ": frames=" << interval_frames << " per_frame=";
+    if (interval_frames != 0) {
+        out << static_cast<double>(interval_allocations) / static_cast<double>(interval_frames);
+    } else {
+        out << "-";
+    }
+    out << " total=" << total << "\n";
+    last_frames_ = frames;
+    last_allocations_ = allocations();
+}
+
+}  // namespace alloc_counter
+
+#if VOYIS_ALLOC_COUNTING
+// Defining the allocator entry points in the executable interposes them on
+// every shared library as well. This object is linked in because the apps
+// call alloc_counter::allocations(). free() and the glibc internals stay
+// untouched; the __libc_* entry points are the real allocator.
+extern "C" {
+void* __libc_malloc(std::size_t size);
+void* __libc_calloc(std::size_t count, std::size_t size);
+void* __libc_realloc(void* ptr, std::size_t size);
+void* __libc_memalign(std::size_t alignment, std::size_t size);
+
+void* malloc(std::size_t size) noexcept {
+    alloc_counter::count();
+    return __libc_malloc(size);
+}
+
+void* calloc(std::size_t count, std::size_t size) noexcept {
+    alloc_counter::count();
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, std::size_t size) noexcept {
+    alloc_counter::count();
+    return __libc_realloc(ptr, size);
+}
+
+void* memalign(std::size_t alignment, std::size_t size) noexcept {
+    alloc_counter::count();
+    return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(std::size_t alignment, std::size_t size) noexcept {
+    alloc_counter::count();
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** out, std::size_t alignment, std::size_t size) noexcept {
+    if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0) {
+        return EINVAL;
+    }
+    alloc_counter::count();
+    void* ptr = __libc_memalign(alignment, size);
+    if (!ptr) {
+        return ENOMEM;
+    }
+    *out = ptr;
+    return 0;
+}
+}
+#endif
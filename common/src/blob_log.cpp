@@ -0,0 +1,233 @@
+#include "common/blob_log.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "common/hash_utils.hpp"
+#include "common/log.hpp"
+
+namespace fs = std::filesystem;
+
+namespace blob_log {
+namespace {
+
+constexpr char kSegmentPrefix[] = "segment-";
+constexpr char kSegmentSuffix[] = ".blob";
+
+std::optional<std::uint32_t> parse_segment_id(const fs::path& path) {
+    std::string name = path.filename().string();
+    const std::size_t prefix = sizeof(kSegmentPrefix) - 1;
+    const std::size_t suffix = sizeof(kSegmentSuffix) - 1;
+    if (name.size() <= prefix + suffix || name.compare(0, prefix, kSegmentPrefix) != 0 ||
+        name.compare(name.size() - suffix, suffix, kSegmentSuffix) != 0) {
+        return std::nullopt;
+    }
+    try {
+        return static_cast<std::uint32_t>(
+            std::stoul(name.substr(prefix, name.size() - prefix - suffix), nullptr, 16));
+    } catch (const std::exception&) {
+        return std::nullopt;
+    }
+}
+
+}  // namespace
+
+std::uint32_t checksum(std::span<const unsigned char> data) {
+    return static_cast<std::uint32_t>(hash_utils::hash128(data).lo);
+}
+
+fs::path segment_path(const fs::path& dir, std::uint32_t segment_id) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%s%08x%s", kSegmentPrefix, segment_id, kSegmentSuffix);
+    return dir / name;
+}
+
+std::optional<Writer> Writer::open(const fs::path& dir, std::uint64_t max_segment_bytes) {
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+    if (ec) {
+        std::cerr << "[ERROR] blob log: cannot create " << dir << ": " << ec.message() << "\n";
+        return std::nullopt;
+    }
+    std::uint32_t next_id = 0;
+    for (const auto& entry : fs::directory_iterator(dir, ec)) {
+        if (auto id = parse_segment_id(entry.path())) {
+            next_id = std::max(next_id, *id + 1);
+        }
+    }
+    Writer writer(dir, max_segment_bytes, next_id);
+    if (!writer.roll()) {
+        return std::nullopt;
+    }
+    return writer;
+}
+
+Writer::Writer(fs::path dir, std::uint64_t max_segment_bytes, std::uint32_t next_id)
+    : dir_(std::move(dir)), max_segment_bytes_(max_segment_bytes), segment_id_(next_id) {}
+
+Writer::~Writer() {
+    if (fd_ >= 0) {
+        sync();
+        ::close(fd_);
+    }
+}
+
+Writer::Writer(Writer&& other) noexcept
+    : dir_(std::move(other.dir_)),
+      max_segment_bytes_(other.max_segment_bytes_),
+      segment_id_(other.segment_id_),
+      segment_size_(other.segment_size_),
+      fd_(other.fd_),
+      dirty_(other.dirty_) {
+    other.fd_ = -1;
+}
+
+Writer& Writer::operator=(Writer&& other) noexcept {
+    if (this != &other) {
+        if (fd_ >= 0) {
+            // Rows may already reference the dirty appends, as in ~Writer.
+            sync();
+            ::close(fd_);
+        }
+        dir_ = std::move(other.dir_);
+        max_segment_bytes_ = other.max_segment_bytes_;
+        segment_id_ = other.segment_id_;
+        segment_size_ = other.segment_size_;
+        fd_ = other.fd_;
+        dirty_ = other.dirty_;
+        other.fd_ = -1;
+    }
+    return *this;
+}
+
+bool Writer::roll() {
+    if (fd_ >= 0) {
+        if (!sync()) {
+            return false;
+        }
+        ::close(fd_);
+        fd_ = -1;
+        ++segment_id_;
+    }
+    fs::path path = segment_path(dir_, segment_id_);
+    fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        logging::error("blob log: cannot create ", path.string(), ": ", std::strerror(errno));
+        return false;
+    }
+    segment_size_ = 0;
+    return true;
+}
+
+std::optional<BlobRef> Writer::append(std::span<const unsigned char> data, std::uint32_t sum) {
+    if (fd_ < 0) {
+        return std::nullopt;
+    }
+    if (segment_size_ > 0 && segment_size_ + data.size() > max_segment_bytes_ && !roll()) {
+        return std::nullopt;
+    }
+    BlobRef ref{segment_id_, segment_size_, static_cast<std::uint32_t>(data.size()), sum};
+    std::size_t written = 0;
+    while (written < data.size()) {
+        ssize_t rc = ::write(fd_, data.data() + written, data.size() - written);
+        if (rc < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            logging::error("blob log: write failed: ", std::strerror(errno));
+            // Keep later offsets consistent with the bytes actually on disk.
+            segment_size_ += written;
+            return std::nullopt;
+        }
+        written += static_cast<std::size_t>(rc);
+    }
+    segment_size_ += written;
+    dirty_ = true;
+    return ref;
+}
+
+bool Writer::sync() {
+    if (fd_ < 0 || !dirty_) {
+        return true;
+    }
+    if (::fdatasync(fd_) != 0) {
+        logging::error("blob log: fdatasync failed: ", std::strerror(errno));
+        return false;
+    }
+    dirty_ = false;
+    return true;
+}
+
+struct Reader::Mapping {
+    void* addr = nullptr;
+    std::size_t size = 0;
+
+    ~Mapping() {
+        if (addr) {
+            ::munmap(addr, size);
+        }
+    }
+};
+
+Reader::Reader(fs::path dir) : dir_(std::move(dir)) {}
+
+Reader::~Reader() = default;
+
+const Reader::Mapping* Reader::map_segment(std::uint32_t segment_id, std::uint64_t min_size) {
+    auto range = mappings_.equal_range(segment_id);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second->size >= min_size) {
+            return it->second.get();
+        }
+    }
+
+    fs::path path = segment_path(dir_, segment_id);
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat st {};
+    if (::fstat(fd, &st) != 0 || static_cast<std::uint64_t>(st.st_size) < min_size ||
+        st.st_size == 0) {
+        ::close(fd);
+        return nullptr;
+    }
+    void* addr = ::mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        return nullptr;
+    }
+    auto mapping = std::make_unique<Mapping>();
+    mapping->addr = addr;
+    mapping->size = static_cast<std::size_t>(st.st_size);
+    return mappings_.emplace(segment_id, std::move(mapping))->second.get();
+}
+
+std::optional<std::span<const unsigned char>> Reader::read(const BlobRef& ref, bool verify) {
+    const Mapping* mapping = nullptr;
+    {
+        std::lock_guard lock(mutex_);
+        mapping = map_segment(ref.segment_id, ref.offset + ref.length);
+    }
+    if (!mapping) {
+        return std::nullopt;
+    }
+    std::span<const unsigned char> view(
+        static_cast<const unsigned char*>(mapping->addr) + ref.offset, ref.length);
+    if (verify && checksum(view) != ref.checksum) {
+        return std::nullopt;
+    }
+    return view;
+}
+
+}  // namespace blob_log
@@ -0,0 +1,75 @@
+#include "common/cli_utils.hpp"
+
+#include <cstdlib>
+#include <iostream>
+
+namespace cli_utils {
+
+Args::Args(int argc, char** argv) {
+    if (argc > 0) {
+        program_ = argv[0];
+    }
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg(argv[i]);
+        if (arg.size() < 3 || arg.substr(0, 2) != "--") {
+            positional_.emplace_back(arg);
+            continue;
+        }
+        arg.remove_prefix(2);
+        auto eq = arg.find('=');
+        if (eq == std::string_view::npos) {
+            options_[std::string(arg)] = std::string{};
+        } else {
+            options_[std::string(arg.substr(0, eq))] = std::string(arg.substr(eq + 1));
+        }
+    }
+}
+
+bool Args::has(std::string_view name) const {
+    return options_.find(std::string(name)) != options_.end();
+}
+
+std::optional<std::string> Args::value(std::string_view name) const {
+    auto it = options_.find(std::string(name));
+    if (it == options_.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+std::string Args::get(std::string_view name, std::string_view fallback) const {
+    auto v = value(name);
+    return v ? *v : std::string(fallback);
+}
+
+long long Args::get_int(std::string_view name, long long fallback) const {
+    auto v = value(name);
+    if (!v || v->empty()) {
+        return fallback;
+    }
+    char* end = nullptr;
+    long long parsed = std::strtoll(v->c_str(), &end, 10);
+    if (end == v->c_str() || *end != '\0') {
+        std::cerr << "[WARN] --" << name << "=" << *v
+                  << " is not an integer, using " << fallback << "\n";
+        return fallback;
+    }
+    return parsed;
+}
+
+double Args::get_double(std::string_view name, double fallback) const {
+    auto v = value(name);
+    if (!v || v->empty()) {
+        return fallback;
+    }
+    char* end = nullptr;
+    double parsed = std::strtod(v->c_str(), &end);
+    if (end == v->c_str() || *end != '\0') {
+        std::cerr << "[WARN] --" << name << "=" << *v
+                  << " is not a number, using " << fallback << "\n";
+        return fallback;
+    }
+    return parsed;
+}
+
+}  // namespace cli_utils
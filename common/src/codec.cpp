@@ -0,0 +1,382 @@
+#include "common/codec.hpp"
+
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "common/log.hpp"
+
+namespace codec {
+namespace {
+
+// QOI, see https://qoiformat.org/qoi-specification.pdf. Frames are always
+// written as 3-channel sRGB; the BGR <-> RGB swap happens per pixel.
+constexpr unsigned char kQoiOpIndex = 0x00;
+constexpr unsigned char kQoiOpDiff  = 0x40;
+constexpr unsigned char kQoiOpLuma  = 0x80;
+constexpr unsigned char kQoiOpRun   = 0xc0;
+constexpr unsigned char kQoiOpRgb   = 0xfe;
+constexpr unsigned char kQoiOpRgba  = 0xff;
+constexpr unsigned char kQoiMask2   = 0xc0;
+constexpr std::size_t kQoiHeaderSize = 14;
+// Pixels one QOI_OP_RUN byte covers at most; no chunk byte covers more.
+constexpr int kQoiMaxRun = 62;
+constexpr std::array<unsigned char, 8> kQoiPadding{0, 0, 0, 0, 0, 0, 0, 1};
+
+struct QoiPixel {
+    unsigned char r = 0;
+    unsigned char g = 0;
+    unsigned char b = 0;
+    unsigned char a = 255;
+
+    bool operator==(const QoiPixel&) const = default;
+};
+
+inline int qoi_hash(const QoiPixel& px) {
+    return (px.r * 3 + px.g * 5 + px.b * 7 + px.a * 11) % 64;
+}
+
+void put_u32_be(unsigned char* p, std::uint32_t v) {
+    p[0] = static_cast<unsigned char>(v >> 24);
+    p[1] = static_cast<unsigned char>(v >> 16);
+    p[2] = static_cast<unsigned char>(v >> 8);
+    p[3] = static_cast<unsigned char>(v);
+}
+
+std::uint32_t get_u32_be(const unsigned char* p) {
+    return (std::uint32_t{p[0]} << 24) | (std::uint32_t{p[1]} << 16) |
+           (std::uint32_t{p[2]} << 8) | std::uint32_t{p[3]};
+}
+
+void qoi_encode(const cv::Mat& bgr, std::vector<unsigned char>& out) {
+    const std::size_t pixels = static_cast<std::size_t>(bgr.rows) * bgr.cols;
+    // Worst case is one QOI_OP_RGB (4 bytes) per pixel.
+    out.resize(kQoiHeaderSize + pixels * 4 + kQoiPadding.size());
+    unsigned char* bytes = out.data();
+    std::memcpy(bytes, "qoif", 4);
+    put_u32_be(bytes + 4, static_cast<std::uint32_t>(bgr.cols));
+    put_u32_be(bytes + 8, static_cast<std::uint32_t>(bgr.rows));
+    bytes[12] = 3;
+    bytes[13] = 0;
+    std::size_t p = kQoiHeaderSize;
+
+    std::array<QoiPixel, 64> index{};
+    for (auto& px : index) {
+        px.a = 0;
+    }
+    QoiPixel prev;
+    int run = 0;
+    std::size_t remaining = pixels;
+    for (int y = 0; y < bgr.rows; ++y) {
+        const unsigned char* row = bgr.ptr<unsigned char>(y);
+        for (int x = 0; x < bgr.cols; ++x, row += 3) {
+            --remaining;
+            QoiPixel px{row[2], row[1], row[0], 255};
+            if (px == prev) {
+                ++run;
+                if (run == kQoiMaxRun || remaining == 0) {
+                    bytes[p++] = static_cast<unsigned char>(kQoiOpRun | (run - 1));
+                    run = 0;
+                }
+                continue;
+            }
+            if (run > 0) {
+                bytes[p++] = static_cast<unsigned char>(kQoiOpRun | (run - 1));
+                run = 0;
+            }
+            int h = qoi_hash(px);
+            if (index[h] == px) {
+                bytes[p++] = static_cast<unsigned char>(kQoiOpIndex | h);
+            } else {
+                index[h] = px;
+                int vr = static_cast<signed char>(px.r - prev.r);
+                int vg = static_cast<signed char>(px.g - prev.g);
+                int vb = static_cast<signed char>(px.b - prev.b);
+                int vg_r = vr - vg;
+                int vg_b = vb - vg;
+                if (vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2) {
+                    bytes[p++] = static_cast<unsigned char>(
+                        kQoiOpDiff | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2));
+                } else if (vg_r > -9 && vg_r < 8 && vg > -33 && vg < 32 &&
+                           vg_b > -9 && vg_b < 8) {
+                    bytes[p++] = static_cast<unsigned char>(kQoiOpLuma | (vg + 32));
+                    bytes[p++] = static_cast<unsigned char>((vg_r + 8) << 4 | (vg_b + 8));
+                } else {
+                    bytes[p++] = kQoiOpRgb;
+                    bytes[p++] = px.r;
+                    bytes[p++] = px.g;
+                    bytes[p++] = px.b;
+                }
+            }
+            prev = px;
+        }
+    }
+    std::memcpy(bytes + p, kQoiPadding.data(), kQoiPadding.size());
+    p += kQoiPadding.size();
+    out.resize(p);
+}
+
+// Decodes into `img`, reusing its buffer when the size already matches.
+bool qoi_decode(std::span<const unsigned char> data, cv::Mat& img) {
+    if (data.size() < kQoiHeaderSize + kQoiPadding.size() ||
+        std::memcmp(data.data(), "qoif", 4) != 0) {
+        return false;
+    }
+    std::uint32_t width = get_u32_be(data.data() + 4);
+    std::uint32_t height = get_u32_be(data.data() + 8);
+    if (width == 0 || height == 0 || width > 1u << 16 || height > 1u << 16) {
+        return false;
+    }
+    // A short, malformed payload must not make us allocate the image its
+    // header claims: reject sizes the chunk bytes could not encode.
+    const std::uint64_t chunk_bytes = data.size() - kQoiHeaderSize - kQoiPadding.size();
+    if (std::uint64_t{width} * height > chunk_bytes * kQoiMaxRun) {
+        return false;
+    }
+
+    img.create(static_cast<int>(height), static_cast<int>(width), CV_8UC3);
+    std::array<QoiPixel, 64> index{};
+    for (auto& px : index) {
+        px.a = 0;
+    }
+    QoiPixel px;
+    int run = 0;
+    std::size_t p = kQoiHeaderSize;
+    const std::size_t chunks_end = data.size() - kQoiPadding.size();
+    for (int y = 0; y < img.rows; ++y) {
+        unsigned char* row = img.ptr<unsigned char>(y);
+        for (int x = 0; x < img.cols; ++x, row += 3) {
+            if (run > 0) {
+                --run;
+            } else if (p < chunks_end) {
+                unsigned char b1 = data[p++];
+                if (b1 == kQoiOpRgb) {
+                    if (p + 3 > chunks_end) return false;
+                    px.r = data[p++];
+                    px.g = data[p++];
+                    px.b = data[p++];
+                } else if (b1 == kQoiOpRgba) {
+                    if (p + 4 > chunks_end) return false;
+                    px.r = data[p++];
+                    px.g = data[p++];
+                    px.b = data[p++];
+                    px.a = data[p++];
+                } else if ((b1 & kQoiMask2) == kQoiOpIndex) {
+                    px = index[b1];
+                } else if ((b1 & kQoiMask2) == kQoiOpDiff) {
+                    px.r = static_cast<unsigned char>(px.r + ((b1 >> 4) & 0x03) - 2);
+                    px.g = static_cast<unsigned char>(px.g + ((b1 >> 2) & 0x03) - 2);
+                    px.b = static_cast<unsigned char>(px.b + (b1 & 0x03) - 2);
+                } else if ((b1 & kQoiMask2) == kQoiOpLuma) {
+                    if (p >= chunks_end) return false;
+                    unsigned char b2 = data[p++];
+                    int vg = (b1 & 0x3f) - 32;
+                    px.r = static_cast<unsigned char>(px.r + vg - 8 + ((b2 >> 4) & 0x0f));
+                    px.g = static_cast<unsigned char>(px.g + vg);
+                    px.b = static_cast<unsigned char>(px.b + vg - 8 + (b2 & 0x0f));
+                } else {
+                    run = b1 & 0x3f;
+                }
+                index[qoi_hash(px)] = px;
+            } else {
+                return false;
+            }
+            row[0] = px.b;
+            row[1] = px.g;
+            row[2] = px.r;
+        }
+    }
+    return true;
+}
+
+// Returns `img` converted to `channels` (1 or 3), reusing it when it
+// already matches.
+cv::Mat with_channels(const cv::Mat& img, int channels) {
+    if (img.channels() == channels) {
+        return img;
+    }
+    cv::Mat converted;
+    if (channels == 1) {
+        cv::cvtColor(img, converted, img.channels() == 4 ? cv::COLOR_BGRA2GRAY
+                                                         : cv::COLOR_BGR2GRAY);
+    } else if (img.channels() == 1) {
+        cv::cvtColor(img, converted, cv::COLOR_GRAY2BGR);
+    } else {
+        cv::cvtColor(img, converted, cv::COLOR_BGRA2BGR);
+    }
+    return converted;
+}
+
+bool encode_raw(const cv::Mat& img, int channels, std::vector<unsigned char>& out) {
+    cv::Mat src = with_channels(img, channels);
+    const std::size_t row_bytes = static_cast<std::size_t>(src.cols) * src.elemSize();
+    out.resize(row_bytes * src.rows);
+    if (src.isContinuous()) {
+        std::memcpy(out.data(), src.data, out.size());
+        return true;
+    }
+    for (int y = 0; y < src.rows; ++y) {
+        std::memcpy(out.data() + row_bytes * y, src.ptr<unsigned char>(y), row_bytes);
+    }
+    return true;
+}
+
+}  // namespace
+
+std::optional<Options> parse(std::string_view spec) {
+    std::string_view name = spec;
+    std::string_view level;
+    if (auto colon = spec.find(':'); colon != std::string_view::npos) {
+        name = spec.substr(0, colon);
+        level = spec.substr(colon + 1);
+    }
+    auto kind = kind_from_encoding(name);
+    if (!kind) {
+        return std::nullopt;
+    }
+    Options options;
+    options.kind = *kind;
+    if (!level.empty()) {
+        int value = 0;
+        auto [ptr, ec] = std::from_chars(level.data(), level.data() + level.size(), value);
+        if (ec != std::errc{} || ptr != level.data() + level.size()) {
+            return std::nullopt;
+        }
+        if ((options.kind == Kind::Png && (value < 0 || value > 9)) ||
+            (options.kind == Kind::Jpeg && (value < 0 || value > 100))) {
+            return std::nullopt;
+        }
+        options.level = value;
+    }
+    return options;
+}
+
+std::string describe(const Options& options) {
+    std::string out(encoding_name(options.kind));
+    if (options.level >= 0 && (options.kind == Kind::Png || options.kind == Kind::Jpeg)) {
+        out += ":" + std::to_string(options.level);
+    }
+    return out;
+}
+
+std::string_view encoding_name(Kind kind) {
+    switch (kind) {
+        case Kind::RawBgr8:  return "raw_bgr8";
+        case Kind::RawGray8: return "raw_gray8";
+        case Kind::Png:      return "png";
+        case Kind::Jpeg:     return "jpeg";
+        case Kind::Qoi:      return "qoi";
+    }
+    return "unknown";
+}
+
+std::optional<Kind> kind_from_encoding(std::string_view encoding) {
+    if (encoding == "raw_bgr8")  return Kind::RawBgr8;
+    if (encoding == "raw_gray8") return Kind::RawGray8;
+    if (encoding == "png")       return Kind::Png;
+    if (encoding == "jpeg" || encoding == "jpg") return Kind::Jpeg;
+    if (encoding == "qoi")       return Kind::Qoi;
+    return std::nullopt;
+}
+
+std::string_view sniff(std::span<const unsigned char> data) {
+    if (data.size() >= 3 && data[0] == 0xFF && data[1] == 0xD8 && data[2] == 0xFF) {
+        return "jpeg";
+    }
+    if (data.size() >= 8 && data[0] == 0x89 && data[1] == 'P' && data[2] == 'N' &&
+        data[3] == 'G') {
+        return "png";
+    }
+    if (data.size() >= 4 && std::memcmp(data.data(), "qoif", 4) == 0) {
+        return "qoi";
+    }
+    if (data.size() >= 2 && data[0] == 'B' && data[1] == 'M') {
+        return "bmp";
+    }
+    return {};
+}
+
+bool encode(const cv::Mat& img, const Options& options, std::vector<unsigned char>& out) {
+    if (img.empty() || img.depth() != CV_8U) {
+        logging::error("codec::encode expects a non-empty 8-bit image");
+        return false;
+    }
+    switch (options.kind) {
+        case Kind::RawBgr8:
+            return encode_raw(img, 3, out);
+        case Kind::RawGray8:
+            return encode_raw(img, 1, out);
+        case Kind::Qoi:
+            qoi_encode(with_channels(img, 3), out);
+            return true;
+        case Kind::Png: {
+            std::vector<int> params;
+            if (options.level >= 0) {
+                params = {cv::IMWRITE_PNG_COMPRESSION, options.level};
+            }
+            return cv::imencode(".png", img, out, params);
+        }
+        case Kind::Jpeg: {
+            std::vector<int> params;
+            if (options.level >= 0) {
+                params = {cv::IMWRITE_JPEG_QUALITY, options.level};
+            }
+            return cv::imencode(".jpg", img, out, params);
+        }
+    }
+    return false;
+}
+
+cv::Mat decode(
+    std::string_view encoding,
+    std::span<const unsigned char> data,
+    int rows,
+    int cols
+) {
+    cv::Mat img;
+    decode(encoding, data, rows, cols, img);
+    return img;
+}
+
+bool decode(
+    std::string_view encoding,
+    std::span<const unsigned char> data,
+    int rows,
+    int cols,
+    cv::Mat& out
+) {
+    auto kind = kind_from_encoding(encoding);
+    if (kind == Kind::RawBgr8 || kind == Kind::RawGray8) {
+        int type = kind == Kind::RawBgr8 ? CV_8UC3 : CV_8UC1;
+        std::size_t channels = kind == Kind::RawBgr8 ? 3 : 1;
+        if (rows <= 0 || cols <= 0 ||
+            data.size() != static_cast<std::size_t>(rows) * cols * channels) {
+            out.release();
+            return false;
+        }
+        out = cv::Mat(rows, cols, type, const_cast<unsigned char*>(data.data()));
+        return true;
+    }
+    // A raw view left in `out` by an earlier frame must not be written
+    // through; only a buffer the Mat owns is reused.
+    if (out.data && !out.u) {
+        out.release();
+    }
+    if (kind == Kind::Qoi) {
+        if (!qoi_decode(data, out)) {
+            out.release();
+            return false;
+        }
+        return true;
+    }
+    cv::Mat wrapped(1, static_cast<int>(data.size()), CV_8U,
+                    const_cast<unsigned char*>(data.data()));
+    cv::imdecode(wrapped, cv::IMREAD_COLOR, &out);
+    return !out.empty();
+}
+
+}  // namespace codec
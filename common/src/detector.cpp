@@ -0,0 +1,358 @@
+#include "common/detector.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <numeric>
+#include <sstream>
+
+#include <opencv2/imgproc.hpp>
+
+// BRIEF lives in opencv_contrib. Without it FastBrief describes its FAST
+// corners with ORB's rotated BRIEF, which has the same 32-byte layout.
+#if __has_include(<opencv2/xfeatures2d.hpp>)
+#include <opencv2/xfeatures2d.hpp>
+#define VOYIS_HAVE_XFEATURES2D 1
+#endif
+
+namespace detector {
+namespace {
+
+// ORB needs a budget; this is its own default.
+constexpr int kOrbDefaultFeatures = 500;
+constexpr int kFastThreshold = 20;
+// Tiles need room for the margin to pay off.
+constexpr int kMinTile = 64;
+// Two tiles that see the same pixels around a seam localise a keypoint
+// identically; coarse keypoints whose support exceeds the margin can land
+// this far apart on either side.
+constexpr float kSeamTolerance = 1.0f;
+
+template <typename T>
+std::optional<T> parse_number(std::string_view text) {
+    T value{};
+    auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (ec != std::errc{} || ptr != text.data() + text.size()) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+std::string_view backend_name(Backend backend) {
+    switch (backend) {
+        case Backend::Sift:      return "sift";
+        case Backend::Orb:       return "orb";
+        case Backend::Akaze:     return "akaze";
+        case Backend::FastBrief: return "fast-brief";
+    }
+    return "unknown";
+}
+
+std::optional<Backend> parse_backend(std::string_view name) {
+    for (Backend backend : {Backend::Sift, Backend::Orb, Backend::Akaze, Backend::FastBrief}) {
+        if (name == backend_name(backend)) {
+            return backend;
+        }
+    }
+    return std::nullopt;
+}
+
+cv::Ptr<cv::Feature2D> brief_extractor() {
+#ifdef VOYIS_HAVE_XFEATURES2D
+    return cv::xfeatures2d::BriefDescriptorExtractor::create(32);
+#else
+    return cv::ORB::create();
+#endif
+}
+
+// Copies the `cap` strongest keypoints of `all`, and their descriptor
+// rows, into `out`.
+void keep_strongest(const Features& all, std::size_t cap, std::vector<int>& order, Features& out) {
+    order.resize(all.keypoints.size());
+    std::iota(order.begin(), order.end(), 0);
+    const std::size_t kept = std::min(cap, order.size());
+    std::partial_sort(order.begin(), order.begin() + static_cast<std::ptrdiff_t>(kept), order.end(),
+                      [&](int a, int b) { return all.keypoints[a].response > all.keypoints[b].response; });
+    out.keypoints.clear();
+    out.keypoints.reserve(kept);
+    if (all.descriptors.empty()) {
+        out.descriptors.release();
+    } else {
+        out.descriptors.create(static_cast<int>(kept), all.descriptors.cols, all.descriptors.type());
+    }
+    for (std::size_t i = 0; i < kept; ++i) {
+        out.keypoints.push_back(all.keypoints[order[i]]);
+        if (!all.descriptors.empty()) {
+            cv::Mat row = out.descriptors.row(static_cast<int>(i));
+            all.descriptors.row(order[i]).copyTo(row);
+        }
+    }
+}
+
+}  // namespace
+
+std::optional<Config> parse(std::string_view spec) {
+    Config config;
+    if (auto hash = spec.find('#'); hash != std::string_view::npos) {
+        auto tile = parse_number<int>(spec.substr(hash + 1));
+        if (!tile || *tile < kMinTile) {
+            return std::nullopt;
+        }
+        config.tile = *tile;
+        spec = spec.substr(0, hash);
+    }
+    if (auto at = spec.find('@'); at != std::string_view::npos) {
+        auto scale = parse_number<double>(spec.substr(at + 1));
+        if (!scale || *scale <= 0.0 || *scale > 1.0) {
+            return std::nullopt;
+        }
+        config.scale = *scale;
+        spec = spec.substr(0, at);
+    }
+    if (auto colon = spec.find(':'); colon != std::string_view::npos) {
+        auto cap = parse_number<int>(spec.substr(colon + 1));
+        if (!cap || *cap < 0) {
+            return std::nullopt;
+        }
+        config.max_features = *cap;
+        spec = spec.substr(0, colon);
+    }
+    auto backend = parse_backend(spec);
+    if (!backend) {
+        return std::nullopt;
+    }
+    config.backend = *backend;
+    return config;
+}
+
+std::string describe(const Config& config) {
+    std::ostringstream out;
+    out << backend_name(config.backend);
+    if (config.max_features > 0) {
+        out << ":" << config.max_features;
+    }
+    if (config.scale != 1.0) {
+        out << "@" << config.scale;
+    }
+    if (config.tile > 0) {
+        out << "#" << config.tile;
+    }
+    return out.str();
+}
+
+Detector::Detector(const Config& config) : config_(config), engine_(make_engine()) {}
+
+Detector::Engine Detector::make_engine() const {
+    Engine engine;
+    switch (config_.backend) {
+        case Backend::Sift:
+            engine.impl = cv::SIFT::create(config_.max_features);
+            break;
+        case Backend::Orb:
+            engine.impl = cv::ORB::create(config_.max_features > 0 ? config_.max_features
+                                                                   : kOrbDefaultFeatures);
+            break;
+        case Backend::Akaze:
+            engine.impl = cv::AKAZE::create();
+            break;
+        case Backend::FastBrief:
+            engine.fast = cv::FastFeatureDetector::create(kFastThreshold);
+            engine.impl = brief_extractor();
+            break;
+    }
+    return engine;
+}
+
+void Detector::run(Engine& engine, const cv::Mat& input, Features& out) const {
+    out.keypoints.clear();
+    switch (config_.backend) {
+        case Backend::Sift:
+        case Backend::Orb:
+            // Both cap the keypoint count themselves.
+            engine.impl->detectAndCompute(input, cv::noArray(), out.keypoints, out.descriptors);
+            break;
+        case Backend::Akaze:
+            // AKAZE builds its nonlinear scale space in detect() and again in
+            // compute(), so it does both in one call and is capped afterwards.
+            if (config_.max_features <= 0) {
+                engine.impl->detectAndCompute(input, cv::noArray(), out.keypoints, out.descriptors);
+                break;
+            }
+            engine.impl->detectAndCompute(input, cv::noArray(), engine.uncapped.keypoints,
+                                          engine.uncapped.descriptors);
+            keep_strongest(engine.uncapped, static_cast<std::size_t>(config_.max_features),
+                           engine.order, out);
+            break;
+        case Backend::FastBrief:
+            engine.fast->detect(input, out.keypoints);
+            if (config_.max_features > 0) {
+                cv::KeyPointsFilter::retainBest(out.keypoints, config_.max_features);
+            }
+            engine.impl->compute(input, out.keypoints, out.descriptors);
+            break;
+    }
+}
+
+void Detector::layout_tiles(cv::Size size) {
+    tiled_size_ = size;
+    // Even splits, so no tile is a thin remainder.
+    const int cols = std::max(1, (size.width + config_.tile / 2) / config_.tile);
+    const int rows = std::max(1, (size.height + config_.tile / 2) / config_.tile);
+    const std::size_t count = static_cast<std::size_t>(cols) * static_cast<std::size_t>(rows);
+    while (tiles_.size() < count) {
+        tiles_.push_back({{}, {}, make_engine(), {}});
+    }
+    tiles_.resize(count);
+
+    const int m = config_.tile_margin;
+    for (int r = 0; r < rows; ++r) {
+        const int y0 = size.height * r / rows;
+        const int y1 = size.height * (r + 1) / rows;
+        for (int c = 0; c < cols; ++c) {
+            const int x0 = size.width * c / cols;
+            const int x1 = size.width * (c + 1) / cols;
+            Tile& tile = tiles_[static_cast<std::size_t>(r) * cols + c];
+            tile.core = cv::Rect(x0, y0, x1 - x0, y1 - y0);
+            const int wx0 = std::max(0, x0 - m);
+            const int wy0 = std::max(0, y0 - m);
+            tile.window = cv::Rect(wx0, wy0, std::min(size.width, x1 + m) - wx0,
+                                   std::min(size.height, y1 + m) - wy0);
+        }
+    }
+}
+
+void Detector::detect_tiled(const cv::Mat& input, Features& out) {
+    if (input.size() != tiled_size_) {
+        layout_tiles(input.size());
+    }
+    if (tiles_.size() == 1) {
+        run(engine_, input, out);
+        return;
+    }
+
+    cv::parallel_for_(cv::Range(0, static_cast<int>(tiles_.size())), [&](const cv::Range& range) {
+        for (int i = range.start; i < range.end; ++i) {
+            Tile& tile = tiles_[static_cast<std::size_t>(i)];
+            run(tile.engine, input(tile.window), tile.features);
+            for (auto& kp : tile.features.keypoints) {
+                kp.pt.x += static_cast<float>(tile.window.x);
+                kp.pt.y += static_cast<float>(tile.window.y);
+            }
+        }
+    });
+
+    // Each keypoint is kept by the tile whose core contains its centre.
+    struct Pick {
+        std::size_t tile;
+        int row;
+        const cv::KeyPoint* kp;
+    };
+    std::vector<Pick> picks;
+    std::vector<std::size_t> seam;
+    for (std::size_t t = 0; t < tiles_.size(); ++t) {
+        const Tile& tile = tiles_[t];
+        const auto x0 = static_cast<float>(tile.core.x);
+        const auto y0 = static_cast<float>(tile.core.y);
+        const auto x1 = static_cast<float>(tile.core.x + tile.core.width);
+        const auto y1 = static_cast<float>(tile.core.y + tile.core.height);
+        const auto& keypoints = tile.features.keypoints;
+        for (std::size_t k = 0; k < keypoints.size(); ++k) {
+            const cv::KeyPoint& kp = keypoints[k];
+            if (kp.pt.x < x0 || kp.pt.x >= x1 || kp.pt.y < y0 || kp.pt.y >= y1) {
+                continue;
+            }
+            if (std::min({kp.pt.x - x0, x1 - kp.pt.x, kp.pt.y - y0, y1 - kp.pt.y}) < kSeamTolerance) {
+                seam.push_back(picks.size());
+            }
+            picks.push_back({t, static_cast<int>(k), &kp});
+        }
+    }
+
+    // Drop the weaker of two keypoints from different tiles that sit within
+    // kSeamTolerance of each other at the same octave.
+    std::sort(seam.begin(), seam.end(),
+              [&](std::size_t a, std::size_t b) { return picks[a].kp->pt.x < picks[b].kp->pt.x; });
+    std::vector<bool> dropped(picks.size(), false);
+    for (std::size_t i = 0; i < seam.size(); ++i) {
+        const Pick& a = picks[seam[i]];
+        for (std::size_t j = i + 1; j < seam.size(); ++j) {
+            const Pick& b = picks[seam[j]];
+            if (b.kp->pt.x - a.kp->pt.x >= kSeamTolerance) {
+                break;
+            }
+            // SIFT packs layer and sub-pixel offset above the octave byte.
+            if (a.tile == b.tile || (a.kp->octave & 0xff) != (b.kp->octave & 0xff) ||
+                std::abs(b.kp->pt.y - a.kp->pt.y) >= kSeamTolerance) {
+                continue;
+            }
+            dropped[a.kp->response < b.kp->response ? seam[i] : seam[j]] = true;
+        }
+    }
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i < picks.size(); ++i) {
+        if (!dropped[i]) {
+            picks[kept++] = picks[i];
+        }
+    }
+    picks.resize(kept);
+
+    // Every tile kept its own strongest max_features, so the strongest of
+    // the merged set are all present.
+    if (config_.max_features > 0 && picks.size() > static_cast<std::size_t>(config_.max_features)) {
+        std::nth_element(picks.begin(), picks.begin() + config_.max_features, picks.end(),
+                         [](const Pick& a, const Pick& b) { return a.kp->response > b.kp->response; });
+        picks.resize(static_cast<std::size_t>(config_.max_features));
+    }
+
+    out.keypoints.clear();
+    out.keypoints.reserve(picks.size());
+    const cv::Mat* reference = nullptr;
+    for (const Tile& tile : tiles_) {
+        if (!tile.features.descriptors.empty()) {
+            reference = &tile.features.descriptors;
+            break;
+        }
+    }
+    if (reference) {
+        out.descriptors.create(static_cast<int>(picks.size()), reference->cols, reference->type());
+    } else {
+        out.descriptors.release();
+    }
+    for (std::size_t i = 0; i < picks.size(); ++i) {
+        out.keypoints.push_back(*picks[i].kp);
+        if (reference) {
+            cv::Mat row = out.descriptors.row(static_cast<int>(i));
+            tiles_[picks[i].tile].features.descriptors.row(picks[i].row).copyTo(row);
+        }
+    }
+}
+
+void Detector::detect(const cv::Mat& image, Features& out) {
+    const cv::Mat* input = &image;
+    if (image.channels() != 1) {
+        cv::cvtColor(image, gray_, image.channels() == 4 ? cv::COLOR_BGRA2GRAY : cv::COLOR_BGR2GRAY);
+        input = &gray_;
+    }
+    if (config_.scale != 1.0) {
+        cv::resize(*input, scaled_, cv::Size(), config_.scale, config_.scale, cv::INTER_AREA);
+        input = &scaled_;
+    }
+
+    if (config_.tile > 0) {
+        detect_tiled(*input, out);
+    } else {
+        run(engine_, *input, out);
+    }
+
+    if (config_.scale != 1.0) {
+        // Pixel centres line up under INTER_AREA, hence the half-pixel shifts.
+        const auto inv = static_cast<float>(1.0 / config_.scale);
+        for (auto& kp : out.keypoints) {
+            kp.pt.x = (kp.pt.x + 0.5f) * inv - 0.5f;
+            kp.pt.y = (kp.pt.y + 0.5f) * inv - 0.5f;
+            kp.size *= inv;
+        }
+    }
+}
+
+}  // namespace detector
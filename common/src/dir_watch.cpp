@@ -0,0 +1,192 @@
+#include "common/dir_watch.hpp"
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <system_error>
+#include <utility>
+
+#include <poll.h>
+#include <time.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "common/frame_source.hpp"
+#include "common/log.hpp"
+
+namespace dir_watch {
+
+namespace fs = std::filesystem;
+
+std::optional<Feed> Feed::open(const fs::path& folder) {
+    std::error_code ec;
+    if (!fs::is_directory(folder, ec)) {
+        std::cerr << "[ERROR] " << folder << " is not a directory\n";
+        return std::nullopt;
+    }
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        std::cerr << "[ERROR] inotify_init1 failed: " << std::strerror(errno) << "\n";
+        return std::nullopt;
+    }
+    // Close-after-write and move-in, so half-written files are never read.
+    if (inotify_add_watch(fd, folder.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_ONLYDIR) < 0) {
+        std::cerr << "[ERROR] cannot watch " << folder << ": " << std::strerror(errno) << "\n";
+        ::close(fd);
+        return std::nullopt;
+    }
+    Feed feed(folder, fd);
+    // Taken once the watch is in place: a file written after this still
+    // has its close event to come. File times come from the coarse clock,
+    // so this does too; a write within the same tick is still listed.
+    timespec now{};
+    clock_gettime(CLOCK_REALTIME_COARSE, &now);
+    feed.watch_start_ = std::chrono::file_clock::from_sys(
+        std::chrono::system_clock::time_point(std::chrono::duration_cast<std::chrono::system_clock::duration>(
+            std::chrono::seconds(now.tv_sec) + std::chrono::nanoseconds(now.tv_nsec))));
+    feed.scan_.emplace(folder, fs::directory_options::skip_permission_denied, ec);
+    if (ec) {
+        std::cerr << "[ERROR] failed to list " << folder << ": " << ec.message() << "\n";
+        return std::nullopt;
+    }
+    return feed;
+}
+
+Feed::Feed(fs::path folder, int fd) : folder_(std::move(folder)), fd_(fd) {}
+
+Feed::~Feed() {
+    close();
+}
+
+Feed::Feed(Feed&& other) noexcept
+    : folder_(std::move(other.folder_)),
+      fd_(std::exchange(other.fd_, -1)),
+      scan_(std::move(other.scan_)),
+      watch_start_(other.watch_start_),
+      landed_during_scan_(std::move(other.landed_during_scan_)),
+      listed_by_scan_(std::move(other.listed_by_scan_)),
+      arrivals_(std::move(other.arrivals_)),
+      listed_(other.listed_),
+      landed_(other.landed_),
+      overflows_(other.overflows_) {}
+
+Feed& Feed::operator=(Feed&& other) noexcept {
+    if (this != &other) {
+        close();
+        folder_ = std::move(other.folder_);
+        fd_ = std::exchange(other.fd_, -1);
+        scan_ = std::move(other.scan_);
+        watch_start_ = other.watch_start_;
+        landed_during_scan_ = std::move(other.landed_during_scan_);
+        listed_by_scan_ = std::move(other.listed_by_scan_);
+        arrivals_ = std::move(other.arrivals_);
+        listed_ = other.listed_;
+        landed_ = other.landed_;
+        overflows_ = other.overflows_;
+    }
+    return *this;
+}
+
+void Feed::close() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+void Feed::read_events(std::chrono::milliseconds timeout) {
+    pollfd pfd{fd_, POLLIN, 0};
+    if (poll(&pfd, 1, static_cast<int>(timeout.count())) <= 0) {
+        return;
+    }
+    alignas(inotify_event) char buf[64 * 1024];
+    while (true) {
+        ssize_t n = read(fd_, buf, sizeof(buf));
+        if (n <= 0) {
+            if (n < 0 && errno != EAGAIN && errno != EINTR) {
+                logging::error("inotify read failed: ", std::strerror(errno));
+            }
+            return;
+        }
+        for (char* p = buf; p < buf + n;) {
+            const auto* event = reinterpret_cast<const inotify_event*>(p);
+            p += sizeof(inotify_event) + event->len;
+            if (event->mask & IN_Q_OVERFLOW) {
+                ++overflows_;
+                logging::warn("inotify queue overflowed in ", folder_.string(),
+                              "; files that landed meanwhile are skipped");
+                continue;
+            }
+            if (event->len == 0 || (event->mask & IN_ISDIR)) {
+                continue;
+            }
+            fs::path path = folder_ / event->name;
+            if (!frame_source::is_image(path)) {
+                continue;
+            }
+            if (scan_) {
+                // Closed after the listing already returned it.
+                if (listed_by_scan_.count(event->name) != 0) {
+                    continue;
+                }
+                landed_during_scan_.insert(event->name);
+            }
+            arrivals_.push_back(std::move(path));
+        }
+    }
+}
+
+void Feed::end_scan() {
+    scan_.reset();
+    landed_during_scan_.clear();
+    listed_by_scan_.clear();
+}
+
+std::optional<fs::path> Feed::next(std::chrono::milliseconds timeout) {
+    if (fd_ < 0) {
+        return std::nullopt;
+    }
+    // Drain without blocking while there is still a listing to fall back on.
+    read_events(scan_ ? std::chrono::milliseconds(0) : timeout);
+    if (!arrivals_.empty()) {
+        fs::path path = std::move(arrivals_.front());
+        arrivals_.pop_front();
+        ++landed_;
+        return path;
+    }
+    std::error_code ec;
+    while (scan_) {
+        auto& it = *scan_;
+        if (it == fs::directory_iterator()) {
+            end_scan();
+            break;
+        }
+        fs::directory_entry entry = *it;
+        it.increment(ec);
+        if (ec) {
+            logging::error("failed to list ", folder_.string(), ": ", ec.message());
+            end_scan();
+            break;
+        }
+        if (!entry.is_regular_file(ec) || !frame_source::is_image(entry.path())) {
+            continue;
+        }
+        std::string name = entry.path().filename().string();
+        if (landed_during_scan_.count(name) != 0) {
+            continue;
+        }
+        // Written since the watch started, and maybe still being written:
+        // its close event delivers it once it is complete.
+        const auto written = entry.last_write_time(ec);
+        if (ec || written > watch_start_) {
+            continue;
+        }
+        listed_by_scan_.insert(std::move(name));
+        ++listed_;
+        return entry.path();
+    }
+    return std::nullopt;
+}
+
+}  // namespace dir_watch
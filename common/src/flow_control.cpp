@@ -0,0 +1,302 @@
+#include "common/flow_control.hpp"
+
+#include <cerrno>
+#include <iostream>
+#include <limits>
+
+#include "common/log.hpp"
+
+namespace flow_control {
+namespace {
+
+// A grant is one little-endian u32: the number of credits it carries.
+constexpr std::size_t kGrantBytes = 4;
+// acquire() re-checks the probe timer at least this often while waiting.
+constexpr long kAcquirePollMs = 100;
+
+void* open_socket(void* context, int type, const std::string& endpoint, bool bind) {
+    void* socket = zmq_socket(context, type);
+    if (!socket) {
+        std::cerr << "[ERROR] zmq_socket(credit link) failed: " << zmq_strerror(errno) << "\n";
+        return nullptr;
+    }
+    // Unsent grants are meaningless once this stage exits.
+    int linger = 0;
+    zmq_setsockopt(socket, ZMQ_LINGER, &linger, sizeof(linger));
+    int rc = bind ? zmq_utils::bind_endpoint(socket, endpoint)
+                  : zmq_connect(socket, endpoint.c_str());
+    if (rc != 0) {
+        std::cerr << "[ERROR] Failed to " << (bind ? "bind" : "connect")
+                  << " credit link " << endpoint << ": " << zmq_strerror(errno) << "\n";
+        zmq_close(socket);
+        return nullptr;
+    }
+    return socket;
+}
+
+}  // namespace
+
+std::optional<Mode> parse_mode(std::string_view spec) {
+    if (spec == "none") {
+        return Mode::None;
+    }
+    if (spec == "credit") {
+        return Mode::Credit;
+    }
+    std::cerr << "[ERROR] Unknown flow control mode '" << spec
+              << "' (expected none or credit)\n";
+    return std::nullopt;
+}
+
+std::optional<Policy> parse_policy(std::string_view spec) {
+    if (spec == "block") {
+        return Policy::Block;
+    }
+    if (spec == "drop-newest") {
+        return Policy::DropNewest;
+    }
+    if (spec == "drop-oldest") {
+        return Policy::DropOldest;
+    }
+    std::cerr << "[ERROR] Unknown flow control policy '" << spec
+              << "' (expected block, drop-newest or drop-oldest)\n";
+    return std::nullopt;
+}
+
+std::string_view policy_name(Policy policy) {
+    switch (policy) {
+        case Policy::Block:
+            return "block";
+        case Policy::DropNewest:
+            return "drop-newest";
+        case Policy::DropOldest:
+            return "drop-oldest";
+    }
+    return "unknown";
+}
+
+void LinkCounters::report(std::ostream& out, std::string_view name) const {
+    out << "Link " << name
+        << ": sent=" << sent.load(std::memory_order_relaxed)
+        << " dropped_newest=" << dropped_newest.load(std::memory_order_relaxed)
+        << " dropped_would_block=" << dropped_would_block.load(std::memory_order_relaxed)
+        << " dropped_oldest=" << dropped_oldest.load(std::memory_order_relaxed)
+        << " would_block=" << would_block.load(std::memory_order_relaxed)
+        << " send_errors=" << send_errors.load(std::memory_order_relaxed)
+        << " blocked_ms=" << blocked_us.load(std::memory_order_relaxed) / 1000
+        << " credits=" << credits.load(std::memory_order_relaxed)
+        << " probes=" << probes.load(std::memory_order_relaxed) << "\n";
+}
+
+Reporter::Reporter(std::chrono::seconds interval)
+    : interval_(interval), next_report_(std::chrono::steady_clock::now() + interval) {}
+
+LinkCounters& Reporter::add(std::string name) {
+    entries_.push_back({std::move(name), std::make_unique<LinkCounters>()});
+    return *entries_.back().counters;
+}
+
+void Reporter::maybe_report(std::ostream& out) {
+    const auto now = std::chrono::steady_clock::now();
+    if (now < next_report_) {
+        return;
+    }
+    next_report_ = now + interval_;
+    report(out);
+}
+
+void Reporter::report(std::ostream& out) const {
+    for (const auto& entry : entries_) {
+        entry.counters->report(out, entry.name);
+    }
+}
+
+std::optional<CreditGate> CreditGate::open(
+    void* context,
+    const std::string& endpoint,
+    bool bind,
+    LinkCounters& counters
+) {
+    void* socket = open_socket(context, ZMQ_PULL, endpoint, bind);
+    if (!socket) {
+        return std::nullopt;
+    }
+    return CreditGate(socket, counters);
+}
+
+CreditGate::CreditGate(void* socket, LinkCounters& counters)
+    : socket_(socket), counters_(&counters), last_credit_(std::chrono::steady_clock::now()) {}
+
+CreditGate::~CreditGate() {
+    if (socket_) {
+        zmq_close(socket_);
+    }
+}
+
+CreditGate::CreditGate(CreditGate&& other) noexcept
+    : socket_(other.socket_),
+      counters_(other.counters_),
+      available_(other.available_),
+      last_credit_(other.last_credit_),
+      probe_interval_(other.probe_interval_) {
+    other.socket_ = nullptr;
+}
+
+CreditGate& CreditGate::operator=(CreditGate&& other) noexcept {
+    if (this != &other) {
+        if (socket_) {
+            zmq_close(socket_);
+        }
+        socket_ = std::exchange(other.socket_, nullptr);
+        counters_ = other.counters_;
+        available_ = other.available_;
+        last_credit_ = other.last_credit_;
+        probe_interval_ = other.probe_interval_;
+    }
+    return *this;
+}
+
+void CreditGate::collect(long timeout_ms) {
+    zmq_pollitem_t item{socket_, 0, ZMQ_POLLIN, 0};
+    if (zmq_poll(&item, 1, timeout_ms) <= 0) {
+        return;
+    }
+    while (auto msg = zmq_utils::recv_message(socket_, ZMQ_DONTWAIT, "zmq_msg_recv(credit)")) {
+        auto bytes = msg->bytes();
+        if (bytes.size() != kGrantBytes) {
+            logging::warn("Ignoring malformed credit grant (", bytes.size(), " bytes)");
+            continue;
+        }
+        const std::uint32_t n = static_cast<std::uint32_t>(bytes[0]) |
+                                static_cast<std::uint32_t>(bytes[1]) << 8 |
+                                static_cast<std::uint32_t>(bytes[2]) << 16 |
+                                static_cast<std::uint32_t>(bytes[3]) << 24;
+        available_ += n;
+        counters_->credits.fetch_add(n, std::memory_order_relaxed);
+        last_credit_ = std::chrono::steady_clock::now();
+    }
+}
+
+bool CreditGate::try_acquire() {
+    if (available_ == 0) {
+        collect(0);
+    }
+    if (available_ > 0) {
+        --available_;
+        return true;
+    }
+    auto now = std::chrono::steady_clock::now();
+    if (now - last_credit_ >= probe_interval_) {
+        last_credit_ = now;
+        counters_->probes.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+bool CreditGate::acquire(std::chrono::milliseconds timeout) {
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (!try_acquire()) {
+        long wait_ms = kAcquirePollMs;
+        if (timeout.count() >= 0) {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - std::chrono::steady_clock::now()).count();
+            if (left <= 0) {
+                return false;
+            }
+            wait_ms = std::min<long>(wait_ms, static_cast<long>(left));
+        }
+        collect(wait_ms);
+    }
+    return true;
+}
+
+std::optional<CreditGrant> CreditGrant::open(
+    void* context,
+    const std::string& endpoint,
+    bool bind,
+    std::uint32_t window
+) {
+    void* socket = open_socket(context, ZMQ_PUSH, endpoint, bind);
+    if (!socket) {
+        return std::nullopt;
+    }
+    CreditGrant grant(socket, std::max<std::uint32_t>(1, window));
+    grant.flush();
+    return grant;
+}
+
+CreditGrant::CreditGrant(void* socket, std::uint32_t window)
+    : socket_(socket), window_(window), granted_(window), pending_(window) {}
+
+CreditGrant::~CreditGrant() {
+    if (socket_) {
+        zmq_close(socket_);
+    }
+}
+
+CreditGrant::CreditGrant(CreditGrant&& other) noexcept
+    : socket_(other.socket_),
+      window_(other.window_),
+      received_(other.received_.load()),
+      consumed_(other.consumed_.load()),
+      granted_(other.granted_),
+      consumed_granted_(other.consumed_granted_),
+      pending_(other.pending_) {
+    other.socket_ = nullptr;
+}
+
+CreditGrant& CreditGrant::operator=(CreditGrant&& other) noexcept {
+    if (this != &other) {
+        if (socket_) {
+            zmq_close(socket_);
+        }
+        socket_ = std::exchange(other.socket_, nullptr);
+        window_ = other.window_;
+        received_ = other.received_.load();
+        consumed_ = other.consumed_.load();
+        granted_ = other.granted_;
+        consumed_granted_ = other.consumed_granted_;
+        pending_ = other.pending_;
+    }
+    return *this;
+}
+
+void CreditGrant::flush() {
+    const std::uint64_t received = received_.load(std::memory_order_relaxed);
+    const std::uint64_t consumed = consumed_.load(std::memory_order_relaxed);
+    if (received > granted_) {
+        // Upstream sent without credit, so it holds none: give it back what
+        // the window allows given the frames still in this stage.
+        const std::uint64_t target = consumed + window_;
+        pending_ = target > received ? target - received : 0;
+        granted_ = std::max(target, received);
+        consumed_granted_ = consumed;
+    } else {
+        const std::uint64_t owed = consumed - consumed_granted_;
+        if (owed >= std::max<std::uint32_t>(1, window_ / 4)) {
+            pending_ += owed;
+            granted_ += owed;
+            consumed_granted_ = consumed;
+        }
+    }
+
+    while (pending_ > 0) {
+        const auto n = static_cast<std::uint32_t>(
+            std::min<std::uint64_t>(pending_, std::numeric_limits<std::uint32_t>::max()));
+        const unsigned char grant[kGrantBytes] = {
+            static_cast<unsigned char>(n),
+            static_cast<unsigned char>(n >> 8),
+            static_cast<unsigned char>(n >> 16),
+            static_cast<unsigned char>(n >> 24)
+        };
+        // No upstream connected yet: keep the credits for the next flush.
+        if (zmq_utils::send_bytes(socket_, grant, ZMQ_DONTWAIT, "zmq_send(credit)") !=
+            zmq_utils::SendResult::Ok) {
+            return;
+        }
+        pending_ -= n;
+    }
+}
+
+}  // namespace flow_control
@@ -3,6 +3,24 @@
 
 #include <optional>
 #include <string>
+#include <utility>
+
+namespace {
+
+// Field names of the "t" object, in stage order.
+constexpr std::pair<const char*, std::uint64_t StageTimestamps::*> kStampFields[] = {
+    {"gen_read",   &StageTimestamps::gen_read},
+    {"gen_encode", &StageTimestamps::gen_encode},
+    {"gen_send",   &StageTimestamps::gen_send},
+    {"ext_recv",   &StageTimestamps::ext_recv},
+    {"ext_decode", &StageTimestamps::ext_decode},
+    {"ext_sift",   &StageTimestamps::ext_sift},
+    {"ext_send",   &StageTimestamps::ext_send},
+    {"log_recv",   &StageTimestamps::log_recv},
+    {"log_commit", &StageTimestamps::log_commit},
+};
+
+}  // namespace
 
 nlohmann::json FrameMetadata::to_json() const {
     nlohmann::json j;
@@ -13,10 +31,32 @@ nlohmann::json FrameMetadata::to_json() const {
     j["encoding"]        = encoding;
     j["data_bytes"]      = data_bytes;
     j["keypoint_count"]  = keypoint_count; 
+    j["stream_id"]       = stream_id;
+    if (!extractor_id.empty()) {
+        j["extractor_id"] = extractor_id;
+    }
+    if (!keypoint_format.empty()) {
+        j["keypoint_format"] = keypoint_format;
+    }
+    if (!detector.empty()) {
+        j["detector"] = detector;
+    }
+    if (flags != 0) {
+        j["flags"] = flags;
+    }
+    nlohmann::json stamps = nlohmann::json::object();
+    for (const auto& [name, field] : kStampFields) {
+        if (t.*field != 0) {
+            stamps[name] = t.*field;
+        }
+    }
+    if (!stamps.empty()) {
+        j["t"] = std::move(stamps);
+    }
     return j;
 }
 
-std::optional<FrameMetadata> FrameMetadata::from_json(const std::string& s) {
+std::optional<FrameMetadata> FrameMetadata::from_json(std::string_view s) {
     try {
         auto j = nlohmann::json::parse(s);
 
@@ -28,6 +68,16 @@ std::optional<FrameMetadata> FrameMetadata::from_json(const std::string& s) {
         meta.encoding       = j.value("encoding", std::string{});
         meta.data_bytes     = j.value("data_bytes", static_cast<std::size_t>(0));
         meta.keypoint_count = j.value("keypoint_count", 0);
+        meta.stream_id      = j.value("stream_id", std::uint64_t{0});
+        meta.extractor_id   = j.value("extractor_id", std::string{});
+        meta.keypoint_format = j.value("keypoint_format", std::string{});
+        meta.detector       = j.value("detector", std::string{});
+        meta.flags          = j.value("flags", std::uint32_t{0});
+        if (auto it = j.find("t"); it != j.end() && it->is_object()) {
+            for (const auto& [name, field] : kStampFields) {
+                meta.t.*field = it->value(name, std::uint64_t{0});
+            }
+        }
 
         return meta;
     } catch (const std::exception&) {
@@ -0,0 +1,175 @@
+#include "common/frame_header.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+namespace frame_header {
+namespace {
+
+constexpr unsigned char kMagic[4] = {'V', 'F', 'H', 'D'};
+constexpr std::size_t kPreambleBytes = 8;
+constexpr std::size_t kStampsOffset = 48;
+
+// In StageTimestamps declaration order, which is the wire order.
+constexpr std::uint64_t StageTimestamps::*kStampFields[] = {
+    &StageTimestamps::gen_read,
+    &StageTimestamps::gen_encode,
+    &StageTimestamps::gen_send,
+    &StageTimestamps::ext_recv,
+    &StageTimestamps::ext_decode,
+    &StageTimestamps::ext_sift,
+    &StageTimestamps::ext_send,
+    &StageTimestamps::log_recv,
+    &StageTimestamps::log_commit,
+};
+
+template <typename T>
+void put(unsigned char* out, T value) {
+    auto v = static_cast<std::uint64_t>(value);
+    for (std::size_t i = 0; i < sizeof(T); ++i) {
+        out[i] = static_cast<unsigned char>(v >> (8 * i));
+    }
+}
+
+template <typename T>
+T get(const unsigned char* in) {
+    std::uint64_t v = 0;
+    for (std::size_t i = 0; i < sizeof(T); ++i) {
+        v |= static_cast<std::uint64_t>(in[i]) << (8 * i);
+    }
+    return static_cast<T>(v);
+}
+
+}  // namespace
+
+std::optional<Format> parse_format(std::string_view spec) {
+    if (spec == "binary") {
+        return Format::Binary;
+    }
+    if (spec == "json") {
+        return Format::Json;
+    }
+    return std::nullopt;
+}
+
+bool is_header(std::span<const unsigned char> data) {
+    return data.size() >= sizeof(kMagic) && std::memcmp(data.data(), kMagic, sizeof(kMagic)) == 0;
+}
+
+void encode(const FrameMetadata& meta, std::vector<unsigned char>& out) {
+    const std::string_view strings[] = {
+        meta.image_name, meta.encoding, meta.extractor_id, meta.keypoint_format, meta.detector
+    };
+    std::size_t size = kFixedBytes + 2;
+    for (auto s : strings) {
+        size += 2 + std::min<std::size_t>(s.size(), 0xffff);
+    }
+    out.resize(size);
+    unsigned char* p = out.data();
+
+    std::memcpy(p, kMagic, sizeof(kMagic));
+    put<std::uint16_t>(p + 4, kVersion);
+    put<std::uint16_t>(p + 6, static_cast<std::uint16_t>(kFixedBytes));
+    put<std::int64_t>(p + 8, meta.seq_number);
+    put<std::uint64_t>(p + 16, meta.stream_id);
+    put<std::uint64_t>(p + 24, meta.data_bytes);
+    put<std::int32_t>(p + 32, meta.rows);
+    put<std::int32_t>(p + 36, meta.cols);
+    put<std::int32_t>(p + 40, meta.keypoint_count);
+    put<std::uint32_t>(p + 44, meta.flags);
+    std::size_t offset = kStampsOffset;
+    for (auto field : kStampFields) {
+        put<std::uint64_t>(p + offset, meta.t.*field);
+        offset += 8;
+    }
+
+    put<std::uint16_t>(p + offset, static_cast<std::uint16_t>(std::size(strings)));
+    offset += 2;
+    for (auto s : strings) {
+        const std::size_t n = std::min<std::size_t>(s.size(), 0xffff);
+        put<std::uint16_t>(p + offset, static_cast<std::uint16_t>(n));
+        std::memcpy(p + offset + 2, s.data(), n);
+        offset += 2 + n;
+    }
+}
+
+std::optional<View> View::parse(std::span<const unsigned char> data) {
+    if (data.size() < kPreambleBytes + 2 || !is_header(data) ||
+        get<std::uint16_t>(data.data() + 4) != kVersion) {
+        return std::nullopt;
+    }
+    View view(data);
+    view.fixed_bytes_ = get<std::uint16_t>(data.data() + 6);
+    if (view.fixed_bytes_ < kPreambleBytes || view.fixed_bytes_ + 2 > data.size()) {
+        return std::nullopt;
+    }
+    std::size_t offset = view.fixed_bytes_;
+    const std::size_t count = get<std::uint16_t>(data.data() + offset);
+    offset += 2;
+    for (std::size_t i = 0; i < count; ++i) {
+        if (offset + 2 > data.size()) {
+            return std::nullopt;
+        }
+        const std::size_t n = get<std::uint16_t>(data.data() + offset);
+        offset += 2;
+        if (offset + n > data.size()) {
+            return std::nullopt;
+        }
+        if (i < view.strings_.size()) {
+            view.strings_[i] = {reinterpret_cast<const char*>(data.data() + offset), n};
+        }
+        offset += n;
+    }
+    return view;
+}
+
+std::uint64_t View::u64(std::size_t offset) const {
+    return offset + 8 <= fixed_bytes_ ? get<std::uint64_t>(data_.data() + offset) : 0;
+}
+
+std::int32_t View::i32(std::size_t offset) const {
+    return offset + 4 <= fixed_bytes_ ? get<std::int32_t>(data_.data() + offset) : 0;
+}
+
+StageTimestamps View::stamps() const {
+    StageTimestamps t;
+    std::size_t offset = kStampsOffset;
+    for (auto field : kStampFields) {
+        t.*field = u64(offset);
+        offset += 8;
+    }
+    return t;
+}
+
+FrameMetadata View::to_metadata() const {
+    FrameMetadata meta;
+    meta.seq_number = static_cast<int>(seq_number());
+    meta.image_name = std::string(image_name());
+    meta.rows = rows();
+    meta.cols = cols();
+    meta.encoding = std::string(encoding());
+    meta.data_bytes = static_cast<std::size_t>(data_bytes());
+    meta.keypoint_count = keypoint_count();
+    meta.stream_id = stream_id();
+    meta.extractor_id = std::string(extractor_id());
+    meta.keypoint_format = std::string(keypoint_format());
+    meta.detector = std::string(detector());
+    meta.flags = flags();
+    meta.t = stamps();
+    return meta;
+}
+
+std::optional<FrameMetadata> decode(std::span<const unsigned char> data) {
+    if (is_header(data)) {
+        auto view = View::parse(data);
+        if (!view) {
+            return std::nullopt;
+        }
+        return view->to_metadata();
+    }
+    return FrameMetadata::from_json(
+        std::string_view(reinterpret_cast<const char*>(data.data()), data.size()));
+}
+
+}  // namespace frame_header
@@ -0,0 +1,140 @@
+#include "common/frame_schema.hpp"
+
+#include "common/sqlite_utils.hpp"
+
+namespace frame_schema {
+namespace {
+
+constexpr char kCreateFrames[] = "CREATE TABLE IF NOT EXISTS frames ("
+    "  id INTEGER PRIMARY KEY AUTOINCREMENT,"
+    "  seq_number INTEGER,"
+    "  image_name TEXT,"
+    "  rows INTEGER,"
+    "  cols INTEGER,"
+    "  keypoint_count INTEGER,"
+    "  meta_json TEXT,"
+    "  image_bytes BLOB,"
+    "  encoding TEXT,"
+    "  extractor_id TEXT,"
+    "  image_hash BLOB,"
+    "  segment_id INTEGER,"
+    "  blob_offset INTEGER,"
+    "  blob_length INTEGER,"
+    "  blob_checksum INTEGER,"
+    "  keypoint_format TEXT,"
+    "  keypoint_block BLOB,"
+    "  t_gen_read INTEGER,"
+    "  t_gen_encode INTEGER,"
+    "  t_gen_send INTEGER,"
+    "  t_ext_recv INTEGER,"
+    "  t_ext_decode INTEGER,"
+    "  t_ext_sift INTEGER,"
+    "  t_ext_send INTEGER,"
+    "  t_log_recv INTEGER,"
+    "  batch_id INTEGER,"
+    "  meta_header BLOB,"
+    "  detector TEXT,"
+    "  flags INTEGER"
+    ");";
+
+// Content-addressed payload store: `hash` is the 16-byte MurmurHash3
+// x64/128 of the payload, referenced by frames.image_hash. The payload is
+// either in image_bytes or in the blob log at the segment_id/blob_* columns.
+constexpr char kCreateImages[] = "CREATE TABLE IF NOT EXISTS images ("
+    "  hash BLOB PRIMARY KEY,"
+    "  encoding TEXT,"
+    "  byte_size INTEGER,"
+    "  image_bytes BLOB,"
+    "  segment_id INTEGER,"
+    "  blob_offset INTEGER,"
+    "  blob_length INTEGER,"
+    "  blob_checksum INTEGER"
+    ");";
+
+// One row per committed writer batch. committed_ns is the log_commit
+// stamp of every frame with that batch_id.
+constexpr char kCreateBatches[] = "CREATE TABLE IF NOT EXISTS batches ("
+    "  id INTEGER PRIMARY KEY,"
+    "  committed_ns INTEGER,"
+    "  frame_count INTEGER"
+    ");";
+
+}  // namespace
+
+const char* const kInsertFrame =
+    "INSERT INTO frames ("
+    "  seq_number, image_name, rows, cols, keypoint_count, meta_json, image_bytes,"
+    "  encoding, extractor_id, image_hash,"
+    "  segment_id, blob_offset, blob_length, blob_checksum,"
+    "  keypoint_format, keypoint_block,"
+    "  t_gen_read, t_gen_encode, t_gen_send, t_ext_recv, t_ext_decode, t_ext_sift,"
+    "  t_ext_send, t_log_recv, batch_id, meta_header, detector, flags"
+    ") VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?,"
+    "  ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?);";
+
+const char* const kFindImage = "SELECT 1 FROM images WHERE hash = ?;";
+
+const char* const kInsertImage =
+    "INSERT INTO images ("
+    "  hash, encoding, byte_size, image_bytes,"
+    "  segment_id, blob_offset, blob_length, blob_checksum"
+    ") VALUES (?, ?, ?, ?, ?, ?, ?, ?);";
+
+const char* const kInsertBatch =
+    "INSERT INTO batches (id, committed_ns, frame_count) VALUES (?, ?, ?);";
+
+const char* const kMaxBatchId =
+    "SELECT MAX(COALESCE((SELECT MAX(batch_id) FROM frames), 0),"
+    "           COALESCE((SELECT MAX(id) FROM batches), 0));";
+
+bool create(sqlite3* db) {
+    if (!sqlite_utils::exec(db, kCreateFrames, "create frames table") ||
+        !sqlite_utils::exec(db, kCreateImages, "create images table") ||
+        !sqlite_utils::exec(db, kCreateBatches, "create batches table")) {
+        return false;
+    }
+    if (!sqlite_utils::ensure_column(db, "frames", "encoding", "TEXT") ||
+        !sqlite_utils::ensure_column(db, "frames", "extractor_id", "TEXT") ||
+        !sqlite_utils::ensure_column(db, "frames", "image_hash", "BLOB")) {
+        return false;
+    }
+    // keypoint_block holds the extractor's packed keypoints/descriptors; read
+    // it back with keypoint_block::decode(). keypoint_format names its layout.
+    if (!sqlite_utils::ensure_column(db, "frames", "keypoint_format", "TEXT") ||
+        !sqlite_utils::ensure_column(db, "frames", "keypoint_block", "BLOB")) {
+        return false;
+    }
+    // Stage timestamps (CLOCK_MONOTONIC ns, see StageTimestamps); NULL when a
+    // stage did not stamp the frame.
+    for (const char* column : {"t_gen_read", "t_gen_encode", "t_gen_send", "t_ext_recv",
+                               "t_ext_decode", "t_ext_sift", "t_ext_send", "t_log_recv",
+                               "batch_id"}) {
+        if (!sqlite_utils::ensure_column(db, "frames", column, "INTEGER")) {
+            return false;
+        }
+    }
+    // The binary frame header as received (frame_header::View reads it);
+    // meta_json is only set for frames that arrived with JSON metadata.
+    if (!sqlite_utils::ensure_column(db, "frames", "meta_header", "BLOB")) {
+        return false;
+    }
+    // detector::describe() of the tier that produced the keypoints.
+    if (!sqlite_utils::ensure_column(db, "frames", "detector", "TEXT")) {
+        return false;
+    }
+    // FrameMetadata::flags; shed frames (kFlagShed) are stored without a
+    // payload or keypoints.
+    if (!sqlite_utils::ensure_column(db, "frames", "flags", "INTEGER")) {
+        return false;
+    }
+    for (const char* table : {"frames", "images"}) {
+        for (const char* column : {"segment_id", "blob_offset", "blob_length", "blob_checksum"}) {
+            if (!sqlite_utils::ensure_column(db, table, column, "INTEGER")) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+}  // namespace frame_schema
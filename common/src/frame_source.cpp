@@ -0,0 +1,57 @@
+#include "common/frame_source.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <iostream>
+#include <string>
+#include <system_error>
+
+#include <opencv2/imgcodecs.hpp>
+
+namespace frame_source {
+
+namespace fs = std::filesystem;
+
+bool is_image(const fs::path& path) {
+    auto ext = path.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return ext == ".png" || ext == ".jpg" || ext == ".jpeg" || ext == ".bmp";
+}
+
+std::optional<std::vector<fs::path>> list_images(const fs::path& folder) {
+    std::error_code ec;
+    if (!fs::is_directory(folder, ec)) {
+        std::cerr << "[ERROR] " << folder << " is not a directory\n";
+        return std::nullopt;
+    }
+    std::vector<fs::path> images;
+    for (const auto& entry : fs::directory_iterator(folder, ec)) {
+        if (entry.is_regular_file() && is_image(entry.path())) {
+            images.push_back(entry.path());
+        }
+    }
+    if (ec) {
+        std::cerr << "[ERROR] failed to list " << folder << ": " << ec.message() << "\n";
+        return std::nullopt;
+    }
+    return images;
+}
+
+std::vector<Entry> synthetic_entries(const synthetic::Spec& spec, std::uint64_t count) {
+    std::vector<Entry> entries;
+    entries.reserve(count);
+    for (std::uint64_t i = 0; i < count; ++i) {
+        entries.push_back({synthetic::frame_name(spec, i), i});
+    }
+    return entries;
+}
+
+cv::Mat load(const Entry& entry, const synthetic::Spec& spec) {
+    if (entry.synthetic_index) {
+        return synthetic::render(spec, *entry.synthetic_index);
+    }
+    return cv::imread(entry.path.string(), cv::IMREAD_COLOR);
+}
+
+}  // namespace frame_source
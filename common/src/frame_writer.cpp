@@ -0,0 +1,485 @@
+#include "common/frame_writer.hpp"
+
+#include <algorithm>
+
+#include "common/frame_header.hpp"
+#include "common/frame_schema.hpp"
+#include "common/log.hpp"
+
+namespace frame_writer {
+namespace {
+
+constexpr std::uint64_t kLoadReportEvery = 100;
+
+// Binds the four blob reference columns starting at `idx`, or NULLs when the
+// payload lives inline.
+int bind_ref(sqlite3_stmt* stmt, int idx, const std::optional<blob_log::BlobRef>& ref) {
+    if (!ref) {
+        for (int i = 0; i < 4; ++i) {
+            sqlite3_bind_null(stmt, idx++);
+        }
+        return idx;
+    }
+    sqlite3_bind_int64(stmt, idx++, ref->segment_id);
+    sqlite3_bind_int64(stmt, idx++, static_cast<sqlite3_int64>(ref->offset));
+    sqlite3_bind_int64(stmt, idx++, ref->length);
+    sqlite3_bind_int64(stmt, idx++, ref->checksum);
+    return idx;
+}
+
+}  // namespace
+
+std::optional<Database> open_database(const std::string& path, Options& options) {
+    auto db_opt = sqlite_utils::open(path);
+    if (!db_opt) {
+        return std::nullopt;
+    }
+    sqlite_utils::DbPtr db = std::move(*db_opt);
+
+    // WAL lets a commit append to the log instead of rewriting pages through
+    // the rollback journal; NORMAL syncs only at checkpoints.
+    if (!sqlite_utils::exec(db.get(), "PRAGMA journal_mode=WAL;", "enable WAL") ||
+        !sqlite_utils::exec(db.get(), "PRAGMA synchronous=NORMAL;", "set synchronous")) {
+        return std::nullopt;
+    }
+
+    if (!frame_schema::create(db.get())) {
+        return std::nullopt;
+    }
+
+    auto insert_stmt = sqlite_utils::prepare(db.get(), frame_schema::kInsertFrame, "prepare insert");
+    auto find_image = sqlite_utils::prepare(db.get(), frame_schema::kFindImage, "prepare image lookup");
+    auto insert_image = sqlite_utils::prepare(db.get(), frame_schema::kInsertImage, "prepare image insert");
+    auto insert_batch = sqlite_utils::prepare(db.get(), frame_schema::kInsertBatch, "prepare batch insert");
+    if (!insert_stmt || !find_image || !insert_image || !insert_batch) {
+        return std::nullopt;
+    }
+
+    // Batch ids keep counting across runs. Rows of a batch that was rolled
+    // back or never reached `batches` leave a gap, which is harmless.
+    {
+        auto max_batch = sqlite_utils::prepare(
+            db.get(), frame_schema::kMaxBatchId, "prepare batch id");
+        if (!max_batch) {
+            return std::nullopt;
+        }
+        if (sqlite3_step(max_batch->get()) == SQLITE_ROW) {
+            options.first_batch_id = sqlite3_column_int64(max_batch->get(), 0) + 1;
+        }
+    }
+
+    return Database{
+        std::move(db),
+        Statements{
+            std::move(*insert_stmt),
+            std::move(*find_image),
+            std::move(*insert_image),
+            std::move(*insert_batch)
+        }
+    };
+}
+
+Writer::Writer(sqlite3* db, Statements statements, Options options,
+               std::optional<blob_log::Writer> blobs)
+    : db_(db),
+      statements_(std::move(statements)),
+      insert_stmt_(statements_.insert_frame.get()),
+      options_(options),
+      known_images_(options.dedup_cache_entries),
+      blobs_(std::move(blobs)),
+      next_batch_id_(options.first_batch_id),
+      latencies_(options.latency_interval),
+      wire_in_latency_(latencies_.add("log.wire_in")),
+      commit_latency_(latencies_.add("log.recv_to_commit")),
+      frame_age_latency_(latencies_.add("frame_age")),
+      next_report_(Clock::now() + options.stats_interval) {
+    if (options_.metrics) {
+        metrics::Registry& registry = *options_.metrics;
+        metrics_.emplace(Metrics{registry.counter("frames_out"), registry.counter("bytes_out"),
+                                 registry.counter("drops.rolled_back"),
+                                 registry.counter("drops.insert_failed"),
+                                 registry.timer("sqlite_commit")});
+    }
+}
+
+void Writer::run(BoundedQueue<Record>& queue) {
+    while (true) {
+        auto record = queue.pop_until(next_deadline());
+        if (record) {
+            add(*record);
+        } else if (queue.closed()) {
+            break;
+        }
+        tick();
+    }
+    finish();
+}
+
+void Writer::add(const Record& record) {
+    if (!batch_open_) {
+        // Without a transaction the row would autocommit on its own, before
+        // the blob log is synced and outside any batch; drop it instead.
+        if (!begin()) {
+            ++stats_.failed_frames;
+            if (metrics_) {
+                metrics_->insert_failed.add();
+            }
+            return;
+        }
+        batch_open_ = true;
+        batch_started_ = Clock::now();
+    }
+    if (insert(record)) {
+        ++batch_frames_;
+        batch_bytes_ += record.payload().size();
+    } else if (metrics_) {
+        metrics_->insert_failed.add();
+    }
+}
+
+Writer::Clock::time_point Writer::next_deadline() const {
+    return batch_open_ ? batch_started_ + options_.batch_time : next_report_;
+}
+
+void Writer::tick() {
+    const auto now = Clock::now();
+    if (batch_open_ && (batch_frames_ >= options_.batch_frames ||
+                        now - batch_started_ >= options_.batch_time)) {
+        commit();
+    }
+    if (now >= next_report_) {
+        report_stats();
+        next_report_ = now + options_.stats_interval;
+    }
+    latencies_.maybe_report(report_out_);
+}
+
+void Writer::finish() {
+    if (batch_open_) {
+        commit();
+    }
+    // No batch follows to carry the last `batches` rows; write them on
+    // their own.
+    if (!pending_batches_.empty()) {
+        write_batches();
+        pending_batches_.clear();
+    }
+    report_stats();
+    latencies_.report(report_out_);
+}
+
+bool Writer::begin() {
+    if (!sqlite_utils::exec(db_, "BEGIN;", "begin batch")) {
+        return false;
+    }
+    batches_written_ = write_batches();
+    return true;
+}
+
+// Inserts the `batches` rows of earlier commits; returns how many were
+// written. They ride in the open transaction when there is one.
+std::size_t Writer::write_batches() {
+    sqlite3_stmt* insert = statements_.insert_batch.get();
+    std::size_t written = 0;
+    for (const PendingBatch& batch : pending_batches_) {
+        sqlite_utils::reset(insert);
+        sqlite3_bind_int64(insert, 1, batch.id);
+        sqlite3_bind_int64(insert, 2, static_cast<sqlite3_int64>(batch.committed_ns));
+        sqlite3_bind_int64(insert, 3, static_cast<sqlite3_int64>(batch.frames));
+        if (!sqlite_utils::step(insert, "sqlite3_step(insert batch)")) {
+            break;
+        }
+        ++written;
+    }
+    return written;
+}
+
+// Appends the payload to the blob log. `ok` is false when the append
+// failed; without a blob log it returns std::nullopt and leaves `ok` set.
+std::optional<blob_log::BlobRef> Writer::append_blob(const Record& record, bool& ok) {
+    ok = true;
+    if (!blobs_) {
+        return std::nullopt;
+    }
+    std::span<const unsigned char> buf = record.payload();
+    auto ref = blobs_->append(buf, static_cast<std::uint32_t>(record.image_hash.lo));
+    if (!ref) {
+        ok = false;
+        return std::nullopt;
+    }
+    stats_.blob_bytes_written += buf.size();
+    return ref;
+}
+
+// Makes sure the payload of `record` is present in `images`. The LRU of
+// recently seen hashes answers most lookups on looping replays without
+// touching SQLite.
+bool Writer::store_image(const Record& record, const unsigned char hash[16]) {
+    if (known_images_.get(record.image_hash)) {
+        ++stats_.image_cache_hits;
+        return true;
+    }
+    sqlite3_stmt* find = statements_.find_image.get();
+    sqlite_utils::reset(find);
+    sqlite3_bind_blob(find, 1, hash, 16, SQLITE_STATIC);
+    bool exists = sqlite3_step(find) == SQLITE_ROW;
+    sqlite_utils::reset(find);
+
+    if (!exists) {
+        std::span<const unsigned char> buf = record.payload();
+        bool appended = true;
+        auto ref = append_blob(record, appended);
+        if (!appended) {
+            return false;
+        }
+        sqlite3_stmt* insert = statements_.insert_image.get();
+        sqlite_utils::reset(insert);
+        sqlite_utils::ResetOnExit unbind(insert);
+        int idx = 1;
+        sqlite3_bind_blob(insert, idx++, hash, 16, SQLITE_STATIC);
+        sqlite3_bind_text(insert, idx++, record.meta.encoding.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_int64(insert, idx++, static_cast<sqlite3_int64>(buf.size()));
+        if (ref) {
+            sqlite3_bind_null(insert, idx++);
+        } else {
+            sqlite3_bind_blob(insert, idx++, buf.data(),
+                              static_cast<int>(buf.size()), SQLITE_STATIC);
+        }
+        bind_ref(insert, idx, ref);
+        if (!sqlite_utils::step(insert, "sqlite3_step(insert image)")) {
+            return false;
+        }
+        ++stats_.images_written;
+        stats_.image_bytes_written += buf.size();
+    } else {
+        ++stats_.image_db_hits;
+    }
+    known_images_.put(record.image_hash, true);
+    return true;
+}
+
+// A shared-memory payload is read in place by the hash (on the receive
+// thread), the blob append and the steps, and the generator may reclaim
+// and rewrite the slot meanwhile (--shm-reclaim-ms). Its rows go in under a
+// savepoint that is rolled back unless the slot is still ours once the
+// frame's step has copied the bytes; a reclaim after that check can no
+// longer reach the row. Bytes already appended to the blob log stay in the
+// segment, unreferenced.
+bool Writer::insert(const Record& record) {
+    if (!record.lease) {
+        return insert_row(record);
+    }
+    if (!record.lease->valid()) {
+        logging::error("Shared-memory slot for seq=", record.meta.seq_number,
+                       " was reclaimed before it was stored, dropping it");
+        return false;
+    }
+    if (!sqlite_utils::exec(db_, "SAVEPOINT shm_frame;", "savepoint frame")) {
+        return false;
+    }
+    const bool inserted = insert_row(record);
+    if (inserted && record.lease->valid()) {
+        return sqlite_utils::exec(db_, "RELEASE shm_frame;", "release frame");
+    }
+    if (inserted) {
+        logging::error("Shared-memory slot for seq=", record.meta.seq_number,
+                       " was reclaimed while it was stored, dropping it");
+    }
+    sqlite_utils::exec(db_, "ROLLBACK TO shm_frame; RELEASE shm_frame;", "roll back frame");
+    // The `images` row may have gone with it.
+    known_images_.erase(record.image_hash);
+    return false;
+}
+
+bool Writer::insert_row(const Record& record) {
+    const FrameMetadata& meta = record.meta;
+    std::span<const unsigned char> buf = record.payload();
+    unsigned char hash[16];
+    record.image_hash.to_bytes(hash);
+    // Shed frames arrive without a payload; only their metadata is stored.
+    const bool has_payload = (meta.flags & kFlagShed) == 0;
+    const bool dedup = options_.dedup_images && has_payload;
+    if (dedup && !store_image(record, hash)) {
+        return false;
+    }
+    // In dedup mode the payload is referenced through `images` instead.
+    std::optional<blob_log::BlobRef> ref;
+    if (has_payload && !options_.dedup_images) {
+        bool appended = true;
+        ref = append_blob(record, appended);
+        if (!appended) {
+            return false;
+        }
+    }
+
+    // Everything is bound SQLITE_STATIC: the record outlives the step, and
+    // SQLite reads the payload, keypoints and strings where they are
+    // instead of copying each one per frame.
+    sqlite_utils::reset(insert_stmt_);
+    sqlite_utils::ResetOnExit unbind(insert_stmt_);
+    int idx = 1;
+
+    sqlite3_bind_int(insert_stmt_, idx++, meta.seq_number);
+    sqlite3_bind_text(insert_stmt_, idx++,  meta.image_name.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int(insert_stmt_,   idx++, meta.rows);
+    sqlite3_bind_int(insert_stmt_,   idx++, meta.cols);
+    sqlite3_bind_int(insert_stmt_,   idx++, meta.keypoint_count);
+    // Binary headers go to meta_header as received; meta_json is only
+    // filled for peers that still send JSON metadata.
+    std::span<const unsigned char> meta_bytes = record.meta_bytes();
+    const bool binary_meta = frame_header::is_header(meta_bytes);
+    if (binary_meta) {
+        sqlite3_bind_null(insert_stmt_, idx++);
+    } else {
+        sqlite3_bind_text(insert_stmt_,  idx++, reinterpret_cast<const char*>(meta_bytes.data()),
+                          static_cast<int>(meta_bytes.size()), SQLITE_STATIC);
+    }
+    if (!has_payload || options_.dedup_images || ref) {
+        sqlite3_bind_null(insert_stmt_, idx++);
+    } else {
+        sqlite3_bind_blob(insert_stmt_,  idx++, buf.data(),
+                          static_cast<int>(buf.size()), SQLITE_STATIC);
+    }
+    sqlite3_bind_text(insert_stmt_,  idx++, meta.encoding.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(insert_stmt_,  idx++, meta.extractor_id.c_str(), -1, SQLITE_STATIC);
+    if (dedup) {
+        sqlite3_bind_blob(insert_stmt_, idx++, hash, 16, SQLITE_STATIC);
+    } else {
+        sqlite3_bind_null(insert_stmt_, idx++);
+    }
+    idx = bind_ref(insert_stmt_, idx, ref);
+    std::span<const unsigned char> keypoints = record.keypoint_bytes();
+    if (!keypoints.empty()) {
+        sqlite3_bind_text(insert_stmt_, idx++, meta.keypoint_format.c_str(), -1,
+                          SQLITE_STATIC);
+        sqlite3_bind_blob(insert_stmt_, idx++, keypoints.data(),
+                          static_cast<int>(keypoints.size()), SQLITE_STATIC);
+    } else {
+        sqlite3_bind_null(insert_stmt_, idx++);
+        sqlite3_bind_null(insert_stmt_, idx++);
+    }
+    for (std::uint64_t stamp : {meta.t.gen_read, meta.t.gen_encode, meta.t.gen_send,
+                                meta.t.ext_recv, meta.t.ext_decode, meta.t.ext_sift,
+                                meta.t.ext_send, meta.t.log_recv}) {
+        if (stamp != 0) {
+            sqlite3_bind_int64(insert_stmt_, idx++, static_cast<sqlite3_int64>(stamp));
+        } else {
+            sqlite3_bind_null(insert_stmt_, idx++);
+        }
+    }
+    sqlite3_bind_int64(insert_stmt_, idx++, next_batch_id_);
+    if (binary_meta) {
+        sqlite3_bind_blob(insert_stmt_, idx++, meta_bytes.data(),
+                          static_cast<int>(meta_bytes.size()), SQLITE_STATIC);
+    } else {
+        sqlite3_bind_null(insert_stmt_, idx++);
+    }
+    if (!meta.detector.empty()) {
+        sqlite3_bind_text(insert_stmt_, idx++, meta.detector.c_str(), -1, SQLITE_STATIC);
+    } else {
+        sqlite3_bind_null(insert_stmt_, idx++);
+    }
+    sqlite3_bind_int64(insert_stmt_, idx++, meta.flags);
+
+    if (!sqlite_utils::step(insert_stmt_, "sqlite3_step(insert frame)")) {
+        return false;
+    }
+
+    logging::debug("Inserted frame seq=", meta.seq_number, " with ", meta.keypoint_count,
+                   " keypoints into database.");
+    batch_stamps_.push_back(meta.t);
+
+    ++frames_per_extractor_[meta.extractor_id];
+    if (++stored_frames_ % kLoadReportEvery == 0) {
+        report_out_ << "Load balance after " << stored_frames_ << " frames:";
+        for (const auto& [id, count] : frames_per_extractor_) {
+            report_out_ << " " << (id.empty() ? "<unknown>" : id) << "=" << count;
+        }
+        report_out_ << "\n";
+    }
+    return true;
+}
+
+void Writer::commit() {
+    auto start = std::chrono::steady_clock::now();
+    bool ok = (!blobs_ || blobs_->sync()) &&
+              sqlite_utils::exec(db_, "COMMIT;", "commit batch");
+    if (!ok) {
+        sqlite_utils::exec(db_, "ROLLBACK;", "rollback batch");
+        // Images inserted by this batch are gone again.
+        known_images_.clear();
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    double ms = std::chrono::duration<double, std::milli>(elapsed).count();
+    batch_open_ = false;
+    if (ok) {
+        pending_batches_.erase(pending_batches_.begin(),
+                               pending_batches_.begin() + static_cast<std::ptrdiff_t>(batches_written_));
+        record_commit(latency::now_ns());
+    }
+    // After a rollback the pending rows are written again with the next batch.
+    batches_written_ = 0;
+    batch_stamps_.clear();
+
+    ++stats_.batches;
+    stats_.frames += batch_frames_;
+    stats_.max_batch = std::max(stats_.max_batch, batch_frames_);
+    stats_.commit_ms_total += ms;
+    stats_.commit_ms_max = std::max(stats_.commit_ms_max, ms);
+    if (!ok) {
+        stats_.failed_frames += batch_frames_;
+    }
+    if (metrics_) {
+        metrics_->commit.record(static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+        if (ok) {
+            metrics_->frames_out.add(batch_frames_);
+            metrics_->bytes_out.add(batch_bytes_);
+        } else {
+            metrics_->rolled_back.add(batch_frames_);
+        }
+    }
+    batch_frames_ = 0;
+    batch_bytes_ = 0;
+}
+
+// The commit stamp is only known once COMMIT returned, so it goes to one
+// `batches` row per batch instead of into each frame row. The row is
+// written in the next batch's transaction rather than in a second commit
+// of its own, so `batches` lags `frames` by one batch until then.
+void Writer::record_commit(std::uint64_t commit_ns) {
+    pending_batches_.push_back({next_batch_id_, commit_ns, batch_stamps_.size()});
+    ++next_batch_id_;
+
+    for (const StageTimestamps& t : batch_stamps_) {
+        wire_in_latency_.record_between(t.ext_send, t.log_recv);
+        commit_latency_.record_between(t.log_recv, commit_ns);
+        frame_age_latency_.record_between(t.gen_read, commit_ns);
+    }
+}
+
+void Writer::report_stats() {
+    if (stats_.batches == 0 && stats_.failed_frames == 0) {
+        return;
+    }
+    const std::uint64_t batches = std::max<std::uint64_t>(1, stats_.batches);
+    report_out_ << "Writer: " << stats_.frames << " frame(s) in " << stats_.batches
+                << " batch(es), avg batch " << stats_.frames / batches
+                << ", max batch " << stats_.max_batch
+                << ", avg commit " << stats_.commit_ms_total / static_cast<double>(batches) << " ms"
+                << ", max commit " << stats_.commit_ms_max << " ms"
+                << ", failed " << stats_.failed_frames << "\n";
+    if (options_.dedup_images) {
+        report_out_ << "Image store: " << stats_.images_written << " new image(s), "
+                    << (stats_.image_bytes_written >> 10) << " KiB written, "
+                    << stats_.image_cache_hits << " cache hit(s), "
+                    << stats_.image_db_hits << " database hit(s)\n";
+    }
+    if (blobs_) {
+        report_out_ << "Blob log: " << (stats_.blob_bytes_written >> 10)
+                    << " KiB appended\n";
+    }
+    stats_ = {};
+}
+
+}  // namespace frame_writer
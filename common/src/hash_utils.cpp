@@ -0,0 +1,106 @@
+#include "common/hash_utils.hpp"
+
+#include <cstring>
+
+namespace hash_utils {
+namespace {
+
+inline std::uint64_t rotl64(std::uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+inline std::uint64_t fmix64(std::uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdull;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ull;
+    k ^= k >> 33;
+    return k;
+}
+
+inline std::uint64_t load_u64(const unsigned char* p) {
+    std::uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+}  // namespace
+
+void Hash128::to_bytes(unsigned char out[16]) const {
+    for (int i = 0; i < 8; ++i) {
+        out[i] = static_cast<unsigned char>(lo >> (8 * i));
+        out[8 + i] = static_cast<unsigned char>(hi >> (8 * i));
+    }
+}
+
+std::string Hash128::hex() const {
+    static constexpr char kDigits[] = "0123456789abcdef";
+    unsigned char bytes[16];
+    to_bytes(bytes);
+    std::string out(32, '0');
+    for (int i = 0; i < 16; ++i) {
+        out[2 * i] = kDigits[bytes[i] >> 4];
+        out[2 * i + 1] = kDigits[bytes[i] & 0x0f];
+    }
+    return out;
+}
+
+Hash128 hash128(std::span<const unsigned char> data, std::uint64_t seed) {
+    const unsigned char* bytes = data.data();
+    const std::size_t len = data.size();
+    const std::size_t nblocks = len / 16;
+
+    std::uint64_t h1 = seed;
+    std::uint64_t h2 = seed;
+    constexpr std::uint64_t c1 = 0x87c37b91114253d5ull;
+    constexpr std::uint64_t c2 = 0x4cf5ad432745937full;
+
+    for (std::size_t i = 0; i < nblocks; ++i) {
+        std::uint64_t k1 = load_u64(bytes + i * 16);
+        std::uint64_t k2 = load_u64(bytes + i * 16 + 8);
+
+        k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+        h1 = rotl64(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+
+        k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+        h2 = rotl64(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+    }
+
+    const unsigned char* tail = bytes + nblocks * 16;
+    std::uint64_t k1 = 0;
+    std::uint64_t k2 = 0;
+    switch (len & 15) {
+        case 15: k2 ^= std::uint64_t{tail[14]} << 48; [[fallthrough]];
+        case 14: k2 ^= std::uint64_t{tail[13]} << 40; [[fallthrough]];
+        case 13: k2 ^= std::uint64_t{tail[12]} << 32; [[fallthrough]];
+        case 12: k2 ^= std::uint64_t{tail[11]} << 24; [[fallthrough]];
+        case 11: k2 ^= std::uint64_t{tail[10]} << 16; [[fallthrough]];
+        case 10: k2 ^= std::uint64_t{tail[9]} << 8;   [[fallthrough]];
+        case 9:  k2 ^= std::uint64_t{tail[8]};
+                 k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+                 [[fallthrough]];
+        case 8:  k1 ^= std::uint64_t{tail[7]} << 56; [[fallthrough]];
+        case 7:  k1 ^= std::uint64_t{tail[6]} << 48; [[fallthrough]];
+        case 6:  k1 ^= std::uint64_t{tail[5]} << 40; [[fallthrough]];
+        case 5:  k1 ^= std::uint64_t{tail[4]} << 32; [[fallthrough]];
+        case 4:  k1 ^= std::uint64_t{tail[3]} << 24; [[fallthrough]];
+        case 3:  k1 ^= std::uint64_t{tail[2]} << 16; [[fallthrough]];
+        case 2:  k1 ^= std::uint64_t{tail[1]} << 8;  [[fallthrough]];
+        case 1:  k1 ^= std::uint64_t{tail[0]};
+                 k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+                 break;
+        default: break;
+    }
+
+    h1 ^= len;
+    h2 ^= len;
+    h1 += h2;
+    h2 += h1;
+    h1 = fmix64(h1);
+    h2 = fmix64(h2);
+    h1 += h2;
+    h2 += h1;
+    return {h1, h2};
+}
+
+}  // namespace hash_utils
@@ -0,0 +1,195 @@
+#include "common/keypoint_block.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+
+namespace keypoint_block {
+namespace {
+
+constexpr unsigned char kMagic[4] = {'V', 'K', 'P', 'B'};
+constexpr std::size_t kHeaderBytes = 16;
+constexpr std::size_t kRecordBytes = 24;
+// Far above any real descriptor; bounds the size arithmetic in decode().
+constexpr std::uint32_t kMaxDescriptorLength = 1 << 16;
+
+void put_u32(unsigned char* p, std::uint32_t v) {
+    p[0] = static_cast<unsigned char>(v);
+    p[1] = static_cast<unsigned char>(v >> 8);
+    p[2] = static_cast<unsigned char>(v >> 16);
+    p[3] = static_cast<unsigned char>(v >> 24);
+}
+
+std::uint32_t get_u32(const unsigned char* p) {
+    return std::uint32_t{p[0]} | (std::uint32_t{p[1]} << 8) |
+           (std::uint32_t{p[2]} << 16) | (std::uint32_t{p[3]} << 24);
+}
+
+void put_f32(unsigned char* p, float v) {
+    put_u32(p, std::bit_cast<std::uint32_t>(v));
+}
+
+float get_f32(const unsigned char* p) {
+    return std::bit_cast<float>(get_u32(p));
+}
+
+std::size_t descriptor_bytes(DescriptorFormat format) {
+    switch (format) {
+        case DescriptorFormat::Float32: return 4;
+        case DescriptorFormat::Uint8:   return 1;
+        case DescriptorFormat::None:    break;
+    }
+    return 0;
+}
+
+unsigned char quantize(float v) {
+    return static_cast<unsigned char>(std::clamp(std::lround(v), 0L, 255L));
+}
+
+}  // namespace
+
+std::optional<DescriptorFormat> parse_descriptor_format(std::string_view spec) {
+    if (spec == "none") {
+        return DescriptorFormat::None;
+    }
+    if (spec == "f32") {
+        return DescriptorFormat::Float32;
+    }
+    if (spec == "u8") {
+        return DescriptorFormat::Uint8;
+    }
+    return std::nullopt;
+}
+
+std::string_view descriptor_format_name(DescriptorFormat format) {
+    switch (format) {
+        case DescriptorFormat::Float32: return "f32";
+        case DescriptorFormat::Uint8:   return "u8";
+        case DescriptorFormat::None:    break;
+    }
+    return "none";
+}
+
+bool encode(
+    const std::vector<cv::KeyPoint>& keypoints,
+    const cv::Mat& descriptors,
+    DescriptorFormat format,
+    std::vector<unsigned char>& out
+) {
+    out.clear();
+    if (descriptors.empty()) {
+        format = DescriptorFormat::None;
+    }
+    std::uint32_t dims = 0;
+    if (format != DescriptorFormat::None) {
+        if (descriptors.rows != static_cast<int>(keypoints.size()) ||
+            descriptors.channels() != 1 ||
+            (descriptors.depth() != CV_32F && descriptors.depth() != CV_8U)) {
+            return false;
+        }
+        dims = static_cast<std::uint32_t>(descriptors.cols);
+    }
+
+    const std::size_t elem = descriptor_bytes(format);
+    out.resize(kHeaderBytes + keypoints.size() * kRecordBytes +
+               keypoints.size() * dims * elem);
+    unsigned char* p = out.data();
+    std::memcpy(p, kMagic, sizeof(kMagic));
+    p[4] = kVersion;
+    p[5] = static_cast<unsigned char>(format);
+    p[6] = 0;
+    p[7] = 0;
+    put_u32(p + 8, static_cast<std::uint32_t>(keypoints.size()));
+    put_u32(p + 12, dims);
+    p += kHeaderBytes;
+
+    for (const auto& kp : keypoints) {
+        put_f32(p, kp.pt.x);
+        put_f32(p + 4, kp.pt.y);
+        put_f32(p + 8, kp.size);
+        put_f32(p + 12, kp.angle);
+        put_f32(p + 16, kp.response);
+        put_u32(p + 20, static_cast<std::uint32_t>(kp.octave));
+        p += kRecordBytes;
+    }
+
+    for (int r = 0; r < descriptors.rows && format != DescriptorFormat::None; ++r) {
+        if (descriptors.depth() == CV_32F) {
+            const float* row = descriptors.ptr<float>(r);
+            for (std::uint32_t c = 0; c < dims; ++c) {
+                if (format == DescriptorFormat::Float32) {
+                    put_f32(p, row[c]);
+                    p += 4;
+                } else {
+                    *p++ = quantize(row[c]);
+                }
+            }
+        } else {
+            const unsigned char* row = descriptors.ptr<unsigned char>(r);
+            for (std::uint32_t c = 0; c < dims; ++c) {
+                if (format == DescriptorFormat::Float32) {
+                    put_f32(p, static_cast<float>(row[c]));
+                    p += 4;
+                } else {
+                    *p++ = row[c];
+                }
+            }
+        }
+    }
+    return true;
+}
+
+std::optional<Decoded> decode(std::span<const unsigned char> data) {
+    if (data.size() < kHeaderBytes || std::memcmp(data.data(), kMagic, sizeof(kMagic)) != 0 ||
+        data[4] != kVersion || data[5] > static_cast<unsigned char>(DescriptorFormat::Uint8)) {
+        return std::nullopt;
+    }
+    Decoded decoded;
+    decoded.format = static_cast<DescriptorFormat>(data[5]);
+    const std::uint64_t count = get_u32(data.data() + 8);
+    const std::uint64_t dims = get_u32(data.data() + 12);
+    const std::size_t elem = descriptor_bytes(decoded.format);
+    if (dims > kMaxDescriptorLength ||
+        data.size() != kHeaderBytes + count * kRecordBytes + count * dims * elem) {
+        return std::nullopt;
+    }
+
+    const unsigned char* p = data.data() + kHeaderBytes;
+    decoded.keypoints.reserve(count);
+    for (std::uint64_t i = 0; i < count; ++i) {
+        cv::KeyPoint kp;
+        kp.pt.x = get_f32(p);
+        kp.pt.y = get_f32(p + 4);
+        kp.size = get_f32(p + 8);
+        kp.angle = get_f32(p + 12);
+        kp.response = get_f32(p + 16);
+        kp.octave = static_cast<int>(get_u32(p + 20));
+        decoded.keypoints.push_back(kp);
+        p += kRecordBytes;
+    }
+
+    if (elem == 0 || count == 0 || dims == 0) {
+        return decoded;
+    }
+    const int rows = static_cast<int>(count);
+    const int cols = static_cast<int>(dims);
+    if (decoded.format == DescriptorFormat::Uint8) {
+        decoded.descriptors.create(rows, cols, CV_8U);
+        for (int r = 0; r < rows; ++r) {
+            std::memcpy(decoded.descriptors.ptr<unsigned char>(r), p, dims);
+            p += dims;
+        }
+    } else {
+        decoded.descriptors.create(rows, cols, CV_32F);
+        for (int r = 0; r < rows; ++r) {
+            float* row = decoded.descriptors.ptr<float>(r);
+            for (int c = 0; c < cols; ++c, p += 4) {
+                row[c] = get_f32(p);
+            }
+        }
+    }
+    return decoded;
+}
+
+}  // namespace keypoint_block
@@ -0,0 +1,126 @@
+#include "common/latency.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <iomanip>
+#include <time.h>
+
+namespace latency {
+namespace {
+
+constexpr std::size_t kSubBits = 4;  // log2 of the sub-buckets per octave
+
+std::size_t bucket_of(std::uint64_t v) {
+    if (v < (1u << kSubBits)) {
+        return static_cast<std::size_t>(v);
+    }
+    const int msb = 63 - std::countl_zero(v);
+    const int shift = msb - static_cast<int>(kSubBits);
+    const std::size_t sub = static_cast<std::size_t>((v >> shift) & ((1u << kSubBits) - 1));
+    return (static_cast<std::size_t>(shift) + 1) * (1u << kSubBits) + sub;
+}
+
+// Largest value that falls into `bucket`.
+std::uint64_t bucket_upper(std::size_t bucket) {
+    if (bucket < (1u << kSubBits)) {
+        return bucket;
+    }
+    const std::size_t shift = bucket / (1u << kSubBits) - 1;
+    const std::uint64_t sub = bucket % (1u << kSubBits);
+    const std::uint64_t base = ((std::uint64_t{1} << kSubBits) | sub) << shift;
+    return base + ((std::uint64_t{1} << shift) - 1);
+}
+
+double to_ms(std::uint64_t ns) {
+    return static_cast<double>(ns) / 1e6;
+}
+
+}  // namespace
+
+std::uint64_t now_ns() {
+    timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<std::uint64_t>(ts.tv_sec) * 1000000000ull +
+           static_cast<std::uint64_t>(ts.tv_nsec);
+}
+
+void Histogram::record(std::uint64_t ns) {
+    buckets_[bucket_of(ns)].fetch_add(1, std::memory_order_relaxed);
+    std::uint64_t prev = max_.load(std::memory_order_relaxed);
+    while (ns > prev && !max_.compare_exchange_weak(prev, ns, std::memory_order_relaxed)) {
+    }
+}
+
+void Histogram::record_between(std::uint64_t from, std::uint64_t to) {
+    if (from != 0 && to >= from) {
+        record(to - from);
+    }
+}
+
+std::uint64_t Histogram::count() const {
+    std::uint64_t total = 0;
+    for (const auto& bucket : buckets_) {
+        total += bucket.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+std::uint64_t Histogram::percentile(double q) const {
+    const std::uint64_t total = count();
+    if (total == 0) {
+        return 0;
+    }
+    const auto rank = static_cast<std::uint64_t>(std::ceil(q * static_cast<double>(total)));
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < kBuckets; ++i) {
+        seen += buckets_[i].load(std::memory_order_relaxed);
+        if (seen >= rank && seen > 0) {
+            return std::min(bucket_upper(i), max());
+        }
+    }
+    return max();
+}
+
+void Histogram::reset() {
+    for (auto& bucket : buckets_) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    max_.store(0, std::memory_order_relaxed);
+}
+
+Recorder::Recorder(std::chrono::seconds interval)
+    : interval_(interval), next_report_(std::chrono::steady_clock::now() + interval) {}
+
+Histogram& Recorder::add(std::string name) {
+    entries_.push_back({std::move(name), std::make_unique<Histogram>()});
+    return *entries_.back().histogram;
+}
+
+void Recorder::maybe_report(std::ostream& out) {
+    const auto now = std::chrono::steady_clock::now();
+    if (now < next_report_) {
+        return;
+    }
+    next_report_ = now + interval_;
+    report(out);
+}
+
+void Recorder::report(std::ostream& out) {
+    for (auto& entry : entries_) {
+        Histogram& h = *entry.histogram;
+        const std::uint64_t n = h.count();
+        if (n == 0) {
+            continue;
+        }
+        out << "Latency " << entry.name << ": n=" << n << std::fixed << std::setprecision(3)
+            << " p50=" << to_ms(h.percentile(0.50)) << "ms"
+            << " p99=" << to_ms(h.percentile(0.99)) << "ms"
+            << " p999=" << to_ms(h.percentile(0.999)) << "ms"
+            << " max=" << to_ms(h.max()) << "ms\n"
+            << std::defaultfloat;
+        h.reset();
+    }
+}
+
+}  // namespace latency
@@ -0,0 +1,289 @@
+#include "common/log.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace logging {
+namespace {
+// Ring slots; a full ring drops lines rather than block the caller.
+constexpr std::size_t kRingSlots = 4096;
+// Rate-limit table: call sites hash into it; a site that finds no free slot
+// within kProbe entries is not limited.
+constexpr std::size_t kSites = 512;
+constexpr std::size_t kProbe = 8;
+constexpr std::chrono::seconds kDropReportInterval{10};
+
+std::int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void write_line(const detail::Line& line) {
+    std::FILE* out = line.level >= Level::Warn ? stderr : stdout;
+    if (line.level == Level::Warn) {
+        std::fputs("[WARN] ", out);
+    } else if (line.level == Level::Error) {
+        std::fputs("[ERROR] ", out);
+    }
+    std::fwrite(line.text.data(), 1, line.size, out);
+    if (line.truncated) {
+        std::fputs("...", out);
+    }
+    std::fputc('\n', out);
+}
+
+// Bounded multi-producer, single-consumer ring (Vyukov): each slot's
+// sequence number says whether it is free for the producer at `pos` or
+// filled for the consumer at `pos`.
+class Ring {
+public:
+    Ring() : slots_(kRingSlots) {
+        for (std::size_t i = 0; i < kRingSlots; ++i) {
+            slots_[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bool push(const detail::Line& line) {
+        std::size_t pos = tail_.load(std::memory_order_relaxed);
+        while (true) {
+            Slot& slot = slots_[pos % kRingSlots];
+            const std::size_t seq = slot.seq.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+            if (diff == 0) {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    slot.line = line;
+                    slot.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Consumer only.
+    bool pop(detail::Line& line) {
+        Slot& slot = slots_[head_ % kRingSlots];
+        if (slot.seq.load(std::memory_order_acquire) != head_ + 1) {
+            return false;
+        }
+        line = slot.line;
+        slot.seq.store(head_ + kRingSlots, std::memory_order_release);
+        ++head_;
+        return true;
+    }
+
+private:
+    struct Slot {
+        std::atomic<std::size_t> seq{0};
+        detail::Line line;
+    };
+
+    std::vector<Slot> slots_;
+    alignas(64) std::atomic<std::size_t> tail_{0};
+    alignas(64) std::size_t head_ = 0;
+};
+
+struct SiteState {
+    std::atomic<const void*> key{nullptr};
+    std::atomic<std::int64_t> window_start{0};
+    std::atomic<std::uint32_t> count{0};
+    std::atomic<std::uint32_t> suppressed{0};
+};
+
+struct State {
+    Ring ring;
+    std::array<SiteState, kSites> sites;
+    std::atomic<std::uint32_t> rate{0};
+    std::atomic<bool> running{false};
+    // Set by the writer thread before it sleeps; a producer that clears it
+    // bumps `wake` to get it going again.
+    std::atomic<bool> idle{false};
+    std::atomic<std::uint32_t> wake{0};
+    std::atomic<std::uint64_t> dropped{0};
+    std::thread writer;
+    // Serializes synchronous writes before start() and after stop().
+    std::mutex sync_mutex;
+};
+
+State& state() {
+    static State* s = new State();  // outlives static destructors that log
+    return *s;
+}
+
+void writer_loop(State& s) {
+    detail::Line line;
+    std::uint64_t reported_dropped = 0;
+    auto next_drop_report = std::chrono::steady_clock::now() + kDropReportInterval;
+    while (true) {
+        bool any = false;
+        while (s.ring.pop(line)) {
+            write_line(line);
+            any = true;
+        }
+        if (any) {
+            std::fflush(stdout);
+            std::fflush(stderr);
+        }
+        const auto now = std::chrono::steady_clock::now();
+        const bool stopping = !any && !s.running.load();
+        if (now >= next_drop_report || stopping) {
+            next_drop_report = now + kDropReportInterval;
+            const std::uint64_t dropped = s.dropped.load(std::memory_order_relaxed);
+            if (dropped > reported_dropped) {
+                std::fprintf(stderr, "[WARN] Log queue full: %llu line(s) dropped\n",
+                             static_cast<unsigned long long>(dropped - reported_dropped));
+                reported_dropped = dropped;
+            }
+        }
+        if (any) {
+            continue;
+        }
+        const std::uint32_t seen = s.wake.load();
+        s.idle.store(true);
+        // Pairs with the fence in submit(): a line pushed after the drain
+        // above either shows up in this pop or sees `idle` and bumps `wake`
+        // past `seen`. stop() bumps it too, after clearing `running`.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (s.ring.pop(line)) {
+            write_line(line);
+            std::fflush(stdout);
+            std::fflush(stderr);
+        } else if (!s.running.load()) {
+            return;
+        } else {
+            s.wake.wait(seen);
+        }
+        s.idle.store(false);
+    }
+}
+}  // namespace
+
+std::optional<Level> parse_level(std::string_view name) {
+    if (name == "debug") return Level::Debug;
+    if (name == "info")  return Level::Info;
+    if (name == "warn")  return Level::Warn;
+    if (name == "error") return Level::Error;
+    if (name == "off")   return Level::Off;
+    return std::nullopt;
+}
+
+std::string_view level_name(Level level) {
+    switch (level) {
+        case Level::Debug: return "debug";
+        case Level::Info:  return "info";
+        case Level::Warn:  return "warn";
+        case Level::Error: return "error";
+        case Level::Off:   return "off";
+    }
+    return "info";
+}
+
+std::optional<Options> options_from_args(const cli_utils::Args& args) {
+    Options options;
+    const std::string level = args.get("log-level", level_name(options.level));
+    auto parsed = parse_level(level);
+    if (!parsed) {
+        std::cerr << "Unknown --log-level " << level << " (expected debug|info|warn|error|off)\n";
+        return std::nullopt;
+    }
+    options.level = *parsed;
+    const long long rate = args.get_int("log-rate", options.rate);
+    if (rate < 0) {
+        std::cerr << "--log-rate must be 0 (unlimited) or more lines per second\n";
+        return std::nullopt;
+    }
+    options.rate = static_cast<std::uint32_t>(rate);
+    return options;
+}
+
+void start(const Options& options) {
+    State& s = state();
+    detail::g_level.store(static_cast<int>(options.level), std::memory_order_relaxed);
+    s.rate.store(options.rate, std::memory_order_relaxed);
+    if (s.running.exchange(true)) {
+        return;
+    }
+    s.writer = std::thread(writer_loop, std::ref(s));
+    // Early returns from main() still get their last lines out.
+    std::atexit(stop);
+}
+
+void stop() {
+    State& s = state();
+    if (!s.running.exchange(false)) {
+        return;
+    }
+    s.wake.fetch_add(1);
+    s.wake.notify_one();
+    s.writer.join();
+}
+
+namespace detail {
+
+bool admit(const void* site, std::uint32_t& suppressed) {
+    State& s = state();
+    const std::uint32_t rate = s.rate.load(std::memory_order_relaxed);
+    if (rate == 0) {
+        return true;
+    }
+    const std::size_t start = (reinterpret_cast<std::uintptr_t>(site) >> 3) % kSites;
+    for (std::size_t i = 0; i < kProbe; ++i) {
+        SiteState& entry = s.sites[(start + i) % kSites];
+        const void* key = entry.key.load(std::memory_order_acquire);
+        if (key == nullptr) {
+            const void* expected = nullptr;
+            if (!entry.key.compare_exchange_strong(expected, site, std::memory_order_acq_rel) &&
+                expected != site) {
+                continue;
+            }
+        } else if (key != site) {
+            continue;
+        }
+        // One-second windows. Racing callers may both reset a window, which
+        // only lets a line or two more through.
+        const std::int64_t now = now_ns();
+        std::int64_t window = entry.window_start.load(std::memory_order_relaxed);
+        if (now - window >= 1000000000 &&
+            entry.window_start.compare_exchange_strong(window, now, std::memory_order_relaxed)) {
+            entry.count.store(0, std::memory_order_relaxed);
+        }
+        if (entry.count.fetch_add(1, std::memory_order_relaxed) >= rate) {
+            entry.suppressed.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        suppressed = entry.suppressed.exchange(0, std::memory_order_relaxed);
+        return true;
+    }
+    return true;
+}
+
+void submit(const Line& line) {
+    State& s = state();
+    if (!s.running.load(std::memory_order_acquire)) {
+        std::lock_guard lock(s.sync_mutex);
+        write_line(line);
+        std::fflush(line.level >= Level::Warn ? stderr : stdout);
+        return;
+    }
+    if (!s.ring.push(line)) {
+        s.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (s.idle.load() && s.idle.exchange(false)) {
+        s.wake.fetch_add(1);
+        s.wake.notify_one();
+    }
+}
+
+}  // namespace detail
+}  // namespace logging
@@ -0,0 +1,245 @@
+#include "common/metrics.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+#include <unistd.h>
+
+#include <zmq.h>
+
+#include "common/latency.hpp"
+#include "common/log.hpp"
+#include "common/zmq_utils.hpp"
+
+namespace metrics {
+namespace {
+
+// Snapshots queued for a slow voyis_top before newer ones are dropped.
+constexpr int kSendHwm = 16;
+
+template <typename T>
+T& find_or_add(std::vector<T>& entries, const std::string& name) {
+    auto it = std::find_if(entries.begin(), entries.end(),
+                           [&](const T& entry) { return entry.name == name; });
+    if (it != entries.end()) {
+        return *it;
+    }
+    entries.push_back({name, std::make_unique<typename decltype(T::value)::element_type>()});
+    return entries.back();
+}
+
+double to_ms(std::uint64_t ns) {
+    return static_cast<double>(ns) / 1e6;
+}
+
+}  // namespace
+
+std::optional<Options> options_from_args(const cli_utils::Args& args) {
+    Options options;
+    const std::string mode = args.get("metrics", "on");
+    if (mode != "on" && mode != "off") {
+        logging::error("Unknown --metrics ", mode, " (expected on or off)");
+        return std::nullopt;
+    }
+    options.enabled = mode == "on";
+    const long long interval = args.get_int("metrics-interval", options.interval.count());
+    if (interval < 1) {
+        logging::error("--metrics-interval must be at least 1 second");
+        return std::nullopt;
+    }
+    options.interval = std::chrono::seconds(interval);
+    options.endpoint = args.get("metrics-endpoint", options.endpoint);
+    options.dir = args.get("metrics-dir", options.dir);
+    return options;
+}
+
+void Timer::record(std::uint64_t ns) {
+    count_.fetch_add(1, std::memory_order_relaxed);
+    total_ns_.fetch_add(ns, std::memory_order_relaxed);
+    std::uint64_t prev = max_ns_.load(std::memory_order_relaxed);
+    while (ns > prev && !max_ns_.compare_exchange_weak(prev, ns, std::memory_order_relaxed)) {
+    }
+}
+
+Registry::Registry(std::string stage, std::string instance)
+    : stage_(std::move(stage)),
+      instance_(instance.empty() ? std::to_string(getpid()) : std::move(instance)) {}
+
+Counter& Registry::counter(const std::string& name) {
+    std::lock_guard lock(mutex_);
+    return *find_or_add(counters_, name).value;
+}
+
+Gauge& Registry::gauge(const std::string& name, std::int64_t capacity) {
+    std::lock_guard lock(mutex_);
+    auto& entry = find_or_add(gauges_, name);
+    entry.capacity = capacity;
+    return *entry.value;
+}
+
+Timer& Registry::timer(const std::string& name) {
+    std::lock_guard lock(mutex_);
+    return *find_or_add(timers_, name).value;
+}
+
+void Registry::counter(const std::string& name, std::function<std::uint64_t()> read) {
+    std::lock_guard lock(mutex_);
+    sampled_.push_back({name, [read = std::move(read)] { return static_cast<std::int64_t>(read()); },
+                        0, false});
+}
+
+void Registry::gauge(const std::string& name, std::function<std::int64_t()> read,
+                     std::int64_t capacity) {
+    std::lock_guard lock(mutex_);
+    sampled_.push_back({name, std::move(read), capacity, true});
+}
+
+void Registry::link(const std::string& name, const flow_control::LinkCounters& c) {
+    auto load = [](const std::atomic<std::uint64_t>& value) {
+        return value.load(std::memory_order_relaxed);
+    };
+    // A would-block drop bumps dropped_newest first, so reading the subset
+    // first keeps the difference from going negative.
+    counter("drops." + name + ".no_credit", [&c, load] {
+        const std::uint64_t would_block = load(c.dropped_would_block);
+        return load(c.dropped_newest) - would_block;
+    });
+    counter("drops." + name + ".would_block", [&c, load] { return load(c.dropped_would_block); });
+    counter("drops." + name + ".oldest", [&c, load] { return load(c.dropped_oldest); });
+    counter("drops." + name + ".send_error", [&c, load] { return load(c.send_errors); });
+    counter("link." + name + ".sent", [&c, load] { return load(c.sent); });
+    counter("link." + name + ".blocked_ms", [&c, load] { return load(c.blocked_us) / 1000; });
+}
+
+nlohmann::json Registry::snapshot() {
+    nlohmann::json counters = nlohmann::json::object();
+    nlohmann::json gauges = nlohmann::json::object();
+    nlohmann::json timers = nlohmann::json::object();
+    {
+        std::lock_guard lock(mutex_);
+        for (const auto& entry : counters_) {
+            counters[entry.name] = entry.value->value();
+        }
+        for (const auto& entry : gauges_) {
+            gauges[entry.name] = {{"value", entry.value->value()}, {"capacity", entry.capacity}};
+        }
+        for (auto& entry : timers_) {
+            timers[entry.name] = {{"count", entry.value->count()},
+                                  {"total_ms", to_ms(entry.value->total_ns())},
+                                  {"max_ms", to_ms(entry.value->take_max_ns())}};
+        }
+        for (const auto& entry : sampled_) {
+            if (entry.gauge) {
+                gauges[entry.name] = {{"value", entry.read()}, {"capacity", entry.capacity}};
+            } else {
+                counters[entry.name] = static_cast<std::uint64_t>(entry.read());
+            }
+        }
+    }
+    return {
+        {"stage", stage_},
+        {"instance", instance_},
+        {"pid", static_cast<long long>(getpid())},
+        {"time_ms", std::chrono::duration_cast<std::chrono::milliseconds>(
+                        std::chrono::system_clock::now().time_since_epoch()).count()},
+        {"mono_ns", latency::now_ns()},
+        {"counters", std::move(counters)},
+        {"gauges", std::move(gauges)},
+        {"timers", std::move(timers)}
+    };
+}
+
+Publisher::Publisher(Registry& registry, Options options)
+    : registry_(registry), options_(std::move(options)) {
+    if (!options_.enabled) {
+        return;
+    }
+    if (!options_.endpoint.empty()) {
+        // Connecting lets voyis_top bind one endpoint for every stage, and
+        // come and go while the stages run.
+        context_ = zmq_ctx_new();
+        socket_ = zmq_socket(context_, ZMQ_PUB);
+        int linger = 0;
+        zmq_setsockopt(socket_, ZMQ_LINGER, &linger, sizeof(linger));
+        zmq_utils::set_hwm(socket_, kSendHwm, kSendHwm);
+        if (zmq_connect(socket_, options_.endpoint.c_str()) != 0) {
+            logging::warn("Metrics socket ", options_.endpoint, " unavailable: ", zmq_strerror(errno));
+            zmq_close(socket_);
+            socket_ = nullptr;
+        }
+    }
+    if (!options_.dir.empty()) {
+        std::error_code ec;
+        std::filesystem::create_directories(options_.dir, ec);
+        if (ec) {
+            logging::warn("Metrics directory ", options_.dir, " unavailable: ", ec.message());
+        } else {
+            file_ = (std::filesystem::path(options_.dir) /
+                     (registry_.stage() + "-" + std::to_string(getpid()) + ".json")).string();
+        }
+    }
+    logging::info("Publishing metrics every ", options_.interval.count(), " s",
+                  socket_ ? " on " : "", socket_ ? options_.endpoint : std::string(),
+                  file_.empty() ? "" : " to ", file_);
+    thread_ = std::thread([this] { run(); });
+}
+
+Publisher::~Publisher() {
+    if (thread_.joinable()) {
+        {
+            std::lock_guard lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_one();
+        thread_.join();
+    }
+    // A stopped process leaves no snapshot behind for voyis_top to age out.
+    if (!file_.empty()) {
+        std::remove(file_.c_str());
+    }
+    if (socket_) {
+        zmq_close(socket_);
+    }
+    if (context_) {
+        zmq_ctx_term(context_);
+    }
+}
+
+void Publisher::run() {
+    std::unique_lock lock(mutex_);
+    while (!wake_.wait_for(lock, options_.interval, [&] { return stop_; })) {
+        lock.unlock();
+        publish();
+        lock.lock();
+    }
+    lock.unlock();
+    publish();
+}
+
+void Publisher::publish() {
+    const std::string text = registry_.snapshot().dump();
+    if (socket_) {
+        // Nobody listening, or a voyis_top that fell behind: drop it.
+        zmq_utils::send_string(socket_, text, ZMQ_DONTWAIT, "zmq_send(metrics)");
+    }
+    if (!file_.empty()) {
+        const std::string tmp = file_ + ".tmp";
+        {
+            std::ofstream out(tmp, std::ios::trunc);
+            out << text << "\n";
+            if (!out) {
+                logging::warn("Failed to write metrics snapshot ", tmp);
+                return;
+            }
+        }
+        if (std::rename(tmp.c_str(), file_.c_str()) != 0) {
+            logging::warn("Failed to replace metrics snapshot ", file_, ": ", std::strerror(errno));
+        }
+    }
+}
+
+}  // namespace metrics
@@ -0,0 +1,150 @@
+#include "common/pacing.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+namespace pacing {
+namespace {
+
+template <typename T>
+std::optional<T> parse_number(std::string_view text) {
+    T value{};
+    auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (ec != std::errc{} || ptr != text.data() + text.size()) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+// Gaps between consecutive timestamps; a clock that went backwards counts
+// as no gap.
+std::optional<std::vector<Pacer::Clock::duration>> load_trace(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "[ERROR] Cannot open pacing trace " << path << "\n";
+        return std::nullopt;
+    }
+    std::vector<Pacer::Clock::duration> gaps;
+    std::optional<double> previous;
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        std::string first;
+        if (!(fields >> first) || first[0] == '#') {
+            continue;
+        }
+        auto seconds = parse_number<double>(first);
+        if (!seconds) {
+            std::cerr << "[ERROR] Bad timestamp '" << first << "' in pacing trace " << path << "\n";
+            return std::nullopt;
+        }
+        if (previous) {
+            gaps.push_back(std::chrono::duration_cast<Pacer::Clock::duration>(
+                std::chrono::duration<double>(std::max(0.0, *seconds - *previous))));
+        }
+        previous = seconds;
+    }
+    if (gaps.empty()) {
+        std::cerr << "[ERROR] Pacing trace " << path << " needs at least two timestamps\n";
+        return std::nullopt;
+    }
+    return gaps;
+}
+
+}  // namespace
+
+std::optional<Pacer> Pacer::parse(std::string_view spec) {
+    const auto colon = spec.find(':');
+    const std::string_view name = spec.substr(0, colon);
+    const std::string_view rest = colon == std::string_view::npos ? std::string_view{}
+                                                                  : spec.substr(colon + 1);
+    if (name == "max" && rest.empty()) {
+        return Pacer(Mode::Max, "max");
+    }
+    if (name == "fps") {
+        auto fps = parse_number<double>(rest);
+        if (!fps || *fps <= 0.0) {
+            return std::nullopt;
+        }
+        Pacer pacer(Mode::Fixed, std::string(spec));
+        pacer.interval_ = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(1.0 / *fps));
+        return pacer;
+    }
+    if (name == "burst") {
+        const auto second = rest.find(':');
+        if (second == std::string_view::npos) {
+            return std::nullopt;
+        }
+        auto frames = parse_number<std::uint32_t>(rest.substr(0, second));
+        auto period_ms = parse_number<std::uint32_t>(rest.substr(second + 1));
+        if (!frames || *frames == 0 || !period_ms || *period_ms == 0) {
+            return std::nullopt;
+        }
+        Pacer pacer(Mode::Burst, std::string(spec));
+        pacer.burst_frames_ = *frames;
+        pacer.interval_ = std::chrono::milliseconds(*period_ms);
+        return pacer;
+    }
+    if (name == "trace" && !rest.empty()) {
+        auto gaps = load_trace(std::string(rest));
+        if (!gaps) {
+            return std::nullopt;
+        }
+        Pacer pacer(Mode::Trace, std::string(spec));
+        pacer.trace_gaps_ = std::move(*gaps);
+        return pacer;
+    }
+    return std::nullopt;
+}
+
+Pacer::Clock::duration Pacer::next_gap() {
+    switch (mode_) {
+        case Mode::Fixed:
+            return interval_;
+        case Mode::Burst:
+            // The deadlines of a burst's frames all equal its start, so the
+            // last frame's gap is the whole period.
+            if (++in_burst_ < burst_frames_) {
+                return Clock::duration::zero();
+            }
+            in_burst_ = 0;
+            return interval_;
+        case Mode::Trace: {
+            auto gap = trace_gaps_[trace_pos_];
+            trace_pos_ = (trace_pos_ + 1) % trace_gaps_.size();
+            return gap;
+        }
+        case Mode::Max:
+            break;
+    }
+    return Clock::duration::zero();
+}
+
+void Pacer::wait() {
+    if (mode_ == Mode::Max) {
+        return;
+    }
+    const auto now = Clock::now();
+    if (!started_) {
+        started_ = true;
+        due_ = now;
+        return;
+    }
+    const auto gap = next_gap();
+    due_ += gap;
+    // Within a burst every frame is "late"; only missing a whole period is.
+    const auto slack = mode_ == Mode::Burst ? interval_ : gap;
+    if (slack > Clock::duration::zero() && now - due_ > slack) {
+        ++late_;
+        due_ = now;
+        return;
+    }
+    std::this_thread::sleep_until(due_);
+}
+
+}  // namespace pacing
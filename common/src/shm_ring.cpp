@@ -0,0 +1,359 @@
+#include "common/shm_ring.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <random>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "common/latency.hpp"
+#include "common/log.hpp"
+
+namespace shm_ring {
+namespace {
+
+constexpr unsigned char kDescriptorMagic[4] = {'V', 'S', 'H', 'D'};
+constexpr std::uint16_t kDescriptorVersion = 1;
+constexpr std::size_t kDescriptorFixedBytes = 36;
+constexpr char kRingMagic[8] = {'V', 'O', 'Y', 'I', 'S', 'R', 'N', 'G'};
+constexpr std::uint32_t kRingVersion = 1;
+constexpr std::uint64_t kPageBytes = 4096;
+
+// A slot's tag packs its generation and state into one word, so freeing a
+// slot can never free a later reuse of it.
+enum SlotState : std::uint64_t { kFree = 0, kWriting = 1, kPublished = 2 };
+
+constexpr std::uint64_t make_tag(std::uint64_t generation, SlotState state) {
+    return generation << 2 | state;
+}
+constexpr std::uint64_t tag_generation(std::uint64_t tag) { return tag >> 2; }
+constexpr std::uint64_t tag_state(std::uint64_t tag) { return tag & 3; }
+
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free,
+              "slot tags are shared between processes");
+
+struct RingHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t slot_count;
+    std::uint64_t slot_bytes;
+    std::uint64_t ring_id;
+    std::uint64_t data_offset;
+};
+
+struct SlotHeader {
+    std::atomic<std::uint64_t> tag;
+    std::atomic<std::uint64_t> published_ns;
+    std::uint64_t length;
+    std::uint64_t reserved;
+};
+
+template <typename T>
+void put(unsigned char* out, T value) {
+    auto v = static_cast<std::uint64_t>(value);
+    for (std::size_t i = 0; i < sizeof(T); ++i) {
+        out[i] = static_cast<unsigned char>(v >> (8 * i));
+    }
+}
+
+template <typename T>
+T get(const unsigned char* in) {
+    std::uint64_t v = 0;
+    for (std::size_t i = 0; i < sizeof(T); ++i) {
+        v |= static_cast<std::uint64_t>(in[i]) << (8 * i);
+    }
+    return static_cast<T>(v);
+}
+
+std::uint64_t round_up(std::uint64_t n, std::uint64_t to) {
+    return (n + to - 1) / to * to;
+}
+
+std::uint64_t make_ring_id() {
+    std::random_device rd;
+    return ((std::uint64_t{rd()} << 32) ^ rd()) ^ latency::now_ns();
+}
+
+}  // namespace
+
+// One mmapped ring. The producer's mapping also owns the name.
+class Mapping {
+public:
+    Mapping(std::string name, unsigned char* base, std::size_t size, bool owner)
+        : name_(std::move(name)), base_(base), size_(size), owner_(owner) {}
+
+    ~Mapping() {
+        munmap(base_, size_);
+        if (owner_) {
+            shm_unlink(name_.c_str());
+        }
+    }
+
+    Mapping(const Mapping&) = delete;
+    Mapping& operator=(const Mapping&) = delete;
+
+    const std::string& name() const { return name_; }
+    RingHeader& header() const { return *reinterpret_cast<RingHeader*>(base_); }
+    SlotHeader& slot(std::uint32_t i) const {
+        return reinterpret_cast<SlotHeader*>(base_ + sizeof(RingHeader))[i];
+    }
+    unsigned char* data(std::uint32_t i) const {
+        return base_ + header().data_offset + i * header().slot_bytes;
+    }
+
+    // Frees `slot` if it still holds `generation`.
+    bool free(std::uint32_t i, std::uint64_t generation) const {
+        std::uint64_t expected = make_tag(generation, kPublished);
+        return slot(i).tag.compare_exchange_strong(expected, make_tag(generation, kFree),
+                                                   std::memory_order_release);
+    }
+
+private:
+    std::string name_;
+    unsigned char* base_;
+    std::size_t size_;
+    bool owner_;
+};
+
+void encode(const Descriptor& desc, std::vector<unsigned char>& out) {
+    out.resize(kDescriptorFixedBytes + desc.name.size());
+    unsigned char* p = out.data();
+    std::memcpy(p, kDescriptorMagic, sizeof(kDescriptorMagic));
+    put<std::uint16_t>(p + 4, kDescriptorVersion);
+    put<std::uint16_t>(p + 6, static_cast<std::uint16_t>(desc.name.size()));
+    put<std::uint32_t>(p + 8, desc.slot);
+    put<std::uint64_t>(p + 12, desc.ring_id);
+    put<std::uint64_t>(p + 20, desc.generation);
+    put<std::uint64_t>(p + 28, desc.length);
+    std::memcpy(p + kDescriptorFixedBytes, desc.name.data(), desc.name.size());
+}
+
+std::optional<Descriptor> decode(std::span<const unsigned char> data) {
+    if (data.size() < kDescriptorFixedBytes ||
+        std::memcmp(data.data(), kDescriptorMagic, sizeof(kDescriptorMagic)) != 0 ||
+        get<std::uint16_t>(data.data() + 4) != kDescriptorVersion) {
+        return std::nullopt;
+    }
+    const std::size_t name_bytes = get<std::uint16_t>(data.data() + 6);
+    if (data.size() != kDescriptorFixedBytes + name_bytes) {
+        return std::nullopt;
+    }
+    Descriptor desc;
+    desc.slot = get<std::uint32_t>(data.data() + 8);
+    desc.ring_id = get<std::uint64_t>(data.data() + 12);
+    desc.generation = get<std::uint64_t>(data.data() + 20);
+    desc.length = get<std::uint64_t>(data.data() + 28);
+    desc.name.assign(reinterpret_cast<const char*>(data.data() + kDescriptorFixedBytes),
+                     name_bytes);
+    return desc;
+}
+
+std::optional<Producer> Producer::create(
+    const std::string& name,
+    std::uint32_t slots,
+    std::uint64_t slot_bytes,
+    std::chrono::milliseconds reclaim_after
+) {
+    slots = std::max<std::uint32_t>(1, slots);
+    slot_bytes = round_up(std::max<std::uint64_t>(1, slot_bytes), kPageBytes);
+    const std::uint64_t data_offset =
+        round_up(sizeof(RingHeader) + slots * sizeof(SlotHeader), kPageBytes);
+    const std::uint64_t size = data_offset + slots * slot_bytes;
+
+    // Like bind_endpoint(): a ring left behind by a crashed run is replaced.
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        std::cerr << "[ERROR] shm_open(" << name << ") failed: " << std::strerror(errno) << "\n";
+        return std::nullopt;
+    }
+    if (int rc = posix_fallocate(fd, 0, static_cast<off_t>(size)); rc != 0) {
+        std::cerr << "[ERROR] Cannot reserve " << (size >> 20) << " MiB of shared memory for "
+                  << name << ": " << std::strerror(rc) << " (is /dev/shm large enough?)\n";
+        close(fd);
+        shm_unlink(name.c_str());
+        return std::nullopt;
+    }
+    void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        std::cerr << "[ERROR] mmap(" << name << ") failed: " << std::strerror(errno) << "\n";
+        shm_unlink(name.c_str());
+        return std::nullopt;
+    }
+    auto mapping = std::make_shared<Mapping>(name, static_cast<unsigned char*>(base),
+                                             static_cast<std::size_t>(size), true);
+    RingHeader& header = mapping->header();
+    std::memcpy(header.magic, kRingMagic, sizeof(kRingMagic));
+    header.version = kRingVersion;
+    header.slot_count = slots;
+    header.slot_bytes = slot_bytes;
+    header.ring_id = make_ring_id();
+    header.data_offset = data_offset;
+    for (std::uint32_t i = 0; i < slots; ++i) {
+        new (&mapping->slot(i)) SlotHeader{};
+    }
+    return Producer(std::move(mapping), reclaim_after);
+}
+
+Producer::Producer(std::shared_ptr<Mapping> mapping, std::chrono::milliseconds reclaim_after)
+    : mapping_(std::move(mapping)), reclaim_after_(reclaim_after) {}
+
+Producer::~Producer() = default;
+Producer::Producer(Producer&&) noexcept = default;
+Producer& Producer::operator=(Producer&&) noexcept = default;
+
+std::uint64_t Producer::slot_bytes() const {
+    return mapping_->header().slot_bytes;
+}
+
+std::optional<Descriptor> Producer::publish(std::span<const unsigned char> payload) {
+    const RingHeader& header = mapping_->header();
+    if (payload.size() > header.slot_bytes) {
+        return std::nullopt;
+    }
+    const std::uint32_t count = header.slot_count;
+    for (int pass = 0; pass < 2; ++pass) {
+        for (std::uint32_t n = 0; n < count; ++n) {
+            const std::uint32_t i = (cursor_ + n) % count;
+            SlotHeader& slot = mapping_->slot(i);
+            std::uint64_t tag = slot.tag.load(std::memory_order_acquire);
+            if (tag_state(tag) != kFree) {
+                continue;
+            }
+            const std::uint64_t generation = tag_generation(tag) + 1;
+            if (!slot.tag.compare_exchange_strong(tag, make_tag(generation, kWriting),
+                                                  std::memory_order_acquire)) {
+                continue;
+            }
+            std::memcpy(mapping_->data(i), payload.data(), payload.size());
+            slot.length = payload.size();
+            slot.published_ns.store(latency::now_ns(), std::memory_order_relaxed);
+            slot.tag.store(make_tag(generation, kPublished), std::memory_order_release);
+            cursor_ = (i + 1) % count;
+            return Descriptor{mapping_->name(), header.ring_id, i, generation, payload.size()};
+        }
+        if (pass > 0) {
+            break;
+        }
+        // Every slot is held: take back the ones a consumer has sat on for
+        // too long (most likely it died) and try once more.
+        const std::uint64_t now = latency::now_ns();
+        const auto limit = static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(reclaim_after_).count());
+        bool any = false;
+        for (std::uint32_t i = 0; i < count; ++i) {
+            SlotHeader& slot = mapping_->slot(i);
+            const std::uint64_t tag = slot.tag.load(std::memory_order_acquire);
+            if (tag_state(tag) == kPublished &&
+                now - slot.published_ns.load(std::memory_order_relaxed) > limit &&
+                mapping_->free(i, tag_generation(tag))) {
+                ++reclaimed_;
+                any = true;
+            }
+        }
+        if (!any) {
+            break;
+        }
+    }
+    ++full_;
+    return std::nullopt;
+}
+
+void Producer::cancel(const Descriptor& desc) {
+    mapping_->free(desc.slot, desc.generation);
+}
+
+Lease::Lease(std::shared_ptr<Mapping> mapping, std::uint32_t slot, std::uint64_t generation,
+             std::span<const unsigned char> bytes)
+    : mapping_(std::move(mapping)), slot_(slot), generation_(generation), bytes_(bytes) {}
+
+Lease::~Lease() {
+    release();
+}
+
+Lease::Lease(Lease&& other) noexcept
+    : mapping_(std::move(other.mapping_)),
+      slot_(other.slot_),
+      generation_(other.generation_),
+      bytes_(other.bytes_) {}
+
+Lease& Lease::operator=(Lease&& other) noexcept {
+    if (this != &other) {
+        release();
+        mapping_ = std::move(other.mapping_);
+        slot_ = other.slot_;
+        generation_ = other.generation_;
+        bytes_ = other.bytes_;
+    }
+    return *this;
+}
+
+bool Lease::valid() const {
+    // Keeps the caller's reads of the bytes from moving past the check.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return mapping_ && mapping_->slot(slot_).tag.load(std::memory_order_acquire) ==
+                           make_tag(generation_, kPublished);
+}
+
+void Lease::release() {
+    if (mapping_) {
+        mapping_->free(slot_, generation_);
+        mapping_.reset();
+    }
+}
+
+std::optional<Lease> Consumer::open(const Descriptor& desc) {
+    if (!mapping_ || mapping_->name() != desc.name ||
+        mapping_->header().ring_id != desc.ring_id) {
+        mapping_.reset();
+        int fd = shm_open(desc.name.c_str(), O_RDWR, 0);
+        if (fd < 0) {
+            logging::error("shm_open(", desc.name, ") failed: ", std::strerror(errno));
+            return std::nullopt;
+        }
+        struct stat st{};
+        void* base = MAP_FAILED;
+        if (fstat(fd, &st) == 0 && static_cast<std::size_t>(st.st_size) >= sizeof(RingHeader)) {
+            base = mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ | PROT_WRITE,
+                        MAP_SHARED, fd, 0);
+        }
+        close(fd);
+        if (base == MAP_FAILED) {
+            logging::error("Cannot map shared-memory ring ", desc.name);
+            return std::nullopt;
+        }
+        auto mapping = std::make_shared<Mapping>(desc.name, static_cast<unsigned char*>(base),
+                                                 static_cast<std::size_t>(st.st_size), false);
+        const RingHeader& header = mapping->header();
+        if (std::memcmp(header.magic, kRingMagic, sizeof(kRingMagic)) != 0 ||
+            header.version != kRingVersion ||
+            header.data_offset + std::uint64_t{header.slot_count} * header.slot_bytes >
+                static_cast<std::uint64_t>(st.st_size)) {
+            logging::error("Not a frame ring: ", desc.name);
+            return std::nullopt;
+        }
+        if (header.ring_id != desc.ring_id) {
+            // The producer restarted since this descriptor was sent.
+            return std::nullopt;
+        }
+        mapping_ = std::move(mapping);
+    }
+    const RingHeader& header = mapping_->header();
+    if (desc.slot >= header.slot_count || desc.length > header.slot_bytes ||
+        mapping_->slot(desc.slot).tag.load(std::memory_order_acquire) !=
+            make_tag(desc.generation, kPublished)) {
+        return std::nullopt;
+    }
+    return Lease(mapping_, desc.slot, desc.generation,
+                 {mapping_->data(desc.slot), static_cast<std::size_t>(desc.length)});
+}
+
+}  // namespace shm_ring
@@ -3,6 +3,8 @@
 #include <iostream>
 #include <string>
 
+#include "common/log.hpp"
+
 namespace sqlite_utils {
 
 void DbDeleter::operator()(sqlite3* db) const noexcept {
@@ -37,8 +39,7 @@ bool exec(sqlite3* db, std::string_view sql, std::string_view what) {
     std::string sql_str(sql);
     int rc = sqlite3_exec(db, sql_str.c_str(), nullptr, nullptr, &errmsg);
     if (rc != SQLITE_OK) {
-        std::cerr << "[ERROR] " << what << " failed: "
-                  << (errmsg ? errmsg : sqlite3_errmsg(db)) << "\n";
+        logging::error("SQLite ", what, " failed: ", errmsg ? errmsg : sqlite3_errmsg(db));
         sqlite3_free(errmsg);
         return false;
     }
@@ -67,8 +68,7 @@ bool step(sqlite3_stmt* stmt, std::string_view what) {
         return true;
     }
     sqlite3* db = sqlite3_db_handle(stmt);
-    std::cerr << "[ERROR] " << what << " failed: "
-              << (db ? sqlite3_errmsg(db) : "unknown") << "\n";
+    logging::error("SQLite ", what, " failed: ", db ? sqlite3_errmsg(db) : "unknown");
     return false;
 }
 
@@ -80,4 +80,26 @@ void reset(sqlite3_stmt* stmt) {
     sqlite3_clear_bindings(stmt);
 }
 
+bool ensure_column(
+    sqlite3* db,
+    std::string_view table,
+    std::string_view column,
+    std::string_view decl
+) {
+    std::string table_str(table);
+    auto info = prepare(db, "PRAGMA table_info(" + table_str + ");", "prepare table_info");
+    if (!info) {
+        return false;
+    }
+    while (sqlite3_step(info->get()) == SQLITE_ROW) {
+        auto* name = reinterpret_cast<const char*>(sqlite3_column_text(info->get(), 1));
+        if (name && column == name) {
+            return true;
+        }
+    }
+    std::string sql = "ALTER TABLE " + table_str + " ADD COLUMN " +
+                      std::string(column) + " " + std::string(decl) + ";";
+    return exec(db, sql, "add column " + table_str + "." + std::string(column));
+}
+
 }  // namespace sqlite_utils
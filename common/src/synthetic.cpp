@@ -0,0 +1,116 @@
+#include "common/synthetic.hpp"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstdio>
+#include <random>
+
+#include <opencv2/imgproc.hpp>
+
+namespace synthetic {
+namespace {
+
+struct NamedResolution {
+    std::string_view name;
+    int width;
+    int height;
+};
+
+constexpr std::array<NamedResolution, 5> kNamedResolutions{{
+    {"vga", 640, 480},
+    {"720p", 1280, 720},
+    {"1080p", 1920, 1080},
+    {"4k", 3840, 2160},
+    {"8k", 7680, 4320},
+}};
+
+// Largest side accepted by parse_resolution(): room for 12K survey frames,
+// while a 16K x 16K BGR frame is already 768 MiB in one ZeroMQ message.
+constexpr int kMaxSide = 16384;
+
+std::optional<int> parse_side(std::string_view text) {
+    int value = 0;
+    auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (ec != std::errc{} || ptr != text.data() + text.size() || value < 16 || value > kMaxSide) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+}  // namespace
+
+std::optional<cv::Size> parse_resolution(std::string_view text) {
+    for (const auto& named : kNamedResolutions) {
+        if (text == named.name) {
+            return cv::Size(named.width, named.height);
+        }
+    }
+    const auto x = text.find('x');
+    if (x == std::string_view::npos) {
+        return std::nullopt;
+    }
+    auto width = parse_side(text.substr(0, x));
+    auto height = parse_side(text.substr(x + 1));
+    if (!width || !height) {
+        return std::nullopt;
+    }
+    return cv::Size(*width, *height);
+}
+
+cv::Mat render(const Spec& spec, std::uint64_t index) {
+    // Only integer maths on std::mt19937_64's output (no std distributions,
+    // whose results differ between standard libraries), so frames are the
+    // same on every platform.
+    std::mt19937_64 rng(spec.seed * 0x9e3779b97f4a7c15ull + index);
+    auto uniform = [&](int lo, int hi) {
+        return lo + static_cast<int>(rng() % static_cast<std::uint64_t>(hi - lo + 1));
+    };
+
+    const int cols = spec.size.width;
+    const int rows = spec.size.height;
+    cv::Mat img(rows, cols, CV_8UC3);
+
+    // A smooth vertical gradient: flat regions give SIFT nothing to find, so
+    // the keypoints come from the shapes alone.
+    const int top = uniform(40, 120);
+    const int bottom = uniform(120, 200);
+    for (int r = 0; r < rows; ++r) {
+        const int v = top + (bottom - top) * r / std::max(1, rows - 1);
+        img.row(r).setTo(cv::Scalar(v, v, v));
+    }
+
+    const double megapixels = static_cast<double>(cols) * rows / 1e6;
+    const auto shapes = static_cast<std::uint64_t>(std::max(0.0, spec.texture * megapixels));
+    const int max_extent = std::max(4, std::min(cols, rows) / 40);
+    for (std::uint64_t i = 0; i < shapes; ++i) {
+        const cv::Point center(uniform(0, cols - 1), uniform(0, rows - 1));
+        const int extent = uniform(3, max_extent);
+        const cv::Scalar color(uniform(0, 255), uniform(0, 255), uniform(0, 255));
+        switch (uniform(0, 2)) {
+            case 0:
+                cv::circle(img, center, extent, color, -1);
+                break;
+            case 1:
+                cv::rectangle(img, cv::Rect(center.x, center.y, extent, uniform(3, max_extent)),
+                              color, -1);
+                break;
+            default:
+                cv::line(img, center,
+                         cv::Point(center.x + uniform(-extent, extent) * 2,
+                                   center.y + uniform(-extent, extent) * 2),
+                         color, uniform(1, 3));
+                break;
+        }
+    }
+    return img;
+}
+
+std::string frame_name(const Spec& spec, std::uint64_t index) {
+    char name[64];
+    std::snprintf(name, sizeof(name), "synthetic-%06llu-%dx%d",
+                  static_cast<unsigned long long>(index), spec.size.width, spec.size.height);
+    return name;
+}
+
+}  // namespace synthetic
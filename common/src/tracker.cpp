@@ -0,0 +1,119 @@
+#include "common/tracker.hpp"
+
+#include <charconv>
+#include <cmath>
+#include <sstream>
+
+#include <opencv2/imgproc.hpp>
+#include <opencv2/video/tracking.hpp>
+
+namespace tracker {
+namespace {
+
+template <typename T>
+std::optional<T> parse_number(std::string_view text) {
+    T value{};
+    auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (ec != std::errc{} || ptr != text.data() + text.size()) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+}  // namespace
+
+std::optional<Config> parse(std::string_view spec) {
+    Config config;
+    if (auto colon = spec.find(':'); colon != std::string_view::npos) {
+        auto fraction = parse_number<double>(spec.substr(colon + 1));
+        if (!fraction || *fraction < 0.0 || *fraction > 1.0) {
+            return std::nullopt;
+        }
+        config.min_tracked = *fraction;
+        spec = spec.substr(0, colon);
+    }
+    auto interval = parse_number<int>(spec);
+    if (!interval || *interval < 1) {
+        return std::nullopt;
+    }
+    config.keyframe_interval = *interval;
+    return config;
+}
+
+std::string describe(const Config& config) {
+    std::ostringstream out;
+    out << config.keyframe_interval << ":" << config.min_tracked;
+    return out.str();
+}
+
+Tracker::Tracker(const detector::Config& detector, const Config& config)
+    : detector_(detector), config_(config) {}
+
+Kind Tracker::detect(const cv::Mat& gray, detector::Features& out) {
+    detector_.detect(gray, out);
+    prev_.keypoints = out.keypoints;
+    out.descriptors.copyTo(prev_.descriptors);
+    keyframe_points_ = out.keypoints.size();
+    since_keyframe_ = 0;
+    return Kind::Detected;
+}
+
+Kind Tracker::process(const cv::Mat& image, detector::Features& out, bool restart) {
+    cv::Mat gray = image;
+    if (image.channels() != 1) {
+        cv::cvtColor(image, gray_, image.channels() == 4 ? cv::COLOR_BGRA2GRAY : cv::COLOR_BGR2GRAY);
+        gray = gray_;
+    }
+    const cv::Size win(config_.window, config_.window);
+    std::swap(prev_pyramid_, pyramid_);
+    cv::buildOpticalFlowPyramid(gray, pyramid_, win, config_.levels);
+
+    const bool size_changed = prev_pyramid_.empty() || prev_pyramid_.front().size() != gray.size();
+    if (restart || size_changed || keyframe_points_ == 0 ||
+        ++since_keyframe_ >= config_.keyframe_interval) {
+        return detect(gray, out);
+    }
+
+    from_.clear();
+    for (const auto& kp : prev_.keypoints) {
+        from_.push_back(kp.pt);
+    }
+    cv::calcOpticalFlowPyrLK(prev_pyramid_, pyramid_, from_, to_, status_, error_, win, config_.levels);
+    // Forward-backward check: tracking the result back has to return to
+    // the starting point.
+    cv::calcOpticalFlowPyrLK(pyramid_, prev_pyramid_, to_, back_, back_status_, error_, win, config_.levels);
+
+    const float max_error_sq = config_.max_fb_error * config_.max_fb_error;
+    const auto cols = static_cast<float>(gray.cols);
+    const auto rows = static_cast<float>(gray.rows);
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i < from_.size(); ++i) {
+        const cv::Point2f d = back_[i] - from_[i];
+        const cv::Point2f& p = to_[i];
+        if (!status_[i] || !back_status_[i] || d.x * d.x + d.y * d.y > max_error_sq ||
+            p.x < 0.0f || p.y < 0.0f || p.x > cols - 1.0f || p.y > rows - 1.0f) {
+            continue;
+        }
+        cv::KeyPoint kp = prev_.keypoints[i];
+        kp.pt = p;
+        prev_.keypoints[kept] = kp;
+        if (kept != i && !prev_.descriptors.empty()) {
+            cv::Mat row = prev_.descriptors.row(static_cast<int>(kept));
+            prev_.descriptors.row(static_cast<int>(i)).copyTo(row);
+        }
+        ++kept;
+    }
+    if (static_cast<double>(kept) < config_.min_tracked * static_cast<double>(keyframe_points_)) {
+        return detect(gray, out);
+    }
+    prev_.keypoints.resize(kept);
+    out.keypoints = prev_.keypoints;
+    if (prev_.descriptors.empty()) {
+        out.descriptors.release();
+    } else {
+        prev_.descriptors.rowRange(0, static_cast<int>(kept)).copyTo(out.descriptors);
+    }
+    return Kind::Tracked;
+}
+
+}  // namespace tracker
@@ -2,12 +2,32 @@
 
 #include <cstddef>
 #include <cerrno>
+#include <filesystem>
 #include <iostream>
+#include <system_error>
 #include <zmq.h>
 
+#include "common/log.hpp"
+
 namespace zmq_utils {
 namespace {
 
+SendResult send_msg(void* socket, zmq_msg_t* msg, int flags, std::string_view what) {
+    int rc = zmq_msg_send(msg, socket, flags);
+    if (rc == -1) {
+        if (errno == EAGAIN) {
+            return SendResult::WouldBlock;
+        }
+        logging::error("Send failed: ", what, ": ", zmq_strerror(errno));
+        return SendResult::Error;
+    }
+    return SendResult::Ok;
+}
+
+void release_shared(void*, void* hint) {
+    delete static_cast<std::shared_ptr<const std::vector<unsigned char>>*>(hint);
+}
+
 SendResult send_raw(
     void* socket,
     const void* data,
@@ -20,7 +40,7 @@ SendResult send_raw(
         if (errno == EAGAIN) {
             return SendResult::WouldBlock;
         }
-        std::cerr << "[ERROR] " << what << " failed: " << zmq_strerror(errno) << "\n";
+        logging::error("Send failed: ", what, ": ", zmq_strerror(errno));
         return SendResult::Error;
     }
     return SendResult::Ok;
@@ -28,6 +48,100 @@ SendResult send_raw(
 
 }  // namespace
 
+int bind_endpoint(void* socket, const std::string& endpoint) {
+    constexpr std::string_view kIpcPrefix = "ipc://";
+    if (endpoint.compare(0, kIpcPrefix.size(), kIpcPrefix) == 0) {
+        std::error_code ec;
+        std::filesystem::remove(endpoint.substr(kIpcPrefix.size()), ec);
+    }
+    return zmq_bind(socket, endpoint.c_str());
+}
+
+bool set_hwm(void* socket, int sndhwm, int rcvhwm) {
+    if (zmq_setsockopt(socket, ZMQ_SNDHWM, &sndhwm, sizeof(sndhwm)) != 0 ||
+        zmq_setsockopt(socket, ZMQ_RCVHWM, &rcvhwm, sizeof(rcvhwm)) != 0) {
+        std::cerr << "[ERROR] zmq_setsockopt(HWM) failed: " << zmq_strerror(errno) << "\n";
+        return false;
+    }
+    return true;
+}
+
+bool set_receive_timeout(void* socket, int ms) {
+    if (zmq_setsockopt(socket, ZMQ_RCVTIMEO, &ms, sizeof(ms)) != 0) {
+        std::cerr << "[ERROR] zmq_setsockopt(RCVTIMEO) failed: " << zmq_strerror(errno) << "\n";
+        return false;
+    }
+    return true;
+}
+
+Message::Message() {
+    zmq_msg_init(&msg_);
+}
+
+Message::~Message() {
+    zmq_msg_close(&msg_);
+}
+
+Message::Message(Message&& other) noexcept : more_(other.more_) {
+    zmq_msg_init(&msg_);
+    zmq_msg_move(&msg_, &other.msg_);
+    other.more_ = false;
+}
+
+Message& Message::operator=(Message&& other) noexcept {
+    if (this != &other) {
+        zmq_msg_move(&msg_, &other.msg_);
+        more_ = other.more_;
+        other.more_ = false;
+    }
+    return *this;
+}
+
+std::span<const unsigned char> Message::bytes() const {
+    auto* msg = const_cast<zmq_msg_t*>(&msg_);
+    return {static_cast<const unsigned char*>(zmq_msg_data(msg)), zmq_msg_size(msg)};
+}
+
+std::string_view Message::view() const {
+    auto data = bytes();
+    return {reinterpret_cast<const char*>(data.data()), data.size()};
+}
+
+std::size_t Message::size() const {
+    return zmq_msg_size(&msg_);
+}
+
+std::optional<Message> recv_message(
+    void* socket,
+    int flags,
+    std::string_view what
+) {
+    Message msg;
+    int rc = zmq_msg_recv(&msg.msg_, socket, flags);
+    if (rc == -1) {
+        if (errno != EAGAIN) {
+            logging::error("Receive failed: ", what, ": ", zmq_strerror(errno));
+        }
+        return std::nullopt;
+    }
+    msg.more_ = zmq_msg_more(&msg.msg_) != 0;
+    return msg;
+}
+
+void skip_remaining_parts(void* socket) {
+    int more = 0;
+    std::size_t more_size = sizeof(more);
+    while (zmq_getsockopt(socket, ZMQ_RCVMORE, &more, &more_size) == 0 && more) {
+        zmq_msg_t msg;
+        zmq_msg_init(&msg);
+        int rc = zmq_msg_recv(&msg, socket, 0);
+        zmq_msg_close(&msg);
+        if (rc == -1) {
+            return;
+        }
+    }
+}
+
 std::optional<std::string> recv_string(
     void* socket,
     int flags,
@@ -37,7 +151,7 @@ std::optional<std::string> recv_string(
     zmq_msg_init(&msg);
     int rc = zmq_msg_recv(&msg, socket, flags);
     if (rc == -1) {
-        std::cerr << "[ERROR] " << what << " failed: " << zmq_strerror(errno) << "\n";
+        logging::error("Receive failed: ", what, ": ", zmq_strerror(errno));
         zmq_msg_close(&msg);
         return std::nullopt;
     }
@@ -58,7 +172,7 @@ std::optional<std::vector<unsigned char>> recv_bytes(
     zmq_msg_init(&msg);
     int rc = zmq_msg_recv(&msg, socket, flags);
     if (rc == -1) {
-        std::cerr << "[ERROR] " << what << " failed: " << zmq_strerror(errno) << "\n";
+        logging::error("Receive failed: ", what, ": ", zmq_strerror(errno));
         zmq_msg_close(&msg);
         return std::nullopt;
     }
@@ -86,4 +200,55 @@ SendResult send_bytes(
     return send_raw(socket, data.data(), data.size(), flags, what);
 }
 
+SendResult send_message(
+    void* socket,
+    Message& msg,
+    int flags,
+    std::string_view what
+) {
+    return send_msg(socket, msg.raw(), flags, what);
+}
+
+SendResult send_zero_copy(
+    void* socket,
+    std::span<const unsigned char> data,
+    zmq_free_fn* free_fn,
+    void* hint,
+    int flags,
+    std::string_view what
+) {
+    zmq_msg_t msg;
+    int rc = zmq_msg_init_data(
+        &msg,
+        const_cast<unsigned char*>(data.data()),
+        data.size(),
+        free_fn,
+        hint
+    );
+    if (rc == -1) {
+        std::cerr << "[ERROR] zmq_msg_init_data failed: " << zmq_strerror(errno) << "\n";
+        if (free_fn) {
+            free_fn(const_cast<unsigned char*>(data.data()), hint);
+        }
+        return SendResult::Error;
+    }
+    SendResult result = send_msg(socket, &msg, flags, what);
+    if (result != SendResult::Ok) {
+        // The message still owns the buffer; closing it runs free_fn.
+        zmq_msg_close(&msg);
+    }
+    return result;
+}
+
+SendResult send_shared(
+    void* socket,
+    std::shared_ptr<const std::vector<unsigned char>> buffer,
+    int flags,
+    std::string_view what
+) {
+    std::span<const unsigned char> data(*buffer);
+    auto* hint = new std::shared_ptr<const std::vector<unsigned char>>(std::move(buffer));
+    return send_zero_copy(socket, data, release_shared, hint, flags, what);
+}
+
 }  // namespace zmq_utils
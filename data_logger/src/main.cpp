@@ -1,122 +1,354 @@
 // data_logger: receives feature metadata + image bytes from ipc:///tmp/voyis-feature-stream.ipc
-// and stores them in a SQLite database (voyis_frames.db).
+// and stores them in a SQLite database (voyis_frames.db). With --fan-in it is
+// the sink for a pool of feature_extractor processes.
 
-#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <span>
 #include <vector>
 #include <string>
+#include <thread>
 #include <cerrno>
 
 #include <zmq.h>
-#include <sqlite3.h>
 #include <nlohmann/json.hpp>
+#include "common/alloc_counter.hpp"
+#include "common/blob_log.hpp"
+#include "common/bounded_queue.hpp"
+#include "common/cli_utils.hpp"
+#include "common/codec.hpp"
+#include "common/flow_control.hpp"
 #include "common/frame.hpp"
-#include "common/sqlite_utils.hpp"
+#include "common/frame_header.hpp"
+#include "common/frame_writer.hpp"
+#include "common/hash_utils.hpp"
+#include "common/latency.hpp"
+#include "common/log.hpp"
+#include "common/metrics.hpp"
+#include "common/shm_ring.hpp"
 #include "common/zmq_utils.hpp"
 
 namespace {
 constexpr char kFeatureStreamEndpoint[] = "ipc:///tmp/voyis-feature-stream.ipc";
+constexpr char kFeatureCreditEndpoint[] = "ipc:///tmp/voyis-feature-credit.ipc";
+constexpr std::size_t kDedupWindow = 1 << 16;
+constexpr long long kDefaultBatchFrames = 64;
+constexpr long long kDefaultBatchMs = 50;
+constexpr long long kDefaultQueueDepth = 256;
+constexpr long long kDefaultStatsSeconds = 10;
+constexpr long long kDefaultDedupCacheEntries = 1 << 16;
+constexpr long long kDefaultSegmentMb = 256;
+constexpr long long kDefaultLatencySeconds = 10;
+constexpr long long kDefaultHwm = 1000;
+// With --flow=credit a blocking receive gives up this often so owed credits
+// still go out while the link is idle.
+constexpr int kCreditPollMs = 100;
+
+// Drops frames whose (stream_id, seq_number) was already stored. Only the
+// last `window` seq_numbers of the current stream are tracked; a new
+// stream_id (generator restart) starts a fresh window.
+class SeqDeduplicator {
+public:
+    explicit SeqDeduplicator(std::size_t window) : seen_(window, false) {}
+
+    // Returns false for a duplicate. Frames older than the window cannot be
+    // checked any more and are accepted.
+    bool accept(std::uint64_t stream_id, std::int64_t seq) {
+        if (seq < 0) {
+            return true;
+        }
+        const auto window = static_cast<std::int64_t>(seen_.size());
+        if (!started_ || stream_id != stream_id_) {
+            std::fill(seen_.begin(), seen_.end(), false);
+            stream_id_ = stream_id;
+            max_seq_ = -1;
+            started_ = true;
+        }
+        if (seq > max_seq_) {
+            // Forget the slots that slide out of the window.
+            std::int64_t from = std::max(max_seq_ + 1, seq - window + 1);
+            for (std::int64_t s = from; s <= seq; ++s) {
+                seen_[static_cast<std::size_t>(s % window)] = false;
+            }
+            max_seq_ = seq;
+        } else if (max_seq_ - seq >= window) {
+            return true;
+        }
+        auto slot = static_cast<std::size_t>(seq % window);
+        if (seen_[slot]) {
+            return false;
+        }
+        seen_[slot] = true;
+        return true;
+    }
+
+private:
+    std::vector<bool> seen_;
+    std::uint64_t stream_id_ = 0;
+    std::int64_t max_seq_ = -1;
+    bool started_ = false;
+};
 }
 
 
-int main(){
-    auto db_opt = sqlite_utils::open("voyis_frames.db");
-    if(!db_opt)
+
+int main(int argc, char** argv){
+    cli_utils::Args args(argc, argv);
+    auto log_options = logging::options_from_args(args);
+    if (!log_options) {
         return 1;
-    sqlite_utils::DbPtr db = std::move(*db_opt);
-
-    const char* create_frames_sql = "CREATE TABLE IF NOT EXISTS frames ("
-        "  id INTEGER PRIMARY KEY AUTOINCREMENT,"
-        "  seq_number INTEGER,"
-        "  image_name TEXT,"
-        "  rows INTEGER,"
-        "  cols INTEGER,"
-        "  keypoint_count INTEGER,"
-        "  meta_json TEXT,"
-        "  image_bytes BLOB"
-        ");";
-
-    if(!sqlite_utils::exec(db.get(), create_frames_sql, "create frames table")){
+    }
+    logging::start(*log_options);
+    auto metrics_options = metrics::options_from_args(args);
+    if (!metrics_options) {
+        return 1;
+    }
+    // The writer adds frames_out, bytes_out and its commit timer.
+    metrics::Registry registry("logger");
+    metrics::Counter& frames_in = registry.counter("frames_in");
+    metrics::Counter& bytes_in = registry.counter("bytes_in");
+    metrics::Counter& decode_failures = registry.counter("decode_failures");
+    metrics::Counter& bad_meta = registry.counter("drops.bad_meta");
+    metrics::Counter& shm_gone = registry.counter("drops.shm_gone");
+    metrics::Counter& duplicate = registry.counter("drops.duplicate");
+    // Optional storage codec: payloads arriving in another encoding (for
+    // example raw_bgr8 on the wire) are transcoded before they are stored.
+    std::optional<codec::Options> store_codec;
+    if (auto spec = args.value("store-codec")) {
+        store_codec = codec::parse(*spec);
+        if (!store_codec) {
+            logging::error("Unknown --store-codec ", *spec);
+            return 1;
+        }
+    }
+    frame_writer::Options writer_options;
+    writer_options.batch_frames = static_cast<std::size_t>(
+        std::max(1LL, args.get_int("batch-frames", kDefaultBatchFrames)));
+    writer_options.batch_time = std::chrono::milliseconds(
+        std::max(0LL, args.get_int("batch-ms", kDefaultBatchMs)));
+    writer_options.stats_interval = std::chrono::seconds(
+        std::max(1LL, args.get_int("stats-interval", kDefaultStatsSeconds)));
+    writer_options.dedup_images = args.get("image-store", "dedup") != "inline";
+    writer_options.dedup_cache_entries = static_cast<std::size_t>(
+        std::max(1LL, args.get_int("dedup-cache", kDefaultDedupCacheEntries)));
+    writer_options.latency_interval = std::chrono::seconds(
+        std::max(1LL, args.get_int("latency-interval", kDefaultLatencySeconds)));
+    writer_options.metrics = &registry;
+    const auto queue_depth = static_cast<std::size_t>(
+        std::max(1LL, args.get_int("queue-depth", kDefaultQueueDepth)));
+    const bool debug_meta = args.has("debug-meta");
+    auto flow = flow_control::parse_mode(args.get("flow", "none"));
+    if (!flow) {
         return 1;
     }
 
-    const char* insert_sql = 
-        "INSERT INTO frames ("
-        "  seq_number, image_name, rows, cols, keypoint_count, meta_json, image_bytes"
-        ") VALUES (?, ?, ?, ?, ?, ?, ?);";
+    // Optional segmented blob log: payloads are appended to
+    // <blob-dir>/segment-XXXXXXXX.blob and SQLite keeps only their location,
+    // which keeps the tables small and metadata scans fast.
+    std::optional<blob_log::Writer> blobs;
+    if (auto blob_dir = args.value("blob-dir")) {
+        const auto segment_bytes = static_cast<std::uint64_t>(
+            std::max(1LL, args.get_int("segment-mb", kDefaultSegmentMb))) << 20;
+        blobs = blob_log::Writer::open(*blob_dir, segment_bytes);
+        if (!blobs) {
+            return 1;
+        }
+        logging::info("Appending image payloads to blob log ", *blob_dir, " (segments of ",
+                      (segment_bytes >> 20), " MiB)");
+    }
+    const bool hash_payloads = writer_options.dedup_images || blobs.has_value();
 
-    auto insert_stmt_opt = sqlite_utils::prepare(db.get(), insert_sql, "prepare insert");
-    if(!insert_stmt_opt){
+    auto database = frame_writer::open_database("voyis_frames.db", writer_options);
+    if(!database){
         return 1;
     }
-    sqlite_utils::StatementPtr insert_stmt = std::move(*insert_stmt_opt);
 
+    // With --fan-in the logger is the sink that a pool of extractors connects
+    // to; PULL fair-queues their streams into one.
+    const bool fan_in = args.has("fan-in");
+    std::string input_endpoint = args.get("input", kFeatureStreamEndpoint);
     void* context = zmq_ctx_new();
     void* pull_socket = zmq_socket(context, ZMQ_PULL);
-    int rc_pull = zmq_connect(pull_socket, kFeatureStreamEndpoint);
+    const int rcvhwm = static_cast<int>(std::max(1LL, args.get_int("rcvhwm", kDefaultHwm)));
+    if(!zmq_utils::set_hwm(pull_socket, rcvhwm, rcvhwm)){
+        return 1;
+    }
+    int rc_pull = fan_in ? zmq_utils::bind_endpoint(pull_socket, input_endpoint)
+                         : zmq_connect(pull_socket, input_endpoint.c_str());
     if(rc_pull != 0){
-        std::cerr << "Failed to connect to the ZMQ PULL socket: " << zmq_strerror(errno) << "\n";
+        logging::error("Failed to connect to the ZMQ PULL socket: ", zmq_strerror(errno));
         zmq_close(pull_socket);
         zmq_ctx_term(context);
         return 0; 
     }
-    std::cout << "Connected the ZMQ PULL socket to " << kFeatureStreamEndpoint << "\n";
+    logging::info("ZMQ PULL socket ", fan_in ? "bound on " : "connected to ", input_endpoint);
+
+    // With --flow=credit the logger grants the extractors one credit per
+    // frame it can queue (the queue depth by default). The credit endpoint is
+    // bound by whichever side binds the feature stream.
+    std::optional<flow_control::CreditGrant> credit;
+    if(*flow == flow_control::Mode::Credit){
+        const std::string credit_endpoint = args.get("credit-endpoint", kFeatureCreditEndpoint);
+        credit = flow_control::CreditGrant::open(
+            context, credit_endpoint, fan_in,
+            static_cast<std::uint32_t>(std::max(1LL, args.get_int(
+                "credit-window", static_cast<long long>(queue_depth)))));
+        if(!credit || !zmq_utils::set_receive_timeout(pull_socket, kCreditPollMs)){
+            return 1;
+        }
+        logging::info("Granting credits on ", credit_endpoint);
+    }
+
+    // Receiving stays on this thread; SQLite work happens on the writer
+    // thread. When the queue fills up the receive loop blocks, and ZeroMQ's
+    // high-water marks push the backpressure upstream.
+    BoundedQueue<frame_writer::Record> queue(queue_depth);
+    frame_writer::Writer writer(database->db.get(), std::move(database->statements),
+                                writer_options, std::move(blobs));
+    std::thread writer_thread([&] { writer.run(queue); });
+    registry.gauge("queue.in.writer", [&queue] { return static_cast<std::int64_t>(queue.size()); },
+                   static_cast<std::int64_t>(queue_depth));
+    metrics::Publisher publisher(registry, *metrics_options);
+    logging::info("Writer batches up to ", writer_options.batch_frames, " frame(s) or ",
+                  writer_options.batch_time.count(), " ms, queue depth ", queue_depth);
+
+    SeqDeduplicator dedup(kDedupWindow);
+    std::uint64_t duplicates = 0;
+    shm_ring::Consumer ring;
+    // Reused across frames by --store-codec transcoding: the decoded image
+    // and the encoded bytes, which stay in flight until the writer is done.
+    cv::Mat decoded;
+    const auto pools = frame_writer::RecordPools::create(queue_depth + 1);
+    alloc_counter::Reporter allocations("logger", std::chrono::seconds(
+        std::max(1LL, args.get_int("latency-interval", kDefaultLatencySeconds))));
+    if (alloc_counter::enabled()) {
+        logging::info("Counting heap allocations per frame");
+    }
+    logging::InfoStream report_out;
 
     while(true){
-        auto metadata_str_opt = zmq_utils::recv_string(
+        if (credit) {
+            credit->flush();
+        }
+        auto meta_msg = zmq_utils::recv_message(
             pull_socket,
             0,
             "zmq_msg_recv(meta)"
         );
-        if (!metadata_str_opt) {
+        if (!meta_msg) {
             continue;
         }
-        auto meta_opt = FrameMetadata::from_json(*metadata_str_opt);
+        frames_in.add();
+        // Each frame is handled completely, up to the blocking queue push,
+        // before the next flush, so it can count as consumed on arrival.
+        if (credit) {
+            credit->on_received();
+            credit->on_consumed();
+        }
+        auto meta_opt = frame_header::decode(meta_msg->bytes());
         if (!meta_opt) {
-            std::cerr << "[ERROR] Failed to parse metadata JSON\n";
+            bad_meta.add();
+            logging::error("Failed to decode frame metadata");
+            zmq_utils::skip_remaining_parts(pull_socket);
             continue;
         }
-        FrameMetadata meta = *meta_opt;
-        std::cout << "Received meta: " << meta.to_json().dump() << "\n";
+        FrameMetadata meta = std::move(*meta_opt);
+        if (debug_meta) {
+            logging::info("Received meta: ", [&] { return meta.to_json().dump(); });
+        }
 
-        auto buf_opt = zmq_utils::recv_bytes(
+        auto image_msg = zmq_utils::recv_message(
             pull_socket,
             0,
             "zmq_msg_recv(image)"
         );
-        if (!buf_opt) {
+        if (!image_msg) {
             continue;
         }
-        std::vector<unsigned char> buf = std::move(*buf_opt);
-        std::cout<< buf.size()<<"\n";
-        std::cout << "Received image buffer size: " << buf.size() << "\n";
-        int seq_number = meta.seq_number;
-        std::string name = meta.image_name;
-        int rows = meta.rows;
-        int cols = meta.cols;
-        int kp_count = meta.keypoint_count;
-
-        sqlite_utils::reset(insert_stmt.get());
-        int idx = 1;
-
-        sqlite3_bind_int(insert_stmt.get(), idx++, seq_number);
-        sqlite3_bind_text(insert_stmt.get(), idx++,  name.c_str(), -1, SQLITE_TRANSIENT);
-        sqlite3_bind_int(insert_stmt.get(),   idx++, rows);
-        sqlite3_bind_int(insert_stmt.get(),   idx++, cols);
-        sqlite3_bind_int(insert_stmt.get(),   idx++, kp_count);
-        sqlite3_bind_text(insert_stmt.get(),  idx++, metadata_str_opt->c_str(), -1, SQLITE_TRANSIENT);
-        sqlite3_bind_blob(insert_stmt.get(),  idx++, buf.data(),
-                          static_cast<int>(buf.size()), SQLITE_TRANSIENT);
-
-        if (!sqlite_utils::step(insert_stmt.get(), "sqlite3_step(insert frame)")) {
+        std::optional<zmq_utils::Message> keypoints_msg;
+        if (image_msg->more()) {
+            keypoints_msg = zmq_utils::recv_message(
+                pull_socket,
+                0,
+                "zmq_msg_recv(keypoints)"
+            );
+            if (!keypoints_msg) {
+                continue;
+            }
+            if (keypoints_msg->more()) {
+                zmq_utils::skip_remaining_parts(pull_socket);
+            }
+        }
+        // Taken before the duplicate check so a dropped frame frees its slot.
+        std::optional<shm_ring::Lease> lease;
+        if (meta.flags & kFlagShmPayload) {
+            auto desc = shm_ring::decode(image_msg->bytes());
+            if (desc) {
+                lease = ring.open(*desc);
+            }
+            if (!lease) {
+                shm_gone.add();
+                logging::error("Dropping seq=", meta.seq_number, ": its shared-memory payload is gone");
+                continue;
+            }
+        }
+        bytes_in.add(lease ? lease->bytes().size() : image_msg->size());
+        if (!dedup.accept(meta.stream_id, meta.seq_number)) {
+            ++duplicates;
+            duplicate.add();
+            logging::warn("Dropping duplicate frame seq=", meta.seq_number, " from ",
+                          meta.extractor_id, " (", duplicates, " so far)");
             continue;
         }
+        logging::debug("Received seq=", meta.seq_number, " image buffer size: ",
+                       (lease ? lease->bytes().size() : image_msg->size()), (lease ? " (shm)" : ""),
+                       (meta.flags & kFlagShed ? " (shed by the extractor)" : ""));
+        meta.t.log_recv = latency::now_ns();
 
-        std::cout << "Inserted frame seq=" << seq_number
-                  << " with " << kp_count
-                  << " keypoints into database.\n";
-    }
+        frame_writer::Record record{std::move(meta), std::move(*meta_msg), std::move(*image_msg),
+                           std::move(lease), {}, {}, std::move(keypoints_msg), {}, {}};
+        // Shed frames are metadata-only records; there is nothing to transcode or hash.
+        const bool shed = (record.meta.flags & kFlagShed) != 0;
+        if (!shed && store_codec && record.meta.encoding != codec::encoding_name(store_codec->kind)) {
+            record.transcoded = pools.payloads->acquire();
+            const bool decoded_ok = codec::decode(record.meta.encoding, record.payload(),
+                                                  record.meta.rows, record.meta.cols, decoded);
+            // A slot reclaimed by the generator mid-decode may have been overwritten.
+            if (record.lease && !record.lease->valid()) {
+                shm_gone.add();
+                logging::error("Shared-memory slot for seq=", record.meta.seq_number,
+                               " was reclaimed while decoding");
+                continue;
+            }
+            if (decoded_ok && codec::encode(decoded, *store_codec, record.transcoded.vec())) {
+                record.meta.encoding = std::string(codec::encoding_name(store_codec->kind));
+                record.lease.reset();
+            } else {
+                if (!decoded_ok) {
+                    decode_failures.add();
+                }
+                record.transcoded.clear();
+                logging::warn("Failed to transcode frame seq=", record.meta.seq_number, " from ",
+                              record.meta.encoding, ", storing as received");
+            }
+        }
 
+        // Hashing here keeps it off the writer thread. The blob log checksum is
+        // the low 32 bits of the same hash.
+        if (hash_payloads && !shed) {
+            record.image_hash = hash_utils::hash128(record.payload());
+        }
+
+        if (!queue.push(std::move(record))) {
+            break;
+        }
+        allocations.frame();
+        allocations.maybe_report(report_out);
+    }
 
+    queue.close();
+    writer_thread.join();
     zmq_close(pull_socket);
     zmq_ctx_term(context);
 
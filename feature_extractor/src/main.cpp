@@ -1,100 +1,536 @@
 // feature_extractor: receives images from ipc:///tmp/voyis-image-stream.ipc (PULL),
 // runs SIFT, adds keypoint metadata, and forwards to ipc:///tmp/voyis-feature-stream.ipc.
-#include <iostream>
+//
+// Frames flow receive thread -> N SIFT workers -> sender. The sender puts
+// results back into arrival order before forwarding them to the logger.
 #include <zmq.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <thread>
 #include <vector>
 #include <nlohmann/json.hpp>
 #include <opencv2/opencv.hpp>
-#include <filesystem>
-#include <system_error>
 #include <cerrno>           
+#include <cstdio>
+#include <unistd.h>
+#include "common/alloc_counter.hpp"
+#include "common/bounded_queue.hpp"
+#include "common/buffer_pool.hpp"
+#include "common/cli_utils.hpp"
+#include "common/codec.hpp"
+#include "common/detector.hpp"
+#include "common/flow_control.hpp"
 #include "common/frame.hpp"
+#include "common/frame_header.hpp"
+#include "common/hash_utils.hpp"
+#include "common/keypoint_block.hpp"
+#include "common/latency.hpp"
+#include "common/log.hpp"
+#include "common/lru_cache.hpp"
+#include "common/metrics.hpp"
+#include "common/shm_ring.hpp"
+#include "common/tracker.hpp"
 #include "common/zmq_utils.hpp"
 
 
 namespace {
 constexpr char kImageStreamEndpoint[] = "ipc:///tmp/voyis-image-stream.ipc";
 constexpr char kFeatureStreamEndpoint[] = "ipc:///tmp/voyis-feature-stream.ipc";
-constexpr char kFeatureStreamPath[] = "/tmp/voyis-feature-stream.ipc";
+constexpr char kImageCreditEndpoint[] = "ipc:///tmp/voyis-image-credit.ipc";
+constexpr char kFeatureCreditEndpoint[] = "ipc:///tmp/voyis-feature-credit.ipc";
+constexpr long long kDefaultLatencySeconds = 10;
+constexpr long long kDefaultSendQueue = 8;
+constexpr long long kDefaultHwm = 1000;
+// Off by default: live camera payloads never repeat, so the cache would
+// only cost a payload hash per frame and resident memory.
+constexpr long long kDefaultFeatureCacheMb = 0;
+// How long the sender waits for a result before servicing the credit links.
+constexpr std::chrono::milliseconds kSenderPollInterval{50};
+
+// Per-process settings shared read-only by all workers.
+struct ExtractorConfig {
+    // By default the received payload is forwarded untouched; a forward codec
+    // re-encodes the decoded image for the logger link instead.
+    std::optional<codec::Options> forward_codec;
+    // Stamped into every forwarded frame so the logger can report how the
+    // load is spread over a pool of extractors.
+    std::string extractor_id;
+    // Keypoints go out as a packed binary block (its own message part) unless
+    // the legacy JSON array in the metadata is requested.
+    bool json_keypoints = false;
+    keypoint_block::DescriptorFormat descriptors = keypoint_block::DescriptorFormat::None;
+    // Metadata goes out as a frame_header unless JSON is requested (or
+    // implied by JSON keypoints, which live in the JSON metadata).
+    frame_header::Format meta_format = frame_header::Format::Binary;
+    // Print every received frame's metadata rendered as JSON.
+    bool debug_meta = false;
+    // Detection tier; recorded in every frame as FrameMetadata::detector.
+    detector::Config detector;
+    std::string detector_name;
+    // Freshness limits (--max-age-ms, --degrade-age-ms, --max-backlog); 0
+    // disables each. Frames older than max_age_ns, or arriving with
+    // max_backlog frames ahead of them, are shed; frames older than
+    // degrade_age_ns run on the cheaper degrade_detector tier.
+    std::uint64_t max_age_ns = 0;
+    std::uint64_t degrade_age_ns = 0;
+    std::uint64_t max_backlog = 0;
+    // Age counts from the generator's send stamp, which only compares with
+    // ours on the same host; otherwise from our own receive stamp.
+    bool age_from_send = true;
+    // Forward shed frames as metadata-only records (--shed=record) rather
+    // than dropping them (--shed=skip).
+    bool shed_records = true;
+    detector::Config degrade_detector;
+    std::string degrade_detector_name;
+    // --track: detect on keyframes only and follow the keypoints with
+    // optical flow in between. Needs a single worker.
+    std::optional<tracker::Config> tracking;
+};
+
+std::string default_extractor_id(){
+    char host[256] = {};
+    if (gethostname(host, sizeof(host) - 1) != 0) {
+        std::snprintf(host, sizeof(host), "localhost");
+    }
+    return std::string(host) + "-" + std::to_string(getpid());
 }
 
-int main(){
+// A frame handed from the receive thread to the SIFT workers. Tickets are
+// assigned in arrival order, which is seq_number order for a PUSH stream,
+// and keep counting across seq_number gaps or generator restarts.
+struct WorkItem {
+    std::uint64_t ticket{};
+    FrameMetadata meta;
+    // The image part; a shm_ring descriptor when `lease` is set.
+    zmq_utils::Message image;
+    // The payload's slot for frames sent over the shared-memory ring.
+    std::optional<shm_ring::Lease> lease;
+};
 
-    void* context = zmq_ctx_new();
-    void* pull_socket = zmq_socket(context, ZMQ_PULL);
-    void* push_socket = zmq_socket(context, ZMQ_PUSH);
+// What a worker produced for one frame. Failed frames are not forwarded but
+// still pass through the reorder buffer so later tickets are not held up.
+struct FrameResult {
+    bool ok = false;
+    FrameMetadata meta;
+    // Per-keypoint array for --keypoints=json; null otherwise. The metadata
+    // itself is serialized by the sender so it can carry the send stamp.
+    nlohmann::json keypoints_json;
+    zmq_utils::Message image;
+    // Kept until the descriptor in `image` is forwarded, then owned by the
+    // logger. Released here when the frame is re-encoded or dropped.
+    std::optional<shm_ring::Lease> lease;
+    // Both buffers come from the workers' pools and go back to them once
+    // the sender is done with the result.
+    BufferPool::Buffer reencoded;
+    // Binary keypoint block; empty with --keypoints=json.
+    BufferPool::Buffer keypoints;
+};
 
-    int rc_pull = zmq_connect(pull_socket, kImageStreamEndpoint);
-    std::error_code remove_ec;
-    std::filesystem::remove(kFeatureStreamPath, remove_ec);
-    int rc_push = zmq_bind(push_socket, kFeatureStreamEndpoint);
+// Everything process_frame derives from a payload, which is all a repeated
+// payload needs: keypoints in their wire form and the re-encoded image.
+struct ExtractedFeatures {
+    int keypoint_count{};
+    // Moved by optical flow from the last keyframe rather than detected.
+    bool tracked = false;
+    nlohmann::json keypoints_json;
+    BufferPool::Buffer keypoints;
+    // Set when the frame was re-encoded for --forward-codec.
+    std::string encoding;
+    BufferPool::Buffer reencoded;
 
-    if(rc_pull != 0){
-        std::cerr << "Faild to connect to the ZMQ PULL socket: " << zmq_strerror(errno) << "\n";
-        return 0; 
+    // Approximate heap footprint, charged against the cache budget.
+    std::size_t cost() const {
+        constexpr std::size_t kEntryOverhead = 256;
+        constexpr std::size_t kJsonKeypointBytes = 96;
+        return kEntryOverhead + keypoints.size() + reencoded.size() + encoding.size() +
+               (keypoints_json.is_null() ? 0 : static_cast<std::size_t>(keypoint_count) * kJsonKeypointBytes);
     }
+};
 
-    std::cout << "Connected the ZMQ PULL socket to " << kImageStreamEndpoint << "\n";
+// Results of recent payloads keyed by content hash, shared by the workers.
+// Replay loops and static cameras send byte-identical frames; a hit skips
+// decoding and detection. Two workers that miss on the same payload at once
+// both compute it, which is harmless.
+class FeatureCache {
+public:
+    FeatureCache(std::size_t budget_bytes, std::chrono::seconds interval)
+        : entries_(budget_bytes), interval_(interval),
+          next_report_(std::chrono::steady_clock::now() + interval) {}
 
-    if(rc_push != 0){
-      std::cerr << "Faild to connect to the ZMQ PUSH socket:" << zmq_strerror(errno) <<"\n";
-      return 0;
+    // The hash covers the frame geometry and codec as well, since raw
+    // payloads only make an image together with them.
+    static hash_utils::Hash128 key(const FrameMetadata& meta, std::span<const unsigned char> payload) {
+        const std::uint64_t seed = (static_cast<std::uint64_t>(static_cast<std::uint32_t>(meta.rows)) << 32 |
+                                    static_cast<std::uint32_t>(meta.cols)) ^
+                                   std::hash<std::string>{}(meta.encoding);
+        return hash_utils::hash128(payload, seed);
+    }
+
+    std::shared_ptr<const ExtractedFeatures> find(const hash_utils::Hash128& key) {
+        std::shared_ptr<const ExtractedFeatures> found;
+        {
+            std::lock_guard lock(mutex_);
+            if (auto* entry = entries_.get(key)) {
+                found = *entry;
+            }
+        }
+        (found ? hits_ : misses_).fetch_add(1, std::memory_order_relaxed);
+        return found;
+    }
+
+    void insert(const hash_utils::Hash128& key, std::shared_ptr<const ExtractedFeatures> features) {
+        const std::size_t cost = features->cost();
+        std::lock_guard lock(mutex_);
+        entries_.put(key, std::move(features), cost);
+    }
+
+    // Prints the counters once the interval has passed; sender thread only.
+    void maybe_report(std::ostream& out) {
+        const auto now = std::chrono::steady_clock::now();
+        if (now < next_report_) {
+            return;
+        }
+        next_report_ = now + interval_;
+        const auto hits = hits_.load(std::memory_order_relaxed);
+        const auto misses = misses_.load(std::memory_order_relaxed);
+        std::lock_guard lock(mutex_);
+        out << "Feature cache: hits=" << hits << " misses=" << misses
+            << " hit_rate=" << (hits + misses ? 100 * hits / (hits + misses) : 0) << "%"
+            << " entries=" << entries_.size()
+            << " used_mb=" << entries_.used() / (1024 * 1024)
+            << "/" << entries_.budget() / (1024 * 1024)
+            << " evictions=" << entries_.evictions() << "\n";
+    }
+
+private:
+    std::mutex mutex_;
+    LruCache<hash_utils::Hash128, std::shared_ptr<const ExtractedFeatures>, hash_utils::Hash128Hasher> entries_;
+    std::atomic<std::uint64_t> hits_{0};
+    std::atomic<std::uint64_t> misses_{0};
+    const std::chrono::steady_clock::duration interval_;
+    std::chrono::steady_clock::time_point next_report_;
+};
+
+// Frames shed or degraded by the freshness limits, counted by the receive
+// thread and the workers and printed by the sender.
+class ShedCounters {
+public:
+    explicit ShedCounters(std::chrono::seconds interval)
+        : interval_(interval), next_report_(std::chrono::steady_clock::now() + interval) {}
+
+    void count(std::uint32_t reason) {
+        (reason == kFlagShedAge ? age_ : backlog_).fetch_add(1, std::memory_order_relaxed);
+    }
+    void count_degraded() { degraded_.fetch_add(1, std::memory_order_relaxed); }
+
+    std::uint64_t age() const { return age_.load(std::memory_order_relaxed); }
+    std::uint64_t backlog() const { return backlog_.load(std::memory_order_relaxed); }
+
+    void maybe_report(std::ostream& out) {
+        const auto now = std::chrono::steady_clock::now();
+        if (now < next_report_) {
+            return;
+        }
+        next_report_ = now + interval_;
+        out << "Shedding: shed_age=" << age()
+            << " shed_backlog=" << backlog()
+            << " degraded=" << degraded_.load(std::memory_order_relaxed) << "\n";
+    }
+
+private:
+    std::atomic<std::uint64_t> age_{0};
+    std::atomic<std::uint64_t> backlog_{0};
+    std::atomic<std::uint64_t> degraded_{0};
+    const std::chrono::steady_clock::duration interval_;
+    std::chrono::steady_clock::time_point next_report_;
+};
+
+// The live metrics (common/metrics.hpp) counted along the way by the
+// receive thread, the workers and the sender. Shed frames are counted from
+// ShedCounters.
+struct ExtractorMetrics {
+    metrics::Counter& frames_in;
+    metrics::Counter& bytes_in;
+    metrics::Counter& frames_out;
+    metrics::Counter& bytes_out;
+    metrics::Counter& decode_failures;
+    metrics::Counter& bad_meta;
+    metrics::Counter& shm_gone;
+    // Re-encoding or keypoint packing failed.
+    metrics::Counter& extract_failed;
+    metrics::Timer& detect;
+
+    explicit ExtractorMetrics(metrics::Registry& registry)
+        : frames_in(registry.counter("frames_in")),
+          bytes_in(registry.counter("bytes_in")),
+          frames_out(registry.counter("frames_out")),
+          bytes_out(registry.counter("bytes_out")),
+          decode_failures(registry.counter("decode_failures")),
+          bad_meta(registry.counter("drops.bad_meta")),
+          shm_gone(registry.counter("drops.shm_gone")),
+          extract_failed(registry.counter("drops.extract_failed")),
+          detect(registry.timer("detect")) {}
+};
+
+// Time the frame has waited so far, in nanoseconds.
+std::uint64_t frame_age_ns(const StageTimestamps& t, const ExtractorConfig& config, std::uint64_t now) {
+    std::uint64_t origin = t.ext_recv;
+    if (config.age_from_send && t.gen_send != 0 && t.gen_send <= now) {
+        origin = t.gen_send;
+    }
+    return origin != 0 && origin <= now ? now - origin : 0;
+}
+
+// What is forwarded for a frame shed for `reason`: metadata only, flagged
+// so the logger still records its place in the sequence. Not forwarded at
+// all (ok stays false) with --shed=skip. A shared-memory slot is freed with
+// the item.
+FrameResult shed_frame(WorkItem& item, std::uint32_t reason, ShedCounters& shed,
+                       const ExtractorConfig& config) {
+    shed.count(reason);
+    FrameResult result;
+    if (!config.shed_records) {
+        return result;
+    }
+    result.meta = std::move(item.meta);
+    result.meta.flags = (result.meta.flags & ~kFlagShmPayload) | reason;
+    result.meta.data_bytes = 0;
+    result.meta.keypoint_count = 0;
+    result.meta.extractor_id = config.extractor_id;
+    result.ok = true;
+    return result;
+}
+
+// Restores arrival order between the workers and the sender. At most
+// `window` tickets may be in flight, which bounds the frames (and their
+// image buffers) held in memory when one frame is slow.
+class ReorderBuffer {
+public:
+    explicit ReorderBuffer(std::size_t window) : window_(window) {}
+
+    // Blocks the receive thread until `ticket` fits in the window.
+    void wait_for_slot(std::uint64_t ticket) {
+        std::unique_lock lock(mutex_);
+        slot_free_.wait(lock, [&] { return ticket < next_ + window_; });
+    }
+
+    void put(std::uint64_t ticket, FrameResult result) {
+        std::lock_guard lock(mutex_);
+        pending_.emplace(ticket, std::move(result));
+        if (ticket == next_) {
+            ready_.notify_one();
+        }
+    }
+
+    // Tickets before `ticket` that the sender has not taken yet.
+    std::uint64_t ahead_of(std::uint64_t ticket) {
+        std::lock_guard lock(mutex_);
+        return ticket > next_ ? ticket - next_ : 0;
+    }
+
+    // Waits up to `timeout` for the result of the next ticket in order.
+    std::optional<FrameResult> take_next_for(std::chrono::milliseconds timeout) {
+        std::unique_lock lock(mutex_);
+        if (!ready_.wait_for(lock, timeout, [&] {
+                return !pending_.empty() && pending_.begin()->first == next_;
+            })) {
+            return std::nullopt;
+        }
+        auto node = pending_.extract(pending_.begin());
+        ++next_;
+        slot_free_.notify_one();
+        return std::move(node.mapped());
     }
-    std::cout << "ZMQ push socket bound on " << kFeatureStreamEndpoint << "\n";
 
-    auto sift = cv::SIFT::create();
+private:
+    const std::size_t window_;
+    std::mutex mutex_;
+    std::condition_variable ready_;
+    std::condition_variable slot_free_;
+    std::map<std::uint64_t, FrameResult> pending_;
+    std::uint64_t next_ = 0;
+};
+
+// `credit` (--flow=credit) counts every frame that arrives; frames that
+// fail here are consumed at once, the rest once the sender is done with them.
+//
+// Frames over the freshness limits are shed here, before they wait for a
+// slot in the window, so a backlog queued in the socket drains at the cost
+// of a metadata decode per frame instead of a detection run.
+void receive_loop(void* pull_socket, BoundedQueue<WorkItem>& work, ReorderBuffer& reorder,
+                  flow_control::CreditGrant* credit, ShedCounters& shed,
+                  const ExtractorMetrics& counters, const ExtractorConfig& config){
+    std::uint64_t next_ticket = 0;
+    shm_ring::Consumer ring;
     while(true){
-        auto metadata_str_opt = zmq_utils::recv_string(
+        auto meta_msg = zmq_utils::recv_message(
             pull_socket,
             0,
             "zmq_msg_recv(meta)"
         );
-        if (!metadata_str_opt) {
+        if (!meta_msg) {
             continue;
         }
-        auto meta_opt = FrameMetadata::from_json(*metadata_str_opt);
+        counters.frames_in.add();
+        if (credit) {
+            credit->on_received();
+        }
+        auto meta_opt = frame_header::decode(meta_msg->bytes());
         if (!meta_opt) {
-            std::cerr << "[ERROR] Failed to parse metadata JSON\n";
+            counters.bad_meta.add();
+            logging::error("Failed to decode frame metadata");
+            zmq_utils::skip_remaining_parts(pull_socket);
+            if (credit) {
+                credit->on_consumed();
+            }
             continue;
         }
-        FrameMetadata meta = *meta_opt;
-        std::cout << "Received meta: " << meta.to_json().dump() << "\n";
-
-        
+        if (config.debug_meta) {
+            logging::info("Received meta: ", [&] { return meta_opt->to_json().dump(); });
+        }
 
-        auto buf_opt = zmq_utils::recv_bytes(
+        // The image stays in the received zmq message: it is decoded in place
+        // and, unless re-encoded, handed back to ZeroMQ for the logger link.
+        auto image_msg = zmq_utils::recv_message(
             pull_socket,
             0,
             "zmq_msg_recv(image)"
         );
-        if (!buf_opt) {
+        if (!image_msg) {
+            if (credit) {
+                credit->on_consumed();
+            }
             continue;
         }
-        std::vector<unsigned char> buf = std::move(*buf_opt);
-        std::cout<< buf.size()<<"\n";
-        std::cout << "Received image buffer size: " << buf.size() << "\n";
+        std::optional<shm_ring::Lease> lease;
+        if (meta_opt->flags & kFlagShmPayload) {
+            auto desc = shm_ring::decode(image_msg->bytes());
+            if (desc) {
+                lease = ring.open(*desc);
+            }
+            if (!lease) {
+                counters.shm_gone.add();
+                logging::error("Dropping seq=", meta_opt->seq_number, ": its shared-memory payload is gone");
+                if (credit) {
+                    credit->on_consumed();
+                }
+                continue;
+            }
+        }
+        const std::size_t payload_bytes = lease ? lease->bytes().size() : image_msg->size();
+        counters.bytes_in.add(payload_bytes);
+        logging::debug("Received seq=", meta_opt->seq_number, " image buffer size: ", payload_bytes,
+                       (lease ? " (shm)" : ""));
+        meta_opt->t.ext_recv = latency::now_ns();
 
-        cv::Mat img = cv::imdecode(buf, cv::IMREAD_COLOR);
-        if(img.empty()){
-            std::cerr << "[ERROR] Failed to decode received image." <<"\n";
+        WorkItem item{next_ticket++, std::move(*meta_opt), std::move(*image_msg), std::move(lease)};
+        std::uint32_t reason = 0;
+        if (config.max_age_ns != 0 &&
+            frame_age_ns(item.meta.t, config, item.meta.t.ext_recv) > config.max_age_ns) {
+            reason = kFlagShedAge;
+        } else if (config.max_backlog != 0 && reorder.ahead_of(item.ticket) >= config.max_backlog) {
+            reason = kFlagShedBacklog;
+        }
+        if (reason != 0) {
+            // Shed results are small, so they may run past the window.
+            reorder.put(item.ticket, shed_frame(item, reason, shed, config));
             continue;
         }
-        std::cout << "Decoded image: " << img.cols << "x" << img.rows << "\n";
-        std::vector <cv::KeyPoint> keypoints;
-        cv::Mat desc;
+        reorder.wait_for_slot(item.ticket);
+        if (!work.push(std::move(item))) {
+            return;
+        }
+    }
+}
 
-        sift->detectAndCompute(img, cv::noArray(), keypoints, desc);
+// A worker's optical-flow state for --track. It follows consecutive frames
+// of one stream; any gap, such as a shed, degraded or cached frame, or a
+// generator restart, makes the next frame a keyframe.
+struct TrackingState {
+    tracker::Tracker tracker;
+    std::uint64_t stream_id = 0;
+    std::optional<int> last_seq;
+};
 
-        std::cout << "Extracted " << keypoints.size()
-                    << " keypoints for seq="
-                    << meta.seq_number
-                    << "\n";
+// A worker's per-frame working memory, kept across frames: once the first
+// frames have sized them, decoding and detection reuse these buffers and
+// the output bytes come from pools shared by all workers, one per kind so
+// each settles at its own size.
+struct WorkerScratch {
+    std::shared_ptr<BufferPool> image_buffers;
+    std::shared_ptr<BufferPool> keypoint_buffers;
+    cv::Mat img;
+    detector::Features features;
+};
 
-        FrameMetadata out_meta = meta;
-        out_meta.keypoint_count = static_cast<int>(keypoints.size());
+// Decodes the payload and runs detection, or tracking when `tracking` is
+// given. False if the frame is dropped.
+bool extract(
+    WorkItem& item,
+    detector::Detector& detector,
+    TrackingState* tracking,
+    WorkerScratch& scratch,
+    const ExtractorMetrics& counters,
+    const ExtractorConfig& config,
+    ExtractedFeatures& out
+){
+    const auto& forward_codec = config.forward_codec;
+    FrameMetadata& meta = item.meta;
+    std::span<const unsigned char> buf = item.lease ? item.lease->bytes() : item.image.bytes();
 
-        nlohmann::json feature_data = out_meta.to_json();
+    const cv::Mat& img = scratch.img;
+    if(!codec::decode(meta.encoding, buf, meta.rows, meta.cols, scratch.img)){
+        counters.decode_failures.add();
+        logging::error("Failed to decode received image.");
+        return false;
+    }
+    // A slot reclaimed by the generator mid-decode may have been overwritten.
+    if (item.lease && !item.lease->valid()) {
+        counters.shm_gone.add();
+        logging::error("Shared-memory slot for seq=", meta.seq_number, " was reclaimed while decoding");
+        return false;
+    }
+    meta.t.ext_decode = latency::now_ns();
+    logging::debug("Decoded image: ", img.cols, "x", img.rows);
+    detector::Features& features = scratch.features;
+    if (tracking) {
+        const bool restart = !tracking->last_seq || tracking->stream_id != meta.stream_id ||
+                             *tracking->last_seq + 1 != meta.seq_number;
+        out.tracked = tracking->tracker.process(img, features, restart) == tracker::Kind::Tracked;
+        tracking->stream_id = meta.stream_id;
+        tracking->last_seq = meta.seq_number;
+    } else {
+        detector.detect(img, features);
+    }
+    const std::vector<cv::KeyPoint>& keypoints = features.keypoints;
+    meta.t.ext_sift = latency::now_ns();
+    counters.detect.record_between(meta.t.ext_decode, meta.t.ext_sift);
 
+    logging::debug("Keypoints for seq=", meta.seq_number, ": ", keypoints.size(),
+                   out.tracked ? " tracked" : " extracted");
+    out.keypoint_count = static_cast<int>(keypoints.size());
+
+    if (forward_codec && meta.encoding != codec::encoding_name(forward_codec->kind)) {
+        out.reencoded = scratch.image_buffers->acquire();
+        if (!codec::encode(img, *forward_codec, out.reencoded.vec())) {
+            counters.extract_failed.add();
+            logging::error("Failed to re-encode frame seq=", meta.seq_number);
+            return false;
+        }
+        out.encoding = std::string(codec::encoding_name(forward_codec->kind));
+    }
+
+    if (config.json_keypoints) {
         nlohmann::json kp_array = nlohmann::json::array();
         for(const auto& kp: keypoints){
             kp_array.push_back({
@@ -106,45 +542,498 @@ int main(){
                 {"octave", kp.octave}
             });
         }
-        feature_data["keypoints"] = kp_array;
+        out.keypoints_json = std::move(kp_array);
+        return true;
+    }
+    out.keypoints = scratch.keypoint_buffers->acquire();
+    if (!keypoint_block::encode(keypoints, features.descriptors, config.descriptors, out.keypoints.vec())) {
+        counters.extract_failed.add();
+        logging::error("Failed to pack keypoints for seq=", meta.seq_number);
+        return false;
+    }
+    return true;
+}
 
-        std::string feature_str = feature_data.dump();
-        auto feature_rc = zmq_utils::send_string(
+// `degraded` frames run on the --degrade-detector tier. A cached result of
+// the full tier still serves them; their own results, like tracked ones,
+// are not cached.
+FrameResult process_frame(
+    WorkItem& item,
+    detector::Detector& detector,
+    TrackingState* tracking,
+    WorkerScratch& scratch,
+    bool degraded,
+    FeatureCache* cache,
+    const ExtractorMetrics& counters,
+    const ExtractorConfig& config
+){
+    FrameResult result;
+    FrameMetadata& meta = item.meta;
+    std::optional<hash_utils::Hash128> key;
+    std::shared_ptr<const ExtractedFeatures> cached;
+    if (cache) {
+        key = FeatureCache::key(meta, item.lease ? item.lease->bytes() : item.image.bytes());
+        cached = cache->find(*key);
+    }
+
+    ExtractedFeatures extracted;
+    if (cached) {
+        if (item.lease && !item.lease->valid()) {
+            counters.shm_gone.add();
+            logging::error("Shared-memory slot for seq=", meta.seq_number, " was reclaimed while hashing");
+            return result;
+        }
+        extracted = *cached;
+        meta.t.ext_decode = meta.t.ext_sift = latency::now_ns();
+        logging::debug("Reused ", extracted.keypoint_count, " cached keypoints for seq=", meta.seq_number);
+    } else {
+        if (!extract(item, detector, tracking, scratch, counters, config, extracted)) {
+            return result;
+        }
+        if (cache && !degraded && !extracted.tracked) {
+            cache->insert(*key, std::make_shared<const ExtractedFeatures>(extracted));
+        }
+    }
+
+    result.meta = std::move(meta);
+    result.meta.keypoint_count = extracted.keypoint_count;
+    result.meta.extractor_id = config.extractor_id;
+    result.meta.detector = config.detector_name;
+    if (degraded && !cached) {
+        result.meta.detector = config.degrade_detector_name;
+        result.meta.flags |= kFlagDegraded;
+    }
+    if (extracted.tracked) {
+        result.meta.flags |= kFlagTracked;
+    }
+    if (!extracted.reencoded.empty()) {
+        result.reencoded = std::move(extracted.reencoded);
+        result.meta.encoding = std::move(extracted.encoding);
+        result.meta.data_bytes = result.reencoded.size();
+        // The re-encoded bytes go inline; the slot is freed with the item.
+        result.meta.flags &= ~kFlagShmPayload;
+    }
+    if (config.json_keypoints) {
+        result.keypoints_json = std::move(extracted.keypoints_json);
+    } else {
+        result.keypoints = std::move(extracted.keypoints);
+        result.meta.keypoint_format = std::string(keypoint_block::kFormatName);
+    }
+    result.image = std::move(item.image);
+    if (result.reencoded.empty()) {
+        result.lease = std::move(item.lease);
+    }
+    result.ok = true;
+    return result;
+}
+
+// The age limits are checked again here, after the frame's wait in the
+// work queue.
+void worker_loop(
+    BoundedQueue<WorkItem>& work,
+    ReorderBuffer& reorder,
+    FeatureCache* cache,
+    ShedCounters& shed,
+    const WorkerScratch& shared,
+    const ExtractorMetrics& counters,
+    const ExtractorConfig& config
+){
+    detector::Detector detector(config.detector);
+    WorkerScratch scratch{shared.image_buffers, shared.keypoint_buffers, {}, {}};
+    std::optional<detector::Detector> degrade_detector;
+    if (config.degrade_age_ns != 0) {
+        degrade_detector.emplace(config.degrade_detector);
+    }
+    std::optional<TrackingState> tracking;
+    if (config.tracking) {
+        tracking.emplace(TrackingState{tracker::Tracker(config.detector, *config.tracking), 0, std::nullopt});
+    }
+    while(auto item = work.pop()){
+        std::uint64_t ticket = item->ticket;
+        const std::uint64_t age = frame_age_ns(item->meta.t, config, latency::now_ns());
+        if (config.max_age_ns != 0 && age > config.max_age_ns) {
+            reorder.put(ticket, shed_frame(*item, kFlagShedAge, shed, config));
+        } else if (degrade_detector && age > config.degrade_age_ns) {
+            shed.count_degraded();
+            reorder.put(ticket, process_frame(*item, *degrade_detector, nullptr, scratch, true, cache,
+                                              counters, config));
+        } else {
+            reorder.put(ticket, process_frame(*item, detector, tracking ? &*tracking : nullptr,
+                                              scratch, false, cache, counters, config));
+        }
+    }
+}
+
+// Sends one result as metadata + image (+ keypoint block). `flags` is 0 or
+// ZMQ_DONTWAIT; on WouldBlock nothing was sent and `result` is unchanged.
+// `header` is scratch space for the binary metadata.
+zmq_utils::SendResult send_result(void* push_socket, FrameResult& result,
+                                  frame_header::Format meta_format,
+                                  std::vector<unsigned char>& header, int flags){
+    const FrameMetadata& out_meta = result.meta;
+    result.meta.t.ext_send = latency::now_ns();
+    zmq_utils::SendResult feature_rc;
+    if (meta_format == frame_header::Format::Binary) {
+        frame_header::encode(out_meta, header);
+        feature_rc = zmq_utils::send_bytes(
             push_socket,
-            feature_str,
-            ZMQ_SNDMORE | ZMQ_DONTWAIT,
+            header,
+            ZMQ_SNDMORE | flags,
             "zmq_send(feature to data_logger)"
         );
-
-        if(feature_rc == zmq_utils::SendResult::WouldBlock){
-            std::cerr << "[WARN] No downstream logger (feature), dropping frame " 
-            << out_meta.seq_number  << "\n";
-            continue;
+    } else {
+        nlohmann::json feature_data = out_meta.to_json();
+        const bool json_keypoints = !result.keypoints_json.is_null();
+        if (json_keypoints) {
+            feature_data["keypoints"] = std::move(result.keypoints_json);
         }
-        if(feature_rc == zmq_utils::SendResult::Error){
-            continue;
+        feature_rc = zmq_utils::send_string(
+            push_socket,
+            feature_data.dump(),
+            ZMQ_SNDMORE | flags,
+            "zmq_send(feature to data_logger)"
+        );
+        if (feature_rc != zmq_utils::SendResult::Ok && json_keypoints) {
+            result.keypoints_json = std::move(feature_data["keypoints"]);
         }
+    }
+    if(feature_rc != zmq_utils::SendResult::Ok){
+        return feature_rc;
+    }
+
+    // The first part is queued, so the remaining parts go out with it.
+    const int img_flags = flags | (result.keypoints.empty() ? 0 : ZMQ_SNDMORE);
+    auto img_rc = result.reencoded.empty()
+        ? zmq_utils::send_message(
+              push_socket,
+              result.image,
+              img_flags,
+              "zmq_send(image to data_logger)")
+        : zmq_utils::send_bytes(
+              push_socket,
+              result.reencoded.bytes(),
+              img_flags,
+              "zmq_send(image to data_logger)");
+    if(img_rc != zmq_utils::SendResult::Ok){
+        return img_rc;
+    }
+    // The descriptor is on its way; the logger frees the slot.
+    if (result.lease) {
+        result.lease->forward();
+    }
 
-        auto img_rc = zmq_utils::send_bytes(
+    if (!result.keypoints.empty()) {
+        auto kp_rc = zmq_utils::send_bytes(
             push_socket,
-            buf,
-            ZMQ_DONTWAIT,
-            "zmq_send(image to data_logger)"
+            result.keypoints.bytes(),
+            flags,
+            "zmq_send(keypoints to data_logger)"
         );
+        if (kp_rc != zmq_utils::SendResult::Ok) {
+            return kp_rc;
+        }
+    }
 
-        if(img_rc == zmq_utils::SendResult::WouldBlock){
-            std::cerr << "[WARN] No downstream logger (image), dropping frame  " 
-            << out_meta.seq_number << "\n";
-            continue;
+    logging::debug("Forwarded seq=", out_meta.seq_number, " with ", out_meta.keypoint_count,
+                   " keypoints to data logger app");
+    return zmq_utils::SendResult::Ok;
+}
+}
+
+int main(int argc, char** argv){
+    cli_utils::Args args(argc, argv);
+    auto log_options = logging::options_from_args(args);
+    if (!log_options) {
+        return 1;
+    }
+    logging::start(*log_options);
+    auto metrics_options = metrics::options_from_args(args);
+    if (!metrics_options) {
+        return 1;
+    }
+    ExtractorConfig config;
+    config.extractor_id = args.get("id", default_extractor_id());
+    if (auto spec = args.value("forward-codec")) {
+        config.forward_codec = codec::parse(*spec);
+        if (!config.forward_codec) {
+            logging::error("Unknown --forward-codec ", *spec);
+            return 1;
         }
-        if(img_rc == zmq_utils::SendResult::Error){
-            continue;
+    }
+    const std::string keypoint_mode = args.get("keypoints", "binary");
+    if (keypoint_mode != "binary" && keypoint_mode != "json") {
+        logging::error("Unknown --keypoints ", keypoint_mode, " (expected binary or json)");
+        return 1;
+    }
+    config.json_keypoints = keypoint_mode == "json";
+    auto meta_format = frame_header::parse_format(
+        args.get("meta", config.json_keypoints ? "json" : "binary"));
+    if (!meta_format) {
+        logging::error("Unknown --meta ", args.get("meta", ""), " (expected binary or json)");
+        return 1;
+    }
+    if (config.json_keypoints && *meta_format != frame_header::Format::Json) {
+        logging::error("--keypoints=json needs --meta=json");
+        return 1;
+    }
+    config.meta_format = *meta_format;
+    config.debug_meta = args.has("debug-meta");
+    auto detector_config = detector::parse(args.get("detector", "sift"));
+    if (!detector_config) {
+        logging::error("Unknown --detector ", args.get("detector", ""),
+                       " (expected sift|orb|akaze|fast-brief[:<max features>][@<scale>][#<tile>])");
+        return 1;
+    }
+    config.detector = *detector_config;
+    config.detector_name = detector::describe(config.detector);
+    config.max_age_ns = static_cast<std::uint64_t>(std::max(0LL, args.get_int("max-age-ms", 0))) * 1000000;
+    config.degrade_age_ns = static_cast<std::uint64_t>(std::max(0LL, args.get_int("degrade-age-ms", 0))) * 1000000;
+    config.max_backlog = static_cast<std::uint64_t>(std::max(0LL, args.get_int("max-backlog", 0)));
+    const std::string age_from = args.get("age-from", "send");
+    const std::string shed_mode = args.get("shed", "record");
+    if ((age_from != "send" && age_from != "recv") || (shed_mode != "record" && shed_mode != "skip")) {
+        logging::error("Unknown --age-from ", age_from, " or --shed ", shed_mode,
+                       " (expected send|recv and record|skip)");
+        return 1;
+    }
+    config.age_from_send = age_from == "send";
+    config.shed_records = shed_mode == "record";
+    // The default cheaper tier is the configured one at half resolution.
+    detector::Config half = config.detector;
+    half.scale *= 0.5;
+    auto degrade_config = args.has("degrade-detector")
+        ? detector::parse(args.get("degrade-detector", ""))
+        : std::optional<detector::Config>(half);
+    if (!degrade_config) {
+        logging::error("Unknown --degrade-detector ", args.get("degrade-detector", ""));
+        return 1;
+    }
+    config.degrade_detector = *degrade_config;
+    config.degrade_detector_name = detector::describe(config.degrade_detector);
+    if (auto spec = args.value("descriptors")) {
+        auto format = keypoint_block::parse_descriptor_format(*spec);
+        if (!format) {
+            logging::error("Unknown --descriptors ", *spec, " (expected none, f32 or u8)");
+            return 1;
+        }
+        config.descriptors = *format;
+    }
+    latency::Recorder latencies(std::chrono::seconds(
+        std::max(1LL, args.get_int("latency-interval", kDefaultLatencySeconds))));
+    // Upstream stamps only compare with ours when the generator runs on
+    // this host; wire_in stays empty otherwise.
+    latency::Histogram& wire_in_latency = latencies.add("ext.wire_in");
+    latency::Histogram& decode_latency = latencies.add("ext.queue_decode");
+    latency::Histogram& sift_latency = latencies.add("ext.sift");
+    latency::Histogram& reorder_latency = latencies.add("ext.reorder");
+    latency::Histogram& send_latency = latencies.add("ext.send");
+    auto flow = flow_control::parse_mode(args.get("flow", "none"));
+    auto policy = flow_control::parse_policy(args.get("policy", "drop-newest"));
+    if (!flow || !policy) {
+        return 1;
+    }
+    flow_control::Reporter links(std::chrono::seconds(
+        std::max(1LL, args.get_int("latency-interval", kDefaultLatencySeconds))));
+    flow_control::LinkCounters& feature_link = links.add("feature");
+    long long threads_arg = args.get_int("threads", 1);
+    std::size_t threads = threads_arg > 0
+        ? static_cast<std::size_t>(threads_arg)
+        : std::max(1u, std::thread::hardware_concurrency());
+    if (auto spec = args.value("track")) {
+        config.tracking = tracker::parse(*spec);
+        if (!config.tracking) {
+            logging::error("Unknown --track ", *spec,
+                           " (expected <keyframe interval>[:<min tracked fraction>])");
+            return 1;
         }
+        // Tracking follows consecutive frames, which only one worker sees.
+        if (threads > 1) {
+            logging::warn("--track runs a single worker; ignoring --threads=", threads);
+            threads = 1;
+        }
+        logging::info("Tracking keypoints between keyframes (", tracker::describe(*config.tracking), ")");
+    }
+    std::size_t window = static_cast<std::size_t>(
+        std::max(1LL, args.get_int("window", static_cast<long long>(threads) * 2 + 2)));
+
+    void* context = zmq_ctx_new();
+    void* pull_socket = zmq_socket(context, ZMQ_PULL);
+    void* push_socket = zmq_socket(context, ZMQ_PUSH);
+    const int sndhwm = static_cast<int>(std::max(1LL, args.get_int("sndhwm", kDefaultHwm)));
+    const int rcvhwm = static_cast<int>(std::max(1LL, args.get_int("rcvhwm", kDefaultHwm)));
+    if (!zmq_utils::set_hwm(pull_socket, sndhwm, rcvhwm) ||
+        !zmq_utils::set_hwm(push_socket, sndhwm, rcvhwm)) {
+        return 1;
+    }
+
+    // In the default chain topology this extractor owns the feature endpoint.
+    // With --fan-in the logger binds it and every extractor connects, so any
+    // number of extractors can feed one logger-side sink.
+    const bool fan_in = args.has("fan-in");
+    std::string input_endpoint = args.get("input", kImageStreamEndpoint);
+    std::string output_endpoint = args.get("output", kFeatureStreamEndpoint);
+    int rc_pull = zmq_connect(pull_socket, input_endpoint.c_str());
+    int rc_push = fan_in ? zmq_connect(push_socket, output_endpoint.c_str())
+                         : zmq_utils::bind_endpoint(push_socket, output_endpoint);
+
+    if(rc_pull != 0){
+        logging::error("Faild to connect to the ZMQ PULL socket: ", zmq_strerror(errno));
+        return 0; 
+    }
+
+    logging::info("Connected the ZMQ PULL socket to ", input_endpoint);
+
+    if(rc_push != 0){
+      logging::error("Faild to connect to the ZMQ PUSH socket:", zmq_strerror(errno));
+      return 0;
+    }
+    logging::info("ZMQ push socket ", (fan_in ? "connected to " : "bound on "), output_endpoint);
+    logging::info("Extractor id ", config.extractor_id);
+    logging::info("Metadata as ",
+                  (config.meta_format == frame_header::Format::Binary ? "binary" : "json"),
+                  ", keypoints as ", keypoint_mode,
+                  config.json_keypoints ? "" : ", descriptors ",
+                  config.json_keypoints ? std::string_view()
+                                        : keypoint_block::descriptor_format_name(config.descriptors));
+
+    // With --flow=credit this extractor grants the generator credits for the
+    // frames it can take (its reorder window by default) and spends the
+    // logger's credits on the feature link. The feature credit endpoint is
+    // bound by whichever side binds the feature stream.
+    std::optional<flow_control::CreditGrant> input_credit;
+    std::optional<flow_control::CreditGate> output_gate;
+    if (*flow == flow_control::Mode::Credit) {
+        const std::string input_credit_endpoint = args.get("input-credit", kImageCreditEndpoint);
+        const std::string output_credit_endpoint = args.get("output-credit", kFeatureCreditEndpoint);
+        input_credit = flow_control::CreditGrant::open(
+            context, input_credit_endpoint, false,
+            static_cast<std::uint32_t>(std::max(1LL, args.get_int(
+                "credit-window", static_cast<long long>(window)))));
+        output_gate = flow_control::CreditGate::open(
+            context, output_credit_endpoint, !fan_in, feature_link);
+        if (!input_credit || !output_gate) {
+            return 1;
+        }
+        logging::info("Credit links: granting on ", input_credit_endpoint, ", spending from ",
+                      output_credit_endpoint);
+    }
+    logging::info("Flow control ", args.get("flow", "none"), ", policy ", flow_control::policy_name(*policy));
+
+    // Parallelism comes from the worker pool; letting every SIFT call fan out
+    // over OpenCV's own thread pool as well would oversubscribe the cores.
+    // Tiled detection needs the pool: its tiles are spread over it.
+    if (threads > 1 && config.detector.tile == 0) {
+        cv::setNumThreads(1);
+    }
+    logging::info("Running ", threads, " ", config.detector_name, " worker(s), reorder window ", window);
+
+    // Opt-in with --feature-cache-mb=N; without it frames are not hashed.
+    std::optional<FeatureCache> feature_cache;
+    const long long feature_cache_mb = args.get_int("feature-cache-mb", kDefaultFeatureCacheMb);
+    if (feature_cache_mb > 0) {
+        feature_cache.emplace(static_cast<std::size_t>(feature_cache_mb) * 1024 * 1024,
+                              std::chrono::seconds(std::max(
+                                  1LL, args.get_int("latency-interval", kDefaultLatencySeconds))));
+        logging::info("Feature cache ", feature_cache_mb, " MB");
+    }
+
+    ShedCounters shed(std::chrono::seconds(
+        std::max(1LL, args.get_int("latency-interval", kDefaultLatencySeconds))));
+    const bool freshness = config.max_age_ns != 0 || config.degrade_age_ns != 0 || config.max_backlog != 0;
+    if (freshness) {
+        logging::info("Freshness limits: max age ", config.max_age_ns / 1000000, " ms, degrade to ",
+                      config.degrade_detector_name, " after ", config.degrade_age_ns / 1000000,
+                      " ms, max backlog ", config.max_backlog, " (0 = off), age from ", age_from,
+                      ", shed frames ", (config.shed_records ? "recorded" : "skipped"));
+    }
+
+    // Enough idle buffers for every result in flight: the reorder window,
+    // the send queue and one frame per worker.
+    const std::size_t send_queue =
+        static_cast<std::size_t>(std::max(1LL, args.get_int("send-queue", kDefaultSendQueue)));
+    const WorkerScratch pools{BufferPool::create(window + send_queue + threads),
+                              BufferPool::create(window + send_queue + threads), {}, {}};
+    alloc_counter::Reporter allocations("extractor", std::chrono::seconds(
+        std::max(1LL, args.get_int("latency-interval", kDefaultLatencySeconds))));
+    if (alloc_counter::enabled()) {
+        logging::info("Counting heap allocations per frame");
+    }
+
+    BoundedQueue<WorkItem> work(window);
+    ReorderBuffer reorder(window);
+    metrics::Registry registry("extractor", config.extractor_id);
+    const ExtractorMetrics counters(registry);
+    registry.link("feature", feature_link);
+    registry.counter("drops.shed_age", [&shed] { return shed.age(); });
+    registry.counter("drops.shed_backlog", [&shed] { return shed.backlog(); });
+    registry.gauge("queue.in.work", [&work] { return static_cast<std::int64_t>(work.size()); },
+                   static_cast<std::int64_t>(window));
+    metrics::Gauge& send_queue_depth = registry.gauge("queue.out.send", static_cast<std::int64_t>(send_queue));
+    metrics::Publisher publisher(registry, *metrics_options);
 
-        std::cout << "Forwarded seq="
-        << out_meta.seq_number
-        << "with " << keypoints.size()
-        << "keypoints to data logger app\n";
+    std::thread receiver(receive_loop, pull_socket, std::ref(work), std::ref(reorder),
+                         input_credit ? &*input_credit : nullptr, std::ref(shed),
+                         std::cref(counters), std::cref(config));
+    std::vector<std::thread> workers;
+    for (std::size_t i = 0; i < threads; ++i) {
+        workers.emplace_back(worker_loop, std::ref(work), std::ref(reorder),
+                             feature_cache ? &*feature_cache : nullptr, std::ref(shed),
+                             std::cref(pools), std::cref(counters), std::cref(config));
+    }
+
+    std::vector<unsigned char> header;
+    flow_control::Sender<FrameResult> sender(
+        *policy,
+        send_queue,
+        output_gate ? &*output_gate : nullptr,
+        feature_link,
+        [&](FrameResult& result, int flags) {
+            auto rc = send_result(push_socket, result, config.meta_format, header, flags);
+            if (rc == zmq_utils::SendResult::Ok) {
+                const StageTimestamps& t = result.meta.t;
+                wire_in_latency.record_between(t.gen_send, t.ext_recv);
+                decode_latency.record_between(t.ext_recv, t.ext_decode);
+                sift_latency.record_between(t.ext_decode, t.ext_sift);
+                reorder_latency.record_between(t.ext_sift, t.ext_send);
+                send_latency.record_between(t.ext_send, latency::now_ns());
+                counters.frames_out.add();
+                counters.bytes_out.add(result.meta.data_bytes);
+                allocations.frame();
+            }
+            return rc;
+        });
+
+    logging::InfoStream report_out;
+    // The wait is bounded so queued results and owed credits keep moving
+    // while no new result is ready.
+    while(true){
+        if (auto result = reorder.take_next_for(kSenderPollInterval)) {
+            if (result->ok) {
+                sender.offer(std::move(*result));
+            }
+            if (input_credit) {
+                input_credit->on_consumed();
+            }
+        }
+        sender.pump();
+        send_queue_depth.set(static_cast<std::int64_t>(sender.queued()));
+        if (input_credit) {
+            input_credit->flush();
+        }
+        latencies.maybe_report(report_out);
+        links.maybe_report(report_out);
+        if (feature_cache) {
+            feature_cache->maybe_report(report_out);
+        }
+        if (freshness) {
+            shed.maybe_report(report_out);
+        }
+        allocations.maybe_report(report_out);
+    }
+    work.close();
+    receiver.join();
+    for (auto& worker : workers) {
+        worker.join();
     }
     zmq_close(pull_socket);
     zmq_close(push_socket);
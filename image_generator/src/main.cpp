@@ -1,6 +1,8 @@
 // image_generator/main.cpp
-// App 1: Reads images from a folder, encodes them as PNG, and streams
-// (metadata JSON + binary image) over ZeroMQ PUSH on ipc:///tmp/voyis-image-stream.ipc.
+// App 1: Reads images from a folder (or renders synthetic ones), encodes them
+// with the configured wire codec (or forwards the original file bytes in
+// passthrough mode), and streams (metadata header + binary image) over ZeroMQ
+// PUSH on ipc:///tmp/voyis-image-stream.ipc at the pace set by --pace.
 
 #include <iostream>
 #include <opencv2/imgcodecs.hpp> 
@@ -9,6 +11,7 @@
 #include <zmq.h>
 #include <nlohmann/json.hpp>
 #include <filesystem>
+#include <fstream>
 #include <system_error>
 #include <vector>
 #include <algorithm>
@@ -16,7 +19,27 @@
 #include <chrono>
 #include <csignal>
 #include <cerrno>
+#include <random>
+#include <span>
+#include <optional>
+#include <atomic>
+#include <memory>
+#include "common/alloc_counter.hpp"
+#include "common/buffer_pool.hpp"
+#include "common/cli_utils.hpp"
+#include "common/codec.hpp"
+#include "common/dir_watch.hpp"
+#include "common/flow_control.hpp"
 #include "common/frame.hpp"
+#include "common/frame_header.hpp"
+#include "common/frame_source.hpp"
+#include "common/latency.hpp"
+#include "common/log.hpp"
+#include "common/metrics.hpp"
+#include "common/pacing.hpp"
+#include "common/shm_ring.hpp"
+#include "common/spsc_queue.hpp"
+#include "common/synthetic.hpp"
 #include "common/zmq_utils.hpp"
 
 bool running = true;
@@ -28,119 +51,683 @@ namespace fs = std::filesystem;
 
 namespace {
 constexpr char kImageStreamEndpoint[] = "ipc:///tmp/voyis-image-stream.ipc";
-constexpr char kImageStreamPath[] = "/tmp/voyis-image-stream.ipc";
+constexpr char kImageCreditEndpoint[] = "ipc:///tmp/voyis-image-credit.ipc";
+constexpr long long kDefaultCacheMb = 512;
+constexpr long long kDefaultLatencySeconds = 10;
+constexpr long long kDefaultSendQueue = 8;
+constexpr long long kDefaultHwm = 1000;
+// The generator used to sleep 500 ms per frame.
+constexpr char kDefaultPace[] = "fps:2";
+constexpr long long kDefaultSyntheticFrames = 16;
+constexpr char kDefaultShmName[] = "/voyis-frame-ring";
+constexpr long long kDefaultShmSlots = 8;
+constexpr long long kDefaultShmSlotMb = 32;
+constexpr long long kDefaultShmReclaimMs = 10000;
+constexpr long long kDefaultPrefetchThreads = 2;
+constexpr long long kDefaultPrefetchDepth = 4;
+// How long the --watch send loop waits for a frame before servicing the
+// credit link and the reports.
+constexpr std::chrono::milliseconds kWatchPollInterval{50};
+
+enum class SourceMode {
+  Reencode,     // decode the file and send it with the wire codec
+  Passthrough   // send the original file bytes unchanged
+};
+
+// One entry per input file or synthetic frame. Frames that fit in the cache
+// budget keep their wire bytes in memory; the rest are rebuilt from disk (or
+// re-rendered) on every pass.
+struct SourceFrame {
+  fs::path path;
+  // Set for frames rendered by synthetic::render(); `path` is then only a name.
+  std::optional<std::uint64_t> synthetic_index;
+  std::string encoding;
+  int rows{};
+  int cols{};
+  bool cached = false;
+  std::vector<uchar> bytes;
+};
+
+// A frame on its way out. Cached frames point into the frame cache; the
+// others own their bytes, so they can wait in a drop-oldest send queue.
+// Owned bytes come from a BufferPool and go back to it once sent or shed.
+struct OutFrame {
+  FrameMetadata meta;
+  std::span<const uchar> cached;
+  BufferPool::Buffer owned;
+
+  std::span<const uchar> bytes() const {
+    return owned.empty() ? cached : owned.bytes();
+  }
+};
+
+bool read_file(const fs::path& path, std::vector<uchar>& out){
+  std::ifstream in(path, std::ios::binary);
+  if(!in)
+    return false;
+  std::error_code ec;
+  auto size = fs::file_size(path, ec);
+  if(ec)
+    return false;
+  out.resize(size);
+  return static_cast<bool>(in.read(reinterpret_cast<char*>(out.data()),
+                                   static_cast<std::streamsize>(size)));
+}
+
+// Turns the bytes of an image file in `buf` into wire bytes, in place.
+// Passthrough keeps them as they are and only decodes once, to learn the
+// dimensions. `img` is the caller's decode scratch, reused across files.
+bool encode_file(SourceFrame& frame, SourceMode mode, const codec::Options& wire,
+                 std::vector<uchar>& buf, cv::Mat& img){
+  if(mode == SourceMode::Passthrough){
+    if(frame.encoding.empty()){
+      frame.encoding = codec::sniff(buf);
+      if(frame.encoding.empty()){
+        logging::error("unknown image format: ", frame.path);
+        return false;
+      }
+    }
+    if(frame.rows == 0){
+      cv::imdecode(buf, cv::IMREAD_COLOR, &img);
+      if(img.empty()){
+        logging::error("failed to decode ", frame.path);
+        return false;
+      }
+      frame.rows = img.rows;
+      frame.cols = img.cols;
+    }
+    return true;
+  }
+  cv::imdecode(buf, cv::IMREAD_COLOR, &img);
+  if(img.empty()){
+    logging::error("failed to decode ", frame.path);
+    return false;
+  }
+  if(!codec::encode(img, wire, buf)){
+    logging::error("failed to encode image to ", codec::describe(wire), ".");
+    return false;
+  }
+  frame.encoding = codec::encoding_name(wire.kind);
+  frame.rows = img.rows;
+  frame.cols = img.cols;
+  return true;
+}
+
+// Produces the wire bytes for `frame` into `buf`. Dimensions are filled in on
+// the first call. When `t` is given, the read and encode stamps are filled in.
+bool load_frame(SourceFrame& frame, SourceMode mode, const codec::Options& wire,
+                const synthetic::Spec& synth, std::vector<uchar>& buf, cv::Mat& img,
+                StageTimestamps* t = nullptr){
+  if(!frame.synthetic_index){
+    if(!read_file(frame.path, buf)){
+      logging::error("failed to read ", frame.path);
+      return false;
+    }
+    if(t)
+      t->gen_read = latency::now_ns();
+    if(!encode_file(frame, mode, wire, buf, img))
+      return false;
+    if(t)
+      t->gen_encode = latency::now_ns();
+    return true;
+  }
+
+  img = frame_source::load({frame.path, frame.synthetic_index}, synth);
+  if(img.empty()){
+    logging::error("the image is empty");
+    return false;
+  }
+  if(t)
+    t->gen_read = latency::now_ns();
+  if(!codec::encode(img, wire, buf)){
+    logging::error("failed to encode image to ", codec::describe(wire), ".");
+    return false;
+  }
+  frame.encoding = codec::encoding_name(wire.kind);
+  frame.rows = img.rows;
+  frame.cols = img.cols;
+  if(t)
+    t->gen_encode = latency::now_ns();
+  return true;
+}
+
+// A --watch file on its way through the prefetch pipeline: file bytes from
+// the I/O thread, wire bytes once an encode worker is done with it.
+struct Prefetched {
+  SourceFrame frame;
+  BufferPool::Buffer bytes;
+  std::uint64_t read_start{};
+  StageTimestamps t;
+  bool ok = false;
+};
+
+// --watch: an I/O thread reads the files of a dir_watch::Feed, a pool of
+// workers encodes them and the send loop takes them in feed order, so disk
+// reads and codec work for the next frames overlap with sending. File k
+// travels through lane k % workers, which keeps the order without a reorder
+// buffer, and the bounded lanes cap how far ahead of the sender it reads.
+class PrefetchPipeline {
+public:
+  PrefetchPipeline(dir_watch::Feed feed, std::size_t workers, std::size_t depth,
+                   SourceMode mode, const codec::Options& wire, metrics::Counter& failed)
+      : feed_(std::move(feed)), mode_(mode), wire_(wire),
+        buffers_(BufferPool::create(2 * workers * (depth + 1))), failed_(failed){
+    for(std::size_t i = 0; i < workers; ++i){
+      read_lanes_.push_back(std::make_unique<SpscQueue<Prefetched>>(depth));
+      encoded_lanes_.push_back(std::make_unique<SpscQueue<Prefetched>>(depth));
+    }
+    reader_ = std::thread([this]{ read_loop(); });
+    for(std::size_t i = 0; i < workers; ++i)
+      encoders_.emplace_back([this, i]{ encode_loop(i); });
+  }
+
+  ~PrefetchPipeline(){
+    stop_ = true;
+    for(auto& lane : read_lanes_)
+      lane->close();
+    for(auto& lane : encoded_lanes_)
+      lane->close();
+    reader_.join();
+    for(auto& encoder : encoders_)
+      encoder.join();
+  }
+
+  // The next encoded frame in feed order; std::nullopt if none is ready by
+  // `deadline`. Files that failed to load are skipped and counted.
+  template <typename Deadline>
+  std::optional<Prefetched> next(const Deadline& deadline){
+    while(true){
+      auto item = encoded_lanes_[next_lane_]->pop_until(deadline);
+      if(!item)
+        return std::nullopt;
+      next_lane_ = (next_lane_ + 1) % encoded_lanes_.size();
+      if(item->ok)
+        return item;
+      failed_.add();
+    }
+  }
+
+  // Encoded frames waiting for the sender; call it from the send loop.
+  std::size_t ready() const {
+    std::size_t total = 0;
+    for(const auto& lane : encoded_lanes_)
+      total += lane->size();
+    return total;
+  }
+
+  void report(std::ostream& out) const {
+    out << "Watch: listed=" << listed_ << " landed=" << landed_
+        << (scanning_ ? " (initial listing in progress)" : "") << "\n";
+  }
+
+private:
+  void read_loop(){
+    std::size_t lane = 0;
+    while(!stop_){
+      auto path = feed_.next(std::chrono::milliseconds(100));
+      if(!path)
+        continue;
+      Prefetched item;
+      item.frame.path = std::move(*path);
+      item.read_start = latency::now_ns();
+      item.bytes = buffers_->acquire();
+      if(read_file(item.frame.path, item.bytes.vec())){
+        item.t.gen_read = latency::now_ns();
+        item.ok = true;
+      } else {
+        logging::error("failed to read ", item.frame.path);
+      }
+      // Failed reads still take their turn so the lanes stay in step.
+      if(!read_lanes_[lane]->push(std::move(item)))
+        return;
+      lane = (lane + 1) % read_lanes_.size();
+      listed_ = feed_.listed();
+      landed_ = feed_.landed();
+      scanning_ = feed_.scanning();
+    }
+  }
+
+  void encode_loop(std::size_t lane){
+    cv::Mat img;
+    while(auto item = read_lanes_[lane]->pop()){
+      if(item->ok){
+        item->ok = encode_file(item->frame, mode_, wire_, item->bytes.vec(), img);
+        item->t.gen_encode = latency::now_ns();
+      }
+      if(!encoded_lanes_[lane]->push(std::move(*item)))
+        return;
+    }
+  }
+
+  dir_watch::Feed feed_;
+  const SourceMode mode_;
+  const codec::Options wire_;
+  // File bytes in both lanes and at the sender; they return once sent.
+  std::shared_ptr<BufferPool> buffers_;
+  metrics::Counter& failed_;
+  std::vector<std::unique_ptr<SpscQueue<Prefetched>>> read_lanes_;
+  std::vector<std::unique_ptr<SpscQueue<Prefetched>>> encoded_lanes_;
+  std::atomic<bool> stop_{false};
+  // Copies of the feed's counters, published by the I/O thread.
+  std::atomic<std::uint64_t> listed_{0};
+  std::atomic<std::uint64_t> landed_{0};
+  std::atomic<bool> scanning_{true};
+  std::thread reader_;
+  std::vector<std::thread> encoders_;
+  std::size_t next_lane_ = 0;
+};
+
+std::uint64_t make_stream_id(){
+  std::random_device rd;
+  std::uint64_t id = (std::uint64_t{rd()} << 32) ^ rd();
+  return id ^ static_cast<std::uint64_t>(
+      std::chrono::steady_clock::now().time_since_epoch().count());
+}
+
+// Startup stage: builds every frame once and keeps as many as fit in
+// `budget_bytes` resident, so the send loop does no codec work for them.
+std::vector<SourceFrame> build_frame_cache(
+    std::vector<SourceFrame> sources,
+    SourceMode mode,
+    const codec::Options& wire,
+    const synthetic::Spec& synth,
+    std::size_t budget_bytes){
+  auto start = std::chrono::steady_clock::now();
+  std::vector<SourceFrame> frames;
+  frames.reserve(sources.size());
+  std::size_t used = 0;
+  std::size_t cached = 0;
+  std::vector<uchar> buf;
+  cv::Mat img;
+  for(auto& frame : sources){
+    if(!load_frame(frame, mode, wire, synth, buf, img))
+      continue;
+    if(used + buf.size() <= budget_bytes){
+      used += buf.size();
+      frame.bytes = std::move(buf);
+      frame.cached = true;
+      buf = {};
+      ++cached;
+    }
+    frames.push_back(std::move(frame));
+  }
+  auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - start);
+  logging::info("Frame cache: ", cached, "/", frames.size(), " frame(s) resident, ", (used >> 20),
+                " MiB, built in ", elapsed.count(), " ms");
+  return frames;
+}
 }
 int main(int argc, char** argv){
   // std::signal(SIGINT, signal_handler);
 
-  if(argc < 2){
-    std::cerr << "Usage: " << argv[0] << " <image_folder>\n";
+  cli_utils::Args args(argc, argv);
+  if(args.positional().empty() && !args.has("synthetic")){
+    std::cerr << "Usage: " << argv[0] << " <image_folder>|--synthetic=<WxH|vga|720p|1080p|4k|8k>"
+        << " [--texture=<shapes per megapixel>] [--synthetic-frames=" << kDefaultSyntheticFrames << "]"
+        << " [--seed=1]"
+        << " [--pace=fps:<rate>|max|burst:<frames>:<ms>|trace:<file>] (default " << kDefaultPace << ")"
+        << " [--codec=png|png:<0-9>|jpeg:<0-100>|raw_bgr8|raw_gray8|qoi]"
+        << " [--passthrough] [--cache-mb=" << kDefaultCacheMb << "]"
+        << " [--watch] [--prefetch-threads=" << kDefaultPrefetchThreads << "]"
+        << " [--prefetch-depth=" << kDefaultPrefetchDepth << "]"
+        << " [--endpoint=" << kImageStreamEndpoint << "]"
+        << " [--flow=none|credit] [--policy=block|drop-newest|drop-oldest]"
+        << " [--send-queue=" << kDefaultSendQueue << "]"
+        << " [--credit-endpoint=" << kImageCreditEndpoint << "]"
+        << " [--sndhwm=" << kDefaultHwm << "]"
+        << " [--meta=binary|json]"
+        << " [--transport=zmq|shm] [--shm-name=" << kDefaultShmName << "]"
+        << " [--shm-slots=" << kDefaultShmSlots << "] [--shm-slot-mb=" << kDefaultShmSlotMb << "]"
+        << " [--shm-reclaim-ms=" << kDefaultShmReclaimMs << "]"
+        << " [--latency-interval=" << kDefaultLatencySeconds << "]"
+        << " [--log-level=debug|info|warn|error|off] [--log-rate=<lines/s per message>]"
+        << " [--metrics=on|off] [--metrics-interval=1] [--metrics-endpoint=" << metrics::kDefaultEndpoint << "]"
+        << " [--metrics-dir=" << metrics::kDefaultDir << "]\n";
     return 1;
   }
-  std::string folder_address = argv[1];
-  fs::path folder_path(folder_address);
-  if(!fs::exists(folder_path) || !fs::is_directory(folder_path)){
-    std::cerr << "Error: the folder " << folder_address << "address is incorrect. \n";
-    return 1;   
-  }
-  std::vector<fs::path> image_files;
-  for (const auto &entry: fs::directory_iterator(folder_path)){
-    if (!entry.is_regular_file()) continue;
-    auto ext = entry.path().extension().string();
-//     explain
-    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
-    if (ext == ".png" || ext == ".jpg" || ext == ".jpeg" || ext == ".bmp"){
-      image_files.push_back(entry.path());
-    }
-  }
-  if(image_files.empty()){
-    std::cerr << "No image (.png/.jpg/.jpeg/.bmp) found in the: " 
-      <<folder_address <<"\n";
+  auto log_options = logging::options_from_args(args);
+  if(!log_options)
+    return 1;
+  logging::start(*log_options);
+  auto metrics_options = metrics::options_from_args(args);
+  if(!metrics_options)
     return 1;
+  SourceMode mode = args.has("passthrough") ? SourceMode::Passthrough
+                                            : SourceMode::Reencode;
+  auto wire = codec::parse(args.get("codec", "png"));
+  if(!wire){
+    logging::error("unknown codec ", args.get("codec", ""));
+    return 1;
+  }
+  auto meta_format = frame_header::parse_format(args.get("meta", "binary"));
+  if(!meta_format){
+    logging::error("unknown --meta ", args.get("meta", ""));
+    return 1;
+  }
+  const std::string transport = args.get("transport", "zmq");
+  if(transport != "zmq" && transport != "shm"){
+    logging::error("unknown --transport ", transport);
+    return 1;
+  }
+  auto pacer = pacing::Pacer::parse(args.get("pace", kDefaultPace));
+  if(!pacer){
+    logging::error("bad --pace ", args.get("pace", kDefaultPace));
+    return 1;
+  }
+  long long cache_mb = std::max(0LL, args.get_int("cache-mb", kDefaultCacheMb));
+  latency::Recorder latencies(std::chrono::seconds(
+      std::max(1LL, args.get_int("latency-interval", kDefaultLatencySeconds))));
+  latency::Histogram& read_latency = latencies.add("gen.read");
+  latency::Histogram& encode_latency = latencies.add("gen.encode");
+  latency::Histogram& send_latency = latencies.add("gen.send");
+  auto flow = flow_control::parse_mode(args.get("flow", "none"));
+  auto policy = flow_control::parse_policy(args.get("policy", "drop-newest"));
+  if(!flow || !policy)
+    return 1;
+  flow_control::Reporter links(std::chrono::seconds(
+      std::max(1LL, args.get_int("latency-interval", kDefaultLatencySeconds))));
+  flow_control::LinkCounters& image_link = links.add("image");
+  metrics::Registry registry("generator");
+  registry.link("image", image_link);
+  metrics::Counter& frames_in = registry.counter("frames_in");
+  metrics::Counter& frames_out = registry.counter("frames_out");
+  metrics::Counter& bytes_out = registry.counter("bytes_out");
+  metrics::Counter& load_failed = registry.counter("drops.load_failed");
+  metrics::Counter& late = registry.counter("pace.late");
+  metrics::Timer& encode_time = registry.timer("encode");
+
+  const bool watch = args.has("watch");
+  std::vector<SourceFrame> sources;
+  synthetic::Spec synth;
+  std::string source_name;
+  std::optional<dir_watch::Feed> feed;
+  if(watch && args.has("synthetic")){
+    logging::error("--watch needs an image folder, not --synthetic");
+    return 1;
+  }
+  if(watch){
+    // Nothing is listed up front: the feed lists the folder lazily while
+    // frames already go out, then follows new files as they land.
+    source_name = args.positional().front();
+    feed = dir_watch::Feed::open(source_name);
+    if(!feed)
+      return 1;
+    logging::info("Watching ", source_name, " for new images");
+  } else if(auto resolution = args.value("synthetic")){
+    auto size = synthetic::parse_resolution(*resolution);
+    if(!size){
+      logging::error("bad --synthetic resolution ", *resolution);
+      return 1;
+    }
+    if(mode == SourceMode::Passthrough){
+      logging::error("--passthrough needs image files, not --synthetic");
+      return 1;
+    }
+    synth.size = *size;
+    synth.texture = std::max(0.0, args.get_double("texture", synth.texture));
+    synth.seed = static_cast<std::uint64_t>(args.get_int("seed", 1));
+    const auto count = static_cast<std::uint64_t>(
+        std::max(1LL, args.get_int("synthetic-frames", kDefaultSyntheticFrames)));
+    for(auto& entry : frame_source::synthetic_entries(synth, count)){
+      SourceFrame frame;
+      frame.path = std::move(entry.path);
+      frame.synthetic_index = entry.synthetic_index;
+      sources.push_back(std::move(frame));
+    }
+    source_name = "synthetic " + *resolution;
+    logging::info("Rendering ", count, " synthetic ", synth.size.width, "x", synth.size.height,
+                  " frame(s), texture ", synth.texture, " shapes/MP, seed ", synth.seed);
+  } else {
+    std::string folder_address = args.positional().front();
+    auto listed = frame_source::list_images(folder_address);
+    if(!listed){
+      logging::error("the folder ", folder_address, "address is incorrect. ");
+      return 1;   
+    }
+    std::vector<fs::path> image_files = std::move(*listed);
+    if(image_files.empty()){
+      logging::error("No image (.png/.jpg/.jpeg/.bmp) found in the: ", folder_address);
+      return 1;
+    }
+    logging::info("Found ", image_files.size(), " image(s) in ", folder_address);
+    for(const auto& path : image_files){
+      SourceFrame frame;
+      frame.path = path;
+      sources.push_back(std::move(frame));
+    }
+    source_name = folder_address;
   }
-  std::cout << "Found " << image_files.size() 
-      << " image(s) in " << folder_address << "\n";
 
+  std::vector<SourceFrame> frames;
+  if(!watch){
+    frames = build_frame_cache(
+        std::move(sources), mode, *wire, synth, static_cast<std::size_t>(cache_mb) << 20);
+    if(frames.empty()){
+      logging::error("None of the images in ", source_name, " could be loaded.");
+      return 1;
+    }
+  }
+
+  // Every connected feature_extractor is a PUSH peer; ZeroMQ round-robins
+  // frames over the peers that have room, which load-balances the pool.
+  std::string endpoint = args.get("endpoint", kImageStreamEndpoint);
   void* context = zmq_ctx_new();
   void* socket = zmq_socket(context, ZMQ_PUSH);
-  std::error_code remove_ec;
-  fs::remove(kImageStreamPath, remove_ec);
-  int rc = zmq_bind(socket, kImageStreamEndpoint);
+  const int sndhwm = static_cast<int>(std::max(1LL, args.get_int("sndhwm", kDefaultHwm)));
+  if(!zmq_utils::set_hwm(socket, sndhwm, sndhwm))
+    return 1;
+  int rc = zmq_utils::bind_endpoint(socket, endpoint);
   if(rc!=0){
-    std::cerr<< "failed to bind ZMQ socket: " << zmq_strerror(errno) <<"\n";
+    logging::error("failed to bind ZMQ socket: ", zmq_strerror(errno));
     return 1;
   }
-  std::cout<<"ZMQ push socket bound on " << kImageStreamEndpoint <<"\n"; 
-  std::size_t seq_number = 0;
-  while(true){
-    
-    for(const auto&image_path : image_files ){
-    
-      cv::Mat img = cv::imread(image_path.string(), cv::IMREAD_COLOR);
-      if(img.empty())
-        std::cerr << "the image is empty" << "\n" ;
-      else
-        std::cout << "Image cols " << img.cols 
-            << ", rows " << img.rows << "\n";
-      
-      std::vector<uchar> buf;
-      if(!cv::imencode(".png", img , buf))
-        std::cerr<<"failed to encode image to png." << "\n";
-      else
-        std::cout << "the buffer size is "<< buf.size() <<"\n";
-      
-      FrameMetadata meta;
-      meta.seq_number  = seq_number;
-      meta.image_name = image_path.filename().string();
-      meta.rows  = img.rows;
-      meta.cols = img.cols;
-      meta.encoding   = "png";           
-      meta.keypoint_count = buf.size();   
-
-      std::string metadata_str = meta.to_json().dump();
-      std::cout<< "trying to send data" <<"\n";
-      auto meta_rc = zmq_utils::send_string(
-          socket,
-          metadata_str,
-          ZMQ_SNDMORE | ZMQ_DONTWAIT,
-          "zmq_send(meta)"
-      );
-      if(meta_rc == zmq_utils::SendResult::WouldBlock){
-        std::cerr << "[WARN] No downstream receiver (meta), dropping frame "
-                  << seq_number << "\n";
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
-        continue;
-      }
-      if(meta_rc == zmq_utils::SendResult::Error){
-        continue;
-      }
+  logging::info("ZMQ push socket bound on ", endpoint);
+  const std::uint64_t stream_id = make_stream_id();
+  logging::info("Stream id ", stream_id);
 
-      auto img_rc = zmq_utils::send_bytes(
-          socket,
-          buf,
-          ZMQ_DONTWAIT,
-          "zmq_send(image)"
-      );
-      if (img_rc == zmq_utils::SendResult::WouldBlock){
-        std::cerr << "[WARN] No downstream receiver (image), dropping frame "
-                  << seq_number << "\n";
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
-        continue;
-      }
-      if (img_rc == zmq_utils::SendResult::Error){
-        continue;
-      }
-      std::cout << "Sent frame seq=" << seq_number 
-          << " bytes=" << buf.size() << "\n";
+  // With --flow=credit the extractors grant credits on a second link; frames
+  // only leave when one is held, otherwise the policy decides.
+  std::optional<flow_control::CreditGate> gate;
+  if(*flow == flow_control::Mode::Credit){
+    std::string credit_endpoint = args.get("credit-endpoint", kImageCreditEndpoint);
+    gate = flow_control::CreditGate::open(context, credit_endpoint, true, image_link);
+    if(!gate)
+      return 1;
+    logging::info("Credit link bound on ", credit_endpoint);
+  }
+  // With --transport=shm payloads go through a shared-memory ring and only a
+  // descriptor is sent in the image part. Frames that do not fit a slot, or
+  // arrive while every slot is held, still go inline.
+  std::optional<shm_ring::Producer> ring;
+  if(transport == "shm"){
+    const std::string shm_name = args.get("shm-name", kDefaultShmName);
+    const auto slots = static_cast<std::uint32_t>(
+        std::max(1LL, args.get_int("shm-slots", kDefaultShmSlots)));
+    const auto slot_mb = static_cast<std::uint64_t>(
+        std::max(1LL, args.get_int("shm-slot-mb", kDefaultShmSlotMb)));
+    ring = shm_ring::Producer::create(
+        shm_name, slots, slot_mb << 20,
+        std::chrono::milliseconds(std::max(1LL, args.get_int("shm-reclaim-ms", kDefaultShmReclaimMs))));
+    if(!ring)
+      return 1;
+    logging::info("Shared-memory ring ", shm_name, ": ", slots, " slot(s) of ", slot_mb, " MiB");
+  }
+  logging::info("Flow control ", args.get("flow", "none"), ", policy ",
+                flow_control::policy_name(*policy), ", pace ", pacer->describe());
 
+  // Sequence numbers are assigned when a frame actually goes out, so frames
+  // shed here leave no gap for the extractors' reorder buffers to wait on.
+  std::size_t seq_number = 0;
+  alloc_counter::Reporter allocations("generator", std::chrono::seconds(
+      std::max(1LL, args.get_int("latency-interval", kDefaultLatencySeconds))));
+  if(alloc_counter::enabled())
+    logging::info("Counting heap allocations per frame");
+  logging::InfoStream report_out;
+  std::vector<uchar> header;
+  std::vector<uchar> descriptor;
+  auto send_frame = [&](OutFrame& out, int flags){
+    out.meta.seq_number = seq_number;
+    out.meta.flags &= ~kFlagShmPayload;
+    std::optional<shm_ring::Descriptor> desc;
+    if(ring && (desc = ring->publish(out.bytes()))){
+      shm_ring::encode(*desc, descriptor);
+      out.meta.flags |= kFlagShmPayload;
+    }
+    out.meta.t.gen_send = latency::now_ns();
+    zmq_utils::SendResult meta_rc;
+    if(*meta_format == frame_header::Format::Binary){
+      frame_header::encode(out.meta, header);
+      meta_rc = zmq_utils::send_bytes(socket, header, ZMQ_SNDMORE | flags, "zmq_send(meta)");
+    } else {
+      meta_rc = zmq_utils::send_string(socket, out.meta.to_json().dump(),
+                                       ZMQ_SNDMORE | flags, "zmq_send(meta)");
+    }
+    if(meta_rc != zmq_utils::SendResult::Ok){
+      if(desc)
+        ring->cancel(*desc);
+      return meta_rc;
+    }
 
-      seq_number++;
+    // Cached frames are immutable for the life of the process, so ZeroMQ
+    // can send straight from the cache. Once the first part is queued the
+    // rest of the message is too, so the image part cannot block.
+    auto buf = out.bytes();
+    auto img_rc = desc
+        ? zmq_utils::send_bytes(socket, descriptor, flags, "zmq_send(image)")
+        : out.owned.empty()
+        ? zmq_utils::send_zero_copy(socket, buf, nullptr, nullptr, flags, "zmq_send(image)")
+        : zmq_utils::send_bytes(socket, buf, flags, "zmq_send(image)");
+    if(img_rc != zmq_utils::SendResult::Ok)
+      return img_rc;
+    send_latency.record_between(out.meta.t.gen_send, latency::now_ns());
+    frames_out.add();
+    bytes_out.add(buf.size());
+    allocations.frame();
+    logging::debug("Sent frame seq=", seq_number, " bytes=", buf.size(), " encoding=",
+                   out.meta.encoding, (desc ? " (shm)" : ""));
+    seq_number++;
+    return zmq_utils::SendResult::Ok;
+  };
+  const auto send_queue =
+      static_cast<std::size_t>(std::max(1LL, args.get_int("send-queue", kDefaultSendQueue)));
+  flow_control::Sender<OutFrame> sender(
+      *policy,
+      send_queue,
+      gate ? &*gate : nullptr,
+      image_link,
+      send_frame);
+  metrics::Gauge& send_queue_depth = registry.gauge("queue.out.send", static_cast<std::int64_t>(send_queue));
 
-      std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  // --watch sends every file once, in feed order, as it comes out of the
+  // prefetch pipeline. Idle gaps between arrivals are expected, so missed
+  // --pace deadlines are not reported here.
+  if(feed){
+    const auto prefetch_threads = static_cast<std::size_t>(
+        std::max(1LL, args.get_int("prefetch-threads", kDefaultPrefetchThreads)));
+    const auto prefetch_depth = static_cast<std::size_t>(
+        std::max(1LL, args.get_int("prefetch-depth", kDefaultPrefetchDepth)));
+    logging::info("Prefetching with ", prefetch_threads, " encode worker(s), ", prefetch_depth,
+                  " frame(s) deep each");
+    PrefetchPipeline prefetch(std::move(*feed), prefetch_threads, prefetch_depth, mode, *wire,
+                              load_failed);
+    metrics::Gauge& prefetched = registry.gauge(
+        "queue.out.prefetch", static_cast<std::int64_t>(prefetch_threads * prefetch_depth));
+    metrics::Publisher publisher(registry, *metrics_options);
+    const std::chrono::seconds report_interval(
+        std::max(1LL, args.get_int("latency-interval", kDefaultLatencySeconds)));
+    auto next_watch_report = std::chrono::steady_clock::now() + report_interval;
+    while(true){
+      latencies.maybe_report(report_out);
+      links.maybe_report(report_out);
+      allocations.maybe_report(report_out);
+      if(std::chrono::steady_clock::now() >= next_watch_report){
+        prefetch.report(report_out);
+        next_watch_report += report_interval;
+      }
+      sender.pump();
+      send_queue_depth.set(static_cast<std::int64_t>(sender.queued()));
+      prefetched.set(static_cast<std::int64_t>(prefetch.ready()));
+      auto item = prefetch.next(std::chrono::steady_clock::now() + kWatchPollInterval);
+      if(!item)
+        continue;
+      pacer->wait();
+      frames_in.add();
+      read_latency.record_between(item->read_start, item->t.gen_read);
+      encode_latency.record_between(item->t.gen_read, item->t.gen_encode);
+      encode_time.record_between(item->t.gen_read, item->t.gen_encode);
+      OutFrame out;
+      out.meta.t = item->t;
+      out.owned = std::move(item->bytes);
+      out.meta.image_name = item->frame.path.filename().string();
+      out.meta.rows = item->frame.rows;
+      out.meta.cols = item->frame.cols;
+      out.meta.encoding = item->frame.encoding;
+      out.meta.data_bytes = out.owned.size();
+      out.meta.stream_id = stream_id;
+      sender.offer(std::move(out));
+    }
+  }
 
+  // Frames rebuilt on every pass are read and encoded into pooled buffers
+  // and a reused decode Mat, so a warm loop leaves the allocator alone.
+  auto buffers = BufferPool::create(send_queue + 2);
+  cv::Mat scratch;
+  metrics::Publisher publisher(registry, *metrics_options);
+  std::uint64_t reported_late = 0;
+  std::uint64_t reported_full = 0;
+  std::uint64_t reported_reclaimed = 0;
+  while(true){
+    
+    for(auto& frame : frames){
+      latencies.maybe_report(report_out);
+      links.maybe_report(report_out);
+      allocations.maybe_report(report_out);
+      sender.pump();
+      send_queue_depth.set(static_cast<std::int64_t>(sender.queued()));
+      pacer->wait();
+      const std::uint64_t start_ns = latency::now_ns();
+      OutFrame out;
+      StageTimestamps& stamps = out.meta.t;
+      if(frame.cached){
+        // Read and encoded once at startup.
+        stamps.gen_read = stamps.gen_encode = start_ns;
+        out.cached = frame.bytes;
+      } else {
+        out.owned = buffers->acquire();
+        if(!load_frame(frame, mode, *wire, synth, out.owned.vec(), scratch, &stamps)){
+          load_failed.add();
+          continue;
+        }
+        encode_time.record_between(stamps.gen_read, stamps.gen_encode);
+      }
+      frames_in.add();
+      read_latency.record_between(start_ns, stamps.gen_read);
+      encode_latency.record_between(stamps.gen_read, stamps.gen_encode);
+      
+      out.meta.image_name = frame.path.filename().string();
+      out.meta.rows  = frame.rows;
+      out.meta.cols = frame.cols;
+      out.meta.encoding   = frame.encoding;
+      out.meta.data_bytes = out.bytes().size();
+      out.meta.stream_id = stream_id;
+      sender.offer(std::move(out));
+    }
+    if(pacer->late() > reported_late){
+      logging::warn("Missed the --pace deadline by more than one interval: ",
+                    pacer->late() - reported_late, " frame(s)");
+      late.add(pacer->late() - reported_late);
+      reported_late = pacer->late();
+    }
+    if(ring && (ring->full() > reported_full || ring->reclaimed() > reported_reclaimed)){
+      logging::warn("shm ring: ", ring->full() - reported_full,
+                    " frame(s) sent inline with every slot held, ",
+                    ring->reclaimed() - reported_reclaimed, " slot(s) reclaimed from consumers");
+      reported_full = ring->full();
+      reported_reclaimed = ring->reclaimed();
     }
   }
-  std::cout<< "Closing the socket and terminating the context." <<"\n";
+  logging::info("Closing the socket and terminating the context.");
   zmq_close(socket);
   zmq_ctx_term(context);
 
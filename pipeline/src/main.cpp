@@ -0,0 +1,482 @@
+// voyis_pipeline: runs the image_generator, feature_extractor and data_logger
+// stages in one process, for edge deployments without IPC.
+//
+// Frames move between stage threads as decoded cv::Mat and keypoint vectors
+// through lock-free SPSC lanes; nothing is serialized until the writer
+// stores it:
+//
+//   source thread --lane k % N--> SIFT worker k % N --lane k % N--> writer
+//
+// Frame k uses the same lane index in both directions, so the writer takes
+// frames back in order without a reorder buffer.
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <opencv2/core.hpp>
+#include "common/alloc_counter.hpp"
+#include "common/blob_log.hpp"
+#include "common/cli_utils.hpp"
+#include "common/codec.hpp"
+#include "common/detector.hpp"
+#include "common/flow_control.hpp"
+#include "common/frame.hpp"
+#include "common/frame_header.hpp"
+#include "common/frame_source.hpp"
+#include "common/frame_writer.hpp"
+#include "common/hash_utils.hpp"
+#include "common/keypoint_block.hpp"
+#include "common/latency.hpp"
+#include "common/log.hpp"
+#include "common/metrics.hpp"
+#include "common/pacing.hpp"
+#include "common/spsc_queue.hpp"
+#include "common/synthetic.hpp"
+
+namespace {
+constexpr long long kDefaultCacheMb = 512;
+constexpr long long kDefaultLaneDepth = 4;
+constexpr long long kDefaultSyntheticFrames = 16;
+constexpr long long kDefaultBatchFrames = 64;
+constexpr long long kDefaultBatchMs = 50;
+constexpr long long kDefaultStatsSeconds = 10;
+constexpr long long kDefaultDedupCacheEntries = 1 << 16;
+constexpr long long kDefaultSegmentMb = 256;
+constexpr long long kDefaultLatencySeconds = 10;
+constexpr char kDefaultPace[] = "fps:2";
+constexpr char kDefaultDatabase[] = "voyis_frames.db";
+
+// Settings shared read-only by the workers.
+struct PipelineConfig {
+    codec::Options store_codec;
+    keypoint_block::DescriptorFormat descriptors = keypoint_block::DescriptorFormat::None;
+    std::string extractor_id;
+    detector::Config detector;
+    std::string detector_name;
+    // Only needed for image deduplication and the blob log checksum.
+    bool hash_payloads = true;
+};
+
+// An input frame. Frames that fit in the cache budget stay decoded in
+// memory; cv::Mat is reference counted, so handing one to a worker is free.
+struct SourceFrame {
+    frame_source::Entry entry;
+    cv::Mat cached;
+};
+
+// Source -> worker.
+struct WorkItem {
+    FrameMetadata meta;
+    cv::Mat image;
+};
+
+// Worker -> writer. Failed frames still travel, so the writer's lane order
+// stays in step with the source's.
+struct StoredFrame {
+    bool ok = false;
+    frame_writer::Record record;
+};
+
+// The workers' share of the live metrics; the writer adds its own.
+struct WorkerMetrics {
+    metrics::Timer& detect;
+    // Storage encoding or keypoint packing failed.
+    metrics::Counter& encode_failed;
+};
+
+// Frames waiting in `lanes`, read from the metrics thread. The lanes move
+// while they are read, so a lane that drained between the two loads in
+// size() reads past its capacity; it counts as empty.
+template <typename T>
+std::int64_t lane_backlog(const std::vector<std::unique_ptr<SpscQueue<T>>>& lanes) {
+    std::size_t total = 0;
+    for (const auto& lane : lanes) {
+        const std::size_t size = lane->size();
+        total += size <= lane->capacity() ? size : 0;
+    }
+    return static_cast<std::int64_t>(total);
+}
+
+std::uint64_t make_stream_id() {
+    std::random_device rd;
+    std::uint64_t id = (std::uint64_t{rd()} << 32) ^ rd();
+    return id ^ static_cast<std::uint64_t>(
+        std::chrono::steady_clock::now().time_since_epoch().count());
+}
+
+// Startup stage: decodes frames until `budget_bytes` is used up.
+std::size_t fill_cache(std::vector<SourceFrame>& frames, const synthetic::Spec& synth,
+                       std::size_t budget_bytes) {
+    std::size_t used = 0;
+    std::size_t cached = 0;
+    for (auto& frame : frames) {
+        cv::Mat img = frame_source::load(frame.entry, synth);
+        if (img.empty()) {
+            continue;
+        }
+        const std::size_t bytes = img.total() * img.elemSize();
+        if (used + bytes > budget_bytes) {
+            break;
+        }
+        used += bytes;
+        frame.cached = std::move(img);
+        ++cached;
+    }
+    logging::info("Frame cache: ", cached, "/", frames.size(), " frame(s) decoded in memory, ",
+                  (used >> 20), " MiB");
+    return cached;
+}
+
+// The extractor stage plus the logger's storage encoding. Encoding here
+// rather than on the writer thread lets it scale with --threads; the writer
+// only talks to SQLite. The record's buffers come from `pools` and the
+// detector output lands in the worker's `features`, so neither allocates
+// once the first frames have sized them.
+StoredFrame process_frame(WorkItem& item, detector::Detector& detector,
+                          detector::Features& features, const frame_writer::RecordPools& pools,
+                          const WorkerMetrics& counters, const PipelineConfig& config) {
+    StoredFrame out;
+    FrameMetadata& meta = item.meta;
+    meta.t.ext_recv = latency::now_ns();
+    // Nothing to decode in process.
+    meta.t.ext_decode = meta.t.ext_recv;
+
+    detector.detect(item.image, features);
+    meta.t.ext_sift = latency::now_ns();
+    counters.detect.record_between(meta.t.ext_decode, meta.t.ext_sift);
+
+    frame_writer::Record& record = out.record;
+    record.transcoded = pools.payloads->acquire();
+    record.local_keypoints = pools.keypoints->acquire();
+    record.local_meta = pools.headers->acquire();
+    if (!codec::encode(item.image, config.store_codec, record.transcoded.vec())) {
+        counters.encode_failed.add();
+        logging::error("Failed to encode frame seq=", meta.seq_number, " as ",
+                       codec::describe(config.store_codec));
+        return out;
+    }
+    if (!keypoint_block::encode(features.keypoints, features.descriptors,
+                                config.descriptors, record.local_keypoints.vec())) {
+        counters.encode_failed.add();
+        logging::error("Failed to pack keypoints for seq=", meta.seq_number);
+        return out;
+    }
+    meta.keypoint_count = static_cast<int>(features.keypoints.size());
+    meta.extractor_id = config.extractor_id;
+    meta.detector = config.detector_name;
+    meta.encoding = std::string(codec::encoding_name(config.store_codec.kind));
+    meta.data_bytes = record.transcoded.size();
+    meta.keypoint_format = std::string(keypoint_block::kFormatName);
+    if (config.hash_payloads) {
+        record.image_hash = hash_utils::hash128(record.payload());
+    }
+    meta.t.ext_send = latency::now_ns();
+    // The stored header is what an extractor would have sent to the logger.
+    frame_header::encode(meta, record.local_meta.vec());
+    record.meta = std::move(meta);
+    out.ok = true;
+    return out;
+}
+
+void worker_loop(SpscQueue<WorkItem>& in, SpscQueue<StoredFrame>& out,
+                 const frame_writer::RecordPools& pools, const WorkerMetrics& counters,
+                 const PipelineConfig& config) {
+    detector::Detector detector(config.detector);
+    detector::Features features;
+    while (auto item = in.pop()) {
+        if (!out.push(process_frame(*item, detector, features, pools, counters, config))) {
+            break;
+        }
+    }
+    out.close();
+}
+
+// Drains the worker lanes in frame order into the writer until every lane
+// is closed and empty.
+void writer_loop(std::vector<std::unique_ptr<SpscQueue<StoredFrame>>>& lanes,
+                 frame_writer::Writer& writer, latency::Recorder& latencies,
+                 alloc_counter::Reporter& allocations) {
+    latency::Histogram& queue_in_latency = latencies.add("pipe.queue_in");
+    latency::Histogram& sift_latency = latencies.add("pipe.sift");
+    latency::Histogram& store_encode_latency = latencies.add("pipe.store_encode");
+    logging::InfoStream report_out;
+    std::size_t lane = 0;
+    while (true) {
+        auto stored = lanes[lane]->pop_until(writer.next_deadline());
+        if (stored) {
+            lane = (lane + 1) % lanes.size();
+            if (stored->ok) {
+                frame_writer::Record& record = stored->record;
+                record.meta.t.log_recv = latency::now_ns();
+                const StageTimestamps& t = record.meta.t;
+                queue_in_latency.record_between(t.gen_send, t.ext_recv);
+                sift_latency.record_between(t.ext_decode, t.ext_sift);
+                store_encode_latency.record_between(t.ext_sift, t.ext_send);
+                writer.add(record);
+                allocations.frame();
+            }
+        } else if (lanes[lane]->drained()) {
+            break;
+        }
+        writer.tick();
+        latencies.maybe_report(report_out);
+        allocations.maybe_report(report_out);
+    }
+    writer.finish();
+    latencies.report(report_out);
+}
+}
+
+int main(int argc, char** argv) {
+    cli_utils::Args args(argc, argv);
+    if (args.positional().empty() && !args.has("synthetic")) {
+        std::cerr << "Usage: " << argv[0] << " <image_folder>|--synthetic=<WxH|vga|720p|1080p|4k|8k>"
+                  << " [--texture=<shapes per megapixel>] [--synthetic-frames=" << kDefaultSyntheticFrames << "]"
+                  << " [--seed=1]"
+                  << " [--pace=fps:<rate>|max|burst:<frames>:<ms>|trace:<file>] (default " << kDefaultPace << ")"
+                  << " [--passes=0 (forever)] [--cache-mb=" << kDefaultCacheMb << "]"
+                  << " [--threads=1 (0: one per core)] [--lane-depth=" << kDefaultLaneDepth << "]"
+                  << " [--policy=block|drop-newest]"
+                  << " [--detector=sift|orb|akaze|fast-brief[:<max features>][@<scale>][#<tile>]]"
+                  << " [--descriptors=none|f32|u8]"
+                  << " [--store-codec=png|png:<0-9>|jpeg:<0-100>|raw_bgr8|raw_gray8|qoi]"
+                  << " [--db=" << kDefaultDatabase << "] [--image-store=dedup|inline]"
+                  << " [--batch-frames=" << kDefaultBatchFrames << "] [--batch-ms=" << kDefaultBatchMs << "]"
+                  << " [--blob-dir=<dir>] [--segment-mb=" << kDefaultSegmentMb << "]"
+                  << " [--stats-interval=" << kDefaultStatsSeconds << "]"
+                  << " [--latency-interval=" << kDefaultLatencySeconds << "]"
+                  << " [--log-level=debug|info|warn|error|off] [--log-rate=<lines/s per message>]"
+                  << " [--metrics=on|off] [--metrics-interval=1] [--metrics-endpoint=" << metrics::kDefaultEndpoint << "]"
+                  << " [--metrics-dir=" << metrics::kDefaultDir << "]\n";
+        return 1;
+    }
+    auto log_options = logging::options_from_args(args);
+    if (!log_options) {
+        return 1;
+    }
+    logging::start(*log_options);
+    auto metrics_options = metrics::options_from_args(args);
+    if (!metrics_options) {
+        return 1;
+    }
+    metrics::Registry registry("pipeline");
+    metrics::Counter& frames_in = registry.counter("frames_in");
+    metrics::Counter& load_failed = registry.counter("drops.load_failed");
+    metrics::Counter& lanes_full = registry.counter("drops.lanes_full");
+    metrics::Counter& late = registry.counter("pace.late");
+    const WorkerMetrics worker_metrics{registry.timer("detect"), registry.counter("drops.encode_failed")};
+
+    PipelineConfig config;
+    auto store_codec = codec::parse(args.get("store-codec", "png"));
+    if (!store_codec) {
+        logging::error("Unknown --store-codec ", args.get("store-codec", ""));
+        return 1;
+    }
+    config.store_codec = *store_codec;
+    if (auto spec = args.value("descriptors")) {
+        auto format = keypoint_block::parse_descriptor_format(*spec);
+        if (!format) {
+            logging::error("Unknown --descriptors ", *spec, " (expected none, f32 or u8)");
+            return 1;
+        }
+        config.descriptors = *format;
+    }
+    config.extractor_id = "pipeline-" + std::to_string(getpid());
+    auto detector_config = detector::parse(args.get("detector", "sift"));
+    if (!detector_config) {
+        logging::error("Unknown --detector ", args.get("detector", ""),
+                       " (expected sift|orb|akaze|fast-brief[:<max features>][@<scale>][#<tile>])");
+        return 1;
+    }
+    config.detector = *detector_config;
+    config.detector_name = detector::describe(config.detector);
+    auto pacer = pacing::Pacer::parse(args.get("pace", kDefaultPace));
+    if (!pacer) {
+        logging::error("bad --pace ", args.get("pace", kDefaultPace));
+        return 1;
+    }
+    // Frames cannot be taken back out of an SPSC lane, so there is no
+    // drop-oldest here.
+    auto policy = flow_control::parse_policy(args.get("policy", "drop-newest"));
+    if (!policy) {
+        return 1;
+    }
+    if (*policy == flow_control::Policy::DropOldest) {
+        logging::error("--policy=drop-oldest is not supported by voyis_pipeline");
+        return 1;
+    }
+    const long long passes = std::max(0LL, args.get_int("passes", 0));
+    long long threads_arg = args.get_int("threads", 1);
+    const std::size_t threads = threads_arg > 0
+        ? static_cast<std::size_t>(threads_arg)
+        : std::max(1u, std::thread::hardware_concurrency());
+    const auto lane_depth = static_cast<std::size_t>(
+        std::max(1LL, args.get_int("lane-depth", kDefaultLaneDepth)));
+
+    // Source stage.
+    std::vector<SourceFrame> frames;
+    synthetic::Spec synth;
+    if (auto resolution = args.value("synthetic")) {
+        auto size = synthetic::parse_resolution(*resolution);
+        if (!size) {
+            logging::error("bad --synthetic resolution ", *resolution);
+            return 1;
+        }
+        synth.size = *size;
+        synth.texture = std::max(0.0, args.get_double("texture", synth.texture));
+        synth.seed = static_cast<std::uint64_t>(args.get_int("seed", 1));
+        const auto count = static_cast<std::uint64_t>(
+            std::max(1LL, args.get_int("synthetic-frames", kDefaultSyntheticFrames)));
+        for (auto& entry : frame_source::synthetic_entries(synth, count)) {
+            frames.push_back({std::move(entry), {}});
+        }
+    } else {
+        auto images = frame_source::list_images(args.positional().front());
+        if (!images) {
+            return 1;
+        }
+        for (auto& path : *images) {
+            frames.push_back({{std::move(path), std::nullopt}, {}});
+        }
+    }
+    if (frames.empty()) {
+        logging::error("No image (.png/.jpg/.jpeg/.bmp) found in ", args.positional().front());
+        return 1;
+    }
+    fill_cache(frames, synth,
+               static_cast<std::size_t>(std::max(0LL, args.get_int("cache-mb", kDefaultCacheMb))) << 20);
+
+    // Logger stage.
+    frame_writer::Options writer_options;
+    writer_options.batch_frames = static_cast<std::size_t>(
+        std::max(1LL, args.get_int("batch-frames", kDefaultBatchFrames)));
+    writer_options.batch_time = std::chrono::milliseconds(
+        std::max(0LL, args.get_int("batch-ms", kDefaultBatchMs)));
+    writer_options.stats_interval = std::chrono::seconds(
+        std::max(1LL, args.get_int("stats-interval", kDefaultStatsSeconds)));
+    writer_options.dedup_images = args.get("image-store", "dedup") != "inline";
+    writer_options.dedup_cache_entries = static_cast<std::size_t>(kDefaultDedupCacheEntries);
+    writer_options.latency_interval = std::chrono::seconds(
+        std::max(1LL, args.get_int("latency-interval", kDefaultLatencySeconds)));
+    writer_options.metrics = &registry;
+    std::optional<blob_log::Writer> blobs;
+    if (auto blob_dir = args.value("blob-dir")) {
+        const auto segment_bytes = static_cast<std::uint64_t>(
+            std::max(1LL, args.get_int("segment-mb", kDefaultSegmentMb))) << 20;
+        blobs = blob_log::Writer::open(*blob_dir, segment_bytes);
+        if (!blobs) {
+            return 1;
+        }
+    }
+    config.hash_payloads = writer_options.dedup_images || blobs.has_value();
+    const std::string db_path = args.get("db", kDefaultDatabase);
+    auto database = frame_writer::open_database(db_path, writer_options);
+    if (!database) {
+        return 1;
+    }
+    frame_writer::Writer writer(database->db.get(), std::move(database->statements),
+                                writer_options, std::move(blobs));
+    latency::Recorder latencies(writer_options.latency_interval);
+
+    // Parallelism comes from the worker lanes; letting every SIFT call fan
+    // out over OpenCV's own thread pool as well would oversubscribe the cores.
+    // Tiled detection needs the pool: its tiles are spread over it.
+    if (threads > 1 && config.detector.tile == 0) {
+        cv::setNumThreads(1);
+    }
+    std::vector<std::unique_ptr<SpscQueue<WorkItem>>> work_lanes;
+    std::vector<std::unique_ptr<SpscQueue<StoredFrame>>> stored_lanes;
+    for (std::size_t i = 0; i < threads; ++i) {
+        work_lanes.push_back(std::make_unique<SpscQueue<WorkItem>>(lane_depth));
+        stored_lanes.push_back(std::make_unique<SpscQueue<StoredFrame>>(lane_depth));
+    }
+    const auto lane_capacity = static_cast<std::int64_t>(threads * work_lanes.front()->capacity());
+    registry.gauge("queue.in.work", [&work_lanes] { return lane_backlog(work_lanes); }, lane_capacity);
+    registry.gauge("queue.in.stored", [&stored_lanes] { return lane_backlog(stored_lanes); }, lane_capacity);
+    metrics::Publisher publisher(registry, *metrics_options);
+    // Records in flight: a full stored lane and one in hand per worker,
+    // plus the one the writer holds.
+    const auto pools = frame_writer::RecordPools::create(threads * (lane_depth + 1) + 1);
+    alloc_counter::Reporter allocations("pipeline", writer_options.latency_interval);
+    if (alloc_counter::enabled()) {
+        logging::info("Counting heap allocations per frame");
+    }
+    std::vector<std::thread> workers;
+    for (std::size_t i = 0; i < threads; ++i) {
+        workers.emplace_back(worker_loop, std::ref(*work_lanes[i]), std::ref(*stored_lanes[i]),
+                             std::cref(pools), std::cref(worker_metrics), std::cref(config));
+    }
+    std::thread writer_thread(writer_loop, std::ref(stored_lanes), std::ref(writer),
+                              std::ref(latencies), std::ref(allocations));
+
+    const std::uint64_t stream_id = make_stream_id();
+    logging::info("Pipeline: ", frames.size(), " frame(s), ", threads, " ", config.detector_name,
+                  " worker(s), lane depth ", work_lanes.front()->capacity(), ", pace ",
+                  pacer->describe(), ", policy ", flow_control::policy_name(*policy), ", storing ",
+                  codec::describe(config.store_codec), " in ", db_path);
+
+    // Sequence numbers are assigned when a frame enters a lane, so a frame
+    // shed here leaves no gap and the lane index stays k % N.
+    std::uint64_t seq_number = 0;
+    std::uint64_t reported_late = 0;
+    for (long long pass = 0; passes == 0 || pass < passes; ++pass) {
+        std::uint64_t dropped = 0;
+        for (const auto& frame : frames) {
+            pacer->wait();
+            WorkItem item;
+            item.image = frame.cached.empty() ? frame_source::load(frame.entry, synth) : frame.cached;
+            if (item.image.empty()) {
+                load_failed.add();
+                logging::error("failed to load ", frame.entry.path);
+                continue;
+            }
+            frames_in.add();
+            FrameMetadata& meta = item.meta;
+            meta.t.gen_read = latency::now_ns();
+            meta.t.gen_encode = meta.t.gen_read;
+            meta.image_name = frame.entry.path.filename().string();
+            meta.rows = item.image.rows;
+            meta.cols = item.image.cols;
+            meta.stream_id = stream_id;
+            meta.seq_number = static_cast<int>(seq_number);
+            meta.t.gen_send = latency::now_ns();
+
+            SpscQueue<WorkItem>& lane = *work_lanes[seq_number % threads];
+            const bool queued = *policy == flow_control::Policy::Block
+                ? lane.push(std::move(item))
+                : lane.try_push(item);
+            if (!queued) {
+                ++dropped;
+                lanes_full.add();
+                continue;
+            }
+            ++seq_number;
+        }
+        if (dropped > 0) {
+            logging::warn("Dropped with every worker lane full: ", dropped, " frame(s)");
+        }
+        if (pacer->late() > reported_late) {
+            logging::warn("Missed the --pace deadline by more than one interval: ",
+                          pacer->late() - reported_late, " frame(s)");
+            late.add(pacer->late() - reported_late);
+            reported_late = pacer->late();
+        }
+    }
+
+    for (auto& lane : work_lanes) {
+        lane->close();
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    writer_thread.join();
+    logging::info("Pipeline done: ", seq_number, " frame(s) processed");
+    return 0;
+}
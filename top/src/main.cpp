@@ -0,0 +1,340 @@
+// voyis_top: a live table of every running stage, built from the metrics
+// snapshots they publish (common/metrics.hpp). It binds the metrics socket
+// the stages connect to, or with --dir reads their snapshot files, and
+// every refresh prints one row per process with rates since the last one:
+// frames in and out, output bandwidth, drops, decode failures and queue
+// fill, then the drop reasons and work timers behind them.
+//
+// A stage that cannot keep up backs frames up in its input queues, so the
+// stage with the fullest input queue is named as the likely bottleneck.
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+#include <zmq.h>
+
+#include "common/cli_utils.hpp"
+#include "common/metrics.hpp"
+#include "common/zmq_utils.hpp"
+
+namespace fs = std::filesystem;
+
+namespace {
+constexpr long long kDefaultRefreshSeconds = 1;
+constexpr long long kDefaultStaleSeconds = 5;
+// How long a receive waits before the refresh deadline is checked again.
+constexpr int kReceivePollMs = 100;
+// An input queue at least this full marks its stage as backed up.
+constexpr double kBackedUp = 0.5;
+// Stages in pipeline order; others sort after them by name.
+constexpr std::string_view kStageOrder[] = {"generator", "extractor", "logger", "pipeline"};
+
+// One process, keyed by stage and instance.
+struct Source {
+    nlohmann::json latest;
+    // The snapshot the shown rates were taken against.
+    nlohmann::json base;
+    // Largest timer maximum seen since the last refresh.
+    std::map<std::string, double> max_ms;
+    std::chrono::steady_clock::time_point heard;
+    // The last row printed, kept while no newer snapshot has come in.
+    std::string row;
+    std::string details;
+    double fill = 0.0;
+    std::string fullest;
+};
+
+std::uint64_t counter(const nlohmann::json& snapshot, const std::string& name) {
+    return snapshot["counters"].value(name, std::uint64_t{0});
+}
+
+// Growth of a cumulative value; a restarted process counts from zero again.
+std::uint64_t growth(std::uint64_t now, std::uint64_t before) {
+    return now >= before ? now - before : now;
+}
+
+// Sum of the counters named <prefix>..., as deltas against `base`, per name.
+std::map<std::string, std::uint64_t> deltas(const nlohmann::json& latest, const nlohmann::json& base,
+                                            std::string_view prefix) {
+    std::map<std::string, std::uint64_t> out;
+    for (const auto& [name, value] : latest["counters"].items()) {
+        if (name.compare(0, prefix.size(), prefix) != 0) {
+            continue;
+        }
+        out[name.substr(prefix.size())] = growth(value.get<std::uint64_t>(), counter(base, name));
+    }
+    return out;
+}
+
+int stage_rank(const std::string& stage) {
+    for (std::size_t i = 0; i < std::size(kStageOrder); ++i) {
+        if (kStageOrder[i] == stage) {
+            return static_cast<int>(i);
+        }
+    }
+    return static_cast<int>(std::size(kStageOrder));
+}
+
+std::string format(const char* fmt, double value) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), fmt, value);
+    return buf;
+}
+
+void add(std::map<std::string, Source>& sources, nlohmann::json snapshot) {
+    if (!snapshot.is_object() || !snapshot.contains("stage") || !snapshot.contains("counters")) {
+        return;
+    }
+    const std::string key = snapshot.value("stage", "") + " " + snapshot.value("instance", "");
+    Source& source = sources[key];
+    if (source.latest.is_object() &&
+        source.latest.value("mono_ns", std::uint64_t{0}) == snapshot.value("mono_ns", std::uint64_t{0})) {
+        return;
+    }
+    for (const auto& [name, timer] : snapshot["timers"].items()) {
+        double& max = source.max_ms[name];
+        max = std::max(max, timer.value("max_ms", 0.0));
+    }
+    source.latest = std::move(snapshot);
+    source.heard = std::chrono::steady_clock::now();
+}
+
+// Recomputes a source's row once a newer snapshot than its base is in.
+void refresh(Source& source) {
+    const nlohmann::json& latest = source.latest;
+    if (!source.base.is_object()) {
+        source.base = latest;
+        source.row.clear();
+        return;
+    }
+    const std::uint64_t t0 = source.base.value("mono_ns", std::uint64_t{0});
+    const std::uint64_t t1 = latest.value("mono_ns", std::uint64_t{0});
+    if (t1 <= t0) {
+        return;
+    }
+    const double seconds = static_cast<double>(t1 - t0) / 1e9;
+    const nlohmann::json& base = source.base;
+    auto rate = [&](const std::string& name) {
+        return static_cast<double>(growth(counter(latest, name), counter(base, name))) / seconds;
+    };
+
+    std::uint64_t interval_drops = 0;
+    std::uint64_t total_drops = 0;
+    std::ostringstream details;
+    std::string reasons;
+    for (const auto& [reason, delta] : deltas(latest, base, "drops.")) {
+        interval_drops += delta;
+        total_drops += counter(latest, "drops." + reason);
+        if (delta != 0) {
+            reasons += " " + reason + "=" + std::to_string(delta);
+        }
+    }
+    if (!reasons.empty()) {
+        details << "    drops:" << reasons << "\n";
+    }
+    for (const auto& [name, timer] : latest["timers"].items()) {
+        const auto& before = base["timers"].contains(name) ? base["timers"][name] : nlohmann::json::object();
+        const std::uint64_t count_now = timer.value("count", std::uint64_t{0});
+        const std::uint64_t count_before = before.value("count", std::uint64_t{0});
+        const std::uint64_t count = growth(count_now, count_before);
+        if (count == 0) {
+            continue;
+        }
+        const double total = timer.value("total_ms", 0.0) -
+                             (count_now >= count_before ? before.value("total_ms", 0.0) : 0.0);
+        details << "    " << name << ": avg " << format("%.2f", total / static_cast<double>(count))
+                << " ms, max " << format("%.2f", source.max_ms[name]) << " ms over " << count << "\n";
+    }
+    if (const std::uint64_t late = growth(counter(latest, "pace.late"), counter(base, "pace.late"))) {
+        details << "    pace: " << late << " frame(s) past their deadline\n";
+    }
+    source.max_ms.clear();
+
+    std::string queues;
+    source.fill = 0.0;
+    source.fullest.clear();
+    for (const auto& [name, gauge] : latest["gauges"].items()) {
+        if (name.compare(0, 6, "queue.") != 0) {
+            continue;
+        }
+        const std::int64_t value = gauge.value("value", std::int64_t{0});
+        const std::int64_t capacity = gauge.value("capacity", std::int64_t{0});
+        queues += " " + name.substr(6) + "=" + std::to_string(value);
+        if (capacity > 0) {
+            queues += "/" + std::to_string(capacity);
+            const double fill = static_cast<double>(value) / static_cast<double>(capacity);
+            if (name.compare(0, 9, "queue.in.") == 0 && fill > source.fill) {
+                source.fill = fill;
+                source.fullest = name.substr(9);
+            }
+        }
+    }
+
+    char row[160];
+    std::snprintf(row, sizeof(row), "%-10s %-24s %8.1f %8.1f %8.2f %8.1f %8llu %8llu",
+                  latest.value("stage", "").c_str(), latest.value("instance", "").substr(0, 24).c_str(),
+                  rate("frames_in"), rate("frames_out"), rate("bytes_out") / 1e6,
+                  static_cast<double>(interval_drops) / seconds,
+                  static_cast<unsigned long long>(total_drops),
+                  static_cast<unsigned long long>(counter(latest, "decode_failures")));
+    source.row = row + queues;
+    source.details = details.str();
+    source.base = latest;
+}
+
+void print(std::map<std::string, Source>& sources, bool clear) {
+    std::vector<Source*> order;
+    for (auto& [key, source] : sources) {
+        refresh(source);
+        order.push_back(&source);
+    }
+    std::stable_sort(order.begin(), order.end(), [](const Source* a, const Source* b) {
+        return stage_rank(a->latest.value("stage", "")) < stage_rank(b->latest.value("stage", ""));
+    });
+
+    std::ostringstream out;
+    if (clear) {
+        out << "\033[H\033[2J";
+    }
+    char header[160];
+    std::snprintf(header, sizeof(header), "%-10s %-24s %8s %8s %8s %8s %8s %8s %s", "STAGE", "INSTANCE",
+                  "IN/s", "OUT/s", "MB/s", "DROP/s", "DROPS", "DECFAIL", "QUEUES");
+    out << header << "\n";
+    const Source* bottleneck = nullptr;
+    for (const Source* source : order) {
+        if (source->row.empty()) {
+            out << source->latest.value("stage", "") << " " << source->latest.value("instance", "")
+                << ": waiting for a second snapshot\n";
+            continue;
+        }
+        out << source->row << "\n" << source->details;
+        if (source->fill >= kBackedUp && (!bottleneck || source->fill > bottleneck->fill)) {
+            bottleneck = source;
+        }
+    }
+    if (order.empty()) {
+        out << "No stage has published metrics yet\n";
+    } else if (bottleneck) {
+        out << "Likely bottleneck: " << bottleneck->latest.value("stage", "") << " "
+            << bottleneck->latest.value("instance", "") << " (input queue " << bottleneck->fullest << " "
+            << static_cast<int>(bottleneck->fill * 100.0) << "% full)\n";
+    } else {
+        out << "No input queue is backed up\n";
+    }
+    std::cout << out.str() << std::flush;
+}
+
+// Drops sources that have not published for `stale`.
+void prune(std::map<std::string, Source>& sources, std::chrono::steady_clock::duration stale) {
+    const auto now = std::chrono::steady_clock::now();
+    std::erase_if(sources, [&](const auto& entry) { return now - entry.second.heard > stale; });
+}
+
+// Reads every snapshot file in `dir`, skipping those not rewritten for
+// `stale` (their process is gone).
+void read_dir(const fs::path& dir, std::chrono::seconds stale, std::map<std::string, Source>& sources) {
+    const auto now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(dir, ec)) {
+        if (entry.path().extension() != ".json") {
+            continue;
+        }
+        std::ifstream in(entry.path());
+        auto snapshot = nlohmann::json::parse(in, nullptr, false);
+        if (snapshot.is_discarded() ||
+            now_ms - snapshot.value("time_ms", 0LL) > std::chrono::milliseconds(stale).count()) {
+            continue;
+        }
+        add(sources, std::move(snapshot));
+    }
+    if (ec) {
+        std::cerr << "[ERROR] Failed to read " << dir << ": " << ec.message() << "\n";
+    }
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+    cli_utils::Args args(argc, argv);
+    if (args.has("help")) {
+        std::cerr << "Usage: " << argv[0] << " [--endpoint=" << metrics::kDefaultEndpoint << "]"
+                  << " [--dir=<snapshot dir, e.g. " << metrics::kDefaultDir << ">]"
+                  << " [--refresh=" << kDefaultRefreshSeconds << "] [--stale=" << kDefaultStaleSeconds << "]"
+                  << " [--once] [--plain]\n";
+        return 1;
+    }
+    const std::chrono::seconds refresh_interval(std::max(1LL, args.get_int("refresh", kDefaultRefreshSeconds)));
+    const std::chrono::seconds stale(std::max(1LL, args.get_int("stale", kDefaultStaleSeconds)));
+    // --once prints a single table, on the second refresh so it has rates.
+    const bool once = args.has("once");
+    const bool clear = !once && !args.has("plain");
+    std::map<std::string, Source> sources;
+    int refreshes = 0;
+    // False once --once has printed its table.
+    auto on_refresh = [&] {
+        prune(sources, stale);
+        if (refreshes++ == 0) {
+            for (auto& [key, source] : sources) {
+                refresh(source);
+            }
+        } else {
+            print(sources, clear);
+        }
+        return !once || refreshes < 2;
+    };
+
+    if (auto dir = args.value("dir")) {
+        while (true) {
+            read_dir(*dir, stale, sources);
+            if (!on_refresh()) {
+                return 0;
+            }
+            std::this_thread::sleep_for(refresh_interval);
+        }
+    }
+
+    // The stages connect and come and go; voyis_top owns the endpoint.
+    const std::string endpoint = args.get("endpoint", metrics::kDefaultEndpoint);
+    void* context = zmq_ctx_new();
+    void* socket = zmq_socket(context, ZMQ_SUB);
+    zmq_setsockopt(socket, ZMQ_SUBSCRIBE, "", 0);
+    if (!zmq_utils::set_receive_timeout(socket, kReceivePollMs)) {
+        return 1;
+    }
+    if (zmq_utils::bind_endpoint(socket, endpoint) != 0) {
+        std::cerr << "[ERROR] Failed to bind " << endpoint << ": " << zmq_strerror(errno)
+                  << " (another voyis_top? use --dir)\n";
+        return 1;
+    }
+    std::cerr << "Listening for metrics on " << endpoint << "\n";
+    auto next_refresh = std::chrono::steady_clock::now() + refresh_interval;
+    while (true) {
+        if (auto msg = zmq_utils::recv_message(socket, 0, "zmq_msg_recv(metrics)")) {
+            add(sources, nlohmann::json::parse(msg->view(), nullptr, false));
+        }
+        if (std::chrono::steady_clock::now() < next_refresh) {
+            continue;
+        }
+        next_refresh += refresh_interval;
+        if (!on_refresh()) {
+            break;
+        }
+    }
+    zmq_close(socket);
+    zmq_ctx_term(context);
+    return 0;
+}